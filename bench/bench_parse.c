@@ -0,0 +1,184 @@
+#include "../src/command.h"
+#include "../src/string_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define TARGET_NANOSECONDS 200000000L // Every workload runs for about 0.2 s
+#define MAX_ITERATIONS 100000
+
+// The allocator of glibc, which the functions below forward to
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+size_t allocation_count;
+size_t allocated_bytes;
+
+// Interposing the allocator also counts the allocations made inside the C library (strdup, ...)
+void *malloc(size_t size) {
+    allocation_count++;
+    allocated_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocation_count++;
+    allocated_bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocation_count++;
+    allocated_bytes += size;
+    return __libc_realloc(pointer, size);
+}
+
+void *reallocarray(void *pointer, size_t count, size_t size) {
+    return realloc(pointer, count * size);
+}
+
+/** Appends `count` times `piece` to `line`, which is grown as needed. */
+char *append_repeated(char *line, const char *piece, size_t count) {
+    size_t used = line == NULL ? 0 : strlen(line);
+    size_t piece_length = strlen(piece);
+    char *new_line = realloc(line, used + piece_length * count + 1);
+    if (new_line == NULL) {
+        perror("realloc");
+        exit(1);
+    }
+    for (size_t index = 0; index < count; ++index) {
+        memcpy(new_line + used + index * piece_length, piece, piece_length);
+    }
+    new_line[used + piece_length * count] = '\0';
+    return new_line;
+}
+
+char *argv_line(size_t count) {
+    char *line = append_repeated(NULL, "echo", 1);
+    return append_repeated(line, " argument", count);
+}
+
+char *pipeline_line(size_t stages) {
+    char *line = append_repeated(NULL, "cat", 1);
+    return append_repeated(line, " | cat", stages - 1);
+}
+
+char *nested_substitution_line(size_t depth) {
+    char *line = append_repeated(NULL, "cat <( ", depth);
+    line = append_repeated(line, "echo", 1);
+    return append_repeated(line, " )", depth);
+}
+
+char *background_line(size_t count) {
+    return append_repeated(NULL, "sleep 1 & ", count);
+}
+
+char *redirection_line(size_t count) {
+    char *line = append_repeated(NULL, "cmd", 1);
+    return append_repeated(line, " < in >| out 2>> err >> log", count);
+}
+
+long elapsed_nanoseconds(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000000000L + (end->tv_nsec - start->tv_nsec);
+}
+
+/** Parses, instantiates and releases the line once. */
+void parse_once(char *line) {
+    size_t total_commands;
+    command **commands = parse_read_line(line, &total_commands);
+    if (commands == NULL) {
+        fprintf(stderr, "bench-parse: failed to parse \"%.40s...\"\n", line);
+        exit(1);
+    }
+
+    for (size_t index = 0; index < total_commands; ++index) {
+        close_command_file_descriptors(commands[index]);
+        destroy_command(commands[index]);
+    }
+    free(commands);
+}
+
+/** Runs a workload and prints its results as a single JSON object. */
+void bench(const char *workload, size_t size, char *line) {
+    struct timespec start, end;
+
+    // Warm up, and measure how many lines fit in the time budget
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parse_once(line);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long once = elapsed_nanoseconds(&start, &end);
+    long iterations = once > 0 ? TARGET_NANOSECONDS / once : MAX_ITERATIONS;
+    if (iterations < 1) {
+        iterations = 1;
+    } else if (iterations > MAX_ITERATIONS) {
+        iterations = MAX_ITERATIONS;
+    }
+
+    size_t allocations_before = allocation_count;
+    size_t bytes_before = allocated_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long iteration = 0; iteration < iterations; ++iteration) {
+        parse_once(line);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    struct rusage usage;
+    // The peak resident set size is the one of the whole process so far, so it never decreases
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"workload\": \"%s\", \"size\": %zu, \"line_bytes\": %zu, \"iterations\": %ld, \"ns_per_line\": %.1f, "
+           "\"allocations_per_line\": %.1f, \"allocated_bytes_per_line\": %.1f, \"peak_rss_kb\": %ld}\n",
+           workload, size, strlen(line), iterations, (double)elapsed_nanoseconds(&start, &end) / iterations,
+           (double)(allocation_count - allocations_before) / iterations,
+           (double)(allocated_bytes - bytes_before) / iterations, usage.ru_maxrss);
+    fflush(stdout);
+    free(line);
+}
+
+/** Large pipelines and substitutions hold two file descriptors per pipe until they are released. */
+void raise_file_descriptor_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("getrlimit");
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("setrlimit");
+    }
+}
+
+int main() {
+    raise_file_descriptor_limit();
+
+    size_t argv_sizes[] = {1, 10, 100, 1000, 10000};
+    for (size_t index = 0; index < sizeof(argv_sizes) / sizeof(argv_sizes[0]); ++index) {
+        bench("argv", argv_sizes[index], argv_line(argv_sizes[index]));
+    }
+
+    size_t pipeline_sizes[] = {1, 10, 100, 1000};
+    for (size_t index = 0; index < sizeof(pipeline_sizes) / sizeof(pipeline_sizes[0]); ++index) {
+        bench("pipeline", pipeline_sizes[index], pipeline_line(pipeline_sizes[index]));
+    }
+
+    size_t depths[] = {1, 10, 100, 500};
+    for (size_t index = 0; index < sizeof(depths) / sizeof(depths[0]); ++index) {
+        bench("nested_substitution", depths[index], nested_substitution_line(depths[index]));
+    }
+
+    size_t background_sizes[] = {1, 10, 100, 1000};
+    for (size_t index = 0; index < sizeof(background_sizes) / sizeof(background_sizes[0]); ++index) {
+        bench("background", background_sizes[index], background_line(background_sizes[index]));
+    }
+
+    size_t redirection_sizes[] = {1, 10, 100, 1000};
+    for (size_t index = 0; index < sizeof(redirection_sizes) / sizeof(redirection_sizes[0]); ++index) {
+        bench("redirection", redirection_sizes[index], redirection_line(redirection_sizes[index]));
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "../src/lexer.h"
+#include "../src/string_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINE_LENGTH 8192
+#define ITERATIONS 20000
+
+typedef void (*classifier)(const char *, size_t, uint8_t *);
+
+/** Fills `line` with a command line mixing words, pipes, redirections and substitutions. */
+void fill_line(char *line, size_t length) {
+    const char *pieces[] = {"echo ", "abcdefgh ", "| ", "2>> ", "/tmp/out ", "<( ", ") ", "& ", "--flag=42 "};
+    size_t count = sizeof(pieces) / sizeof(pieces[0]);
+    size_t used = 0;
+
+    for (size_t index = 0; used < length; ++index) {
+        const char *piece = pieces[(index * 7) % count];
+        size_t piece_length = strlen(piece);
+        if (used + piece_length > length) {
+            piece_length = length - used;
+        }
+        memcpy(line + used, piece, piece_length);
+        used += piece_length;
+    }
+    line[length] = '\0';
+}
+
+double elapsed_seconds(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void bench_classifier(const char *name, classifier classify, const char *line, size_t length, uint8_t *classes) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t iteration = 0; iteration < ITERATIONS; ++iteration) {
+        classify(line, length, classes);
+        __asm__ volatile("" : : "r"(classes) : "memory");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = elapsed_seconds(&start, &end);
+    printf("%-10s %10.1f MB/s\n", name, (double)length * ITERATIONS / seconds / 1e6);
+}
+
+void bench_tokenize(const char *line, size_t length) {
+    struct timespec start, end;
+    size_t tokens_count = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t iteration = 0; iteration < ITERATIONS; ++iteration) {
+        size_t size;
+        token *tokens = tokenize(line, &size);
+        tokens_count += size;
+        free(tokens);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = elapsed_seconds(&start, &end);
+    printf("%-10s %10.1f MB/s (%zu tokens per line)\n", "tokenize", (double)length * ITERATIONS / seconds / 1e6,
+           tokens_count / ITERATIONS);
+}
+
+int main() {
+    char *line = malloc(LINE_LENGTH + 1);
+    uint8_t *classes = malloc(LINE_LENGTH + 1);
+    if (line == NULL || classes == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    fill_line(line, LINE_LENGTH);
+
+    printf("Scanning %d byte lines, %d iterations, AVX2 %savailable\n", LINE_LENGTH, ITERATIONS,
+           has_avx2() ? "" : "not ");
+    bench_classifier("scalar", classify_bytes_scalar, line, LINE_LENGTH, classes);
+    bench_classifier("sse2", classify_bytes_sse2, line, LINE_LENGTH, classes);
+    bench_classifier("avx2", classify_bytes_avx2, line, LINE_LENGTH, classes);
+    bench_tokenize(line, LINE_LENGTH);
+
+    free(line);
+    free(classes);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Rounds `size` up to the alignment guaranteed by `arena_alloc`. */
+size_t arena_align(size_t size) {
+    size_t alignment = _Alignof(max_align_t);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+arena_chunk *new_arena_chunk(size_t size) {
+    arena_chunk *chunk = malloc(sizeof(arena_chunk) + size);
+    if (chunk == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+arena *new_arena() {
+    arena *arena = malloc(sizeof(*arena));
+    if (arena == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    arena->chunks = new_arena_chunk(ARENA_CHUNK_SIZE);
+    if (arena->chunks == NULL) {
+        free(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void destroy_arena(arena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    arena_chunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+void *arena_alloc(arena *arena, size_t size) {
+    size = arena_align(size == 0 ? 1 : size);
+    arena_chunk *current = arena->chunks;
+
+    if (current->size - current->used < size) {
+        // Big allocations get a chunk of their own, placed behind the current one
+        // so that the space left in the current chunk is not lost.
+        if (size > ARENA_CHUNK_SIZE / 2) {
+            arena_chunk *chunk = new_arena_chunk(size);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            chunk->used = size;
+            chunk->next = current->next;
+            current->next = chunk;
+            return chunk->data;
+        }
+
+        current = new_arena_chunk(ARENA_CHUNK_SIZE);
+        if (current == NULL) {
+            return NULL;
+        }
+        current->next = arena->chunks;
+        arena->chunks = current;
+    }
+
+    void *memory = (char *)current->data + current->used;
+    current->used += size;
+    return memory;
+}
+
+/** Returns 1 if `n` is zero or a power of two, 0 otherwise. */
+int is_growth_point(size_t n) {
+    return (n & (n - 1)) == 0;
+}
+
+void *arena_grow_array(arena *arena, void *array, size_t count, size_t element_size) {
+    if (array != NULL && !is_growth_point(count)) {
+        return array;
+    }
+
+    size_t capacity = count == 0 ? 1 : 2 * count;
+    void *grown = arena_alloc(arena, capacity * element_size);
+    if (grown == NULL) {
+        return NULL;
+    }
+
+    if (array != NULL) {
+        memcpy(grown, array, count * element_size);
+    }
+    return grown;
+}
+
+char *arena_strndup(arena *arena, const char *string, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char *arena_strdup(arena *arena, const char *string) {
+    return arena_strndup(arena, string, strlen(string));
+}
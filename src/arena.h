@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/** Default size of the chunks of memory requested by an arena. */
+#define ARENA_CHUNK_SIZE 4096
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size; // Number of usable bytes in `data`
+    size_t used; // Number of bytes already handed out
+    max_align_t data[];
+} arena_chunk;
+
+/**
+ * Bump allocator: memory is handed out from big chunks and never freed individually,
+ * everything is released at once by `destroy_arena`.
+ */
+typedef struct arena {
+    arena_chunk *chunks; // The first chunk is the one allocations are made from
+} arena;
+
+/** Returns a new empty arena. */
+arena *new_arena();
+
+/** Frees every chunk of the arena, and thus everything allocated from it. */
+void destroy_arena(arena *);
+
+/** Returns `size` bytes of memory owned by the arena, suitably aligned for any type. */
+void *arena_alloc(arena *, size_t size);
+
+/**
+ * Returns a copy of `array` made of `count` elements of `element_size` bytes with room for at least one more.
+ * The capacity doubles every time `count` reaches a power of two, so repeated appends stay linear.
+ * When there is still room, `array` is returned unchanged.
+ */
+void *arena_grow_array(arena *, void *array, size_t count, size_t element_size);
+
+/** Returns a null terminated copy of the first `length` characters of `string`. */
+char *arena_strndup(arena *, const char *string, size_t length);
+
+/** Returns a copy of `string`. */
+char *arena_strdup(arena *, const char *string);
+
+#endif // ARENA_H
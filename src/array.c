@@ -0,0 +1,301 @@
+#include "array.h"
+#include "internals.h"
+#include "jobs.h"
+#include "launch.h"
+#include "reaper.h"
+#include "string_utils.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int parse_array_size(const char *string, size_t *count, size_t *limit, int error_fd) {
+    char *end;
+    *count = strtoul(string, &end, 10);
+    *limit = *count;
+    if (end != string && *end == '%') {
+        const char *limit_string = end + 1;
+        *limit = strtoul(limit_string, &end, 10);
+        if (end == limit_string) {
+            *limit = 0;
+        }
+    }
+
+    if (end == string || *end != '\0' || *string == '-' || *count == 0 || *limit == 0) {
+        dprintf(error_fd, "array: %s: expected a number of instances N or N%%K, both positive\n", string);
+        return -1;
+    }
+    return 0;
+}
+
+void destroy_array_job(array_job *array) {
+    if (array == NULL) {
+        return;
+    }
+
+    for (int stream = 0; stream < 3; stream++) {
+        if (array->streams[stream] > STDERR_FILENO) {
+            close(array->streams[stream]);
+        }
+    }
+    destroy_command(array->template);
+    free(array);
+}
+
+int is_array_exhausted(const array_job *array) {
+    return array->halted || array->launched == array->count;
+}
+
+extern char **environ;
+
+/**
+ * Returns a copy of the environment of the shell without `ARRAY_TASK_ID_ENV`, with room for it at index `slot` before
+ * the final NULL. Only the array is allocated, the variables are the ones of the shell. Returns NULL on failure.
+ */
+char **new_instance_environment(size_t *slot) {
+    size_t count = 0;
+    while (environ[count] != NULL) {
+        count++;
+    }
+
+    char **environment = malloc((count + 2) * sizeof(char *));
+    if (environment == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    // The shell may itself be an instance of an array
+    size_t name_length = strlen(ARRAY_TASK_ID_ENV);
+    *slot = 0;
+    for (size_t index = 0; index < count; index++) {
+        if (strncmp(environ[index], ARRAY_TASK_ID_ENV, name_length) != 0 || environ[index][name_length] != '=') {
+            environment[(*slot)++] = environ[index];
+        }
+    }
+    environment[*slot] = NULL;
+    environment[*slot + 1] = NULL;
+    return environment;
+}
+
+/** Launches the next instances of the array, with SIGCHLD blocked. */
+void launch_array_instances(job *job, int take_terminal) {
+    array_job *array = job->array;
+
+    size_t running = 0;
+    for (size_t index = 0; index < array->launched; ++index) {
+        subjob *subjob = job->subjobs[index];
+        if (subjob->last_status == STOPPED) {
+            return;
+        }
+        if (subjob->last_status == KILLED) {
+            array->halted = 1;
+        }
+        if (subjob->last_status == RUNNING) {
+            running++;
+        }
+    }
+
+    if (is_array_exhausted(array) || running >= array->limit) {
+        return;
+    }
+
+    // The reaper may have reaped every instance of the group, the next ones then start a new one
+    if (job->pgid != 0 && kill(-job->pgid, 0) == -1) {
+        if (!take_terminal && tcgetpgrp(STDERR_FILENO) == job->pgid) {
+            take_terminal = 1; // The job was in the foreground
+        }
+        job->pgid = 0;
+    }
+
+    launch_barrier barrier;
+    if (open_launch_barrier(&barrier) == -1) {
+        array->halted = 1;
+        return;
+    }
+
+    // Each instance gets its own index, the environment of the shell is left as it is
+    size_t task_slot;
+    char **environment = new_instance_environment(&task_slot);
+    if (environment == NULL) {
+        release_launch_barrier(&barrier);
+        array->halted = 1;
+        return;
+    }
+    char task_variable[sizeof(ARRAY_TASK_ID_ENV) + 24];
+    environment[task_slot] = task_variable;
+    array->template->environment = environment;
+
+    // Spawned instances take the terminal on their own, forked ones once the shell gave it to the group
+    command_call *call = array->template->command_calls[0];
+    array->template->background = !take_terminal;
+    for (; running < array->limit && array->launched < array->count; ++running) {
+        // Copied by fork or execve before the next instance overwrites it
+        snprintf(task_variable, sizeof(task_variable), "%s=%zu", ARRAY_TASK_ID_ENV, array->launched + 1);
+
+        pid_t pid = launch_command_call(array->template, call, job->pgid, &barrier);
+        subjob *subjob = pid == -1 ? NULL : new_subjob(call, pid, RUNNING);
+        if (subjob == NULL || add_subjob(job, array->launched, subjob) == -1) {
+            destroy_subjob(subjob);
+            array->halted = 1;
+            break;
+        }
+
+        if (job->pgid == 0) {
+            job->pgid = pid;
+        }
+        array->launched++;
+    }
+    array->template->background = 1;
+    array->template->environment = NULL;
+    free(environment);
+
+    if (take_terminal && job->pgid != 0 && tcsetpgrp(STDERR_FILENO, job->pgid) == -1) {
+        perror("tcsetpgrp");
+    }
+    release_launch_barrier(&barrier);
+}
+
+void refill_array_job(job *job, int take_terminal) {
+    // Nothing is reaped meanwhile, the process group of the job has to outlive the check of its existence
+    sigset_t previous;
+    block_child_signals(&previous);
+    launch_array_instances(job, take_terminal);
+    restore_child_signals(&previous);
+}
+
+void count_array_instance(array_job *array, int status) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        array->failed++;
+    }
+}
+
+int array_exit_code(const array_job *array) {
+    return array->failed > 0 || array->launched < array->count ? 1 : 0;
+}
+
+void print_array_progress(job *job, int fd) {
+    array_job *array = job->array;
+
+    size_t running = 0;
+    for (size_t index = 0; index < array->launched; ++index) {
+        if (job->subjobs[index]->last_status == RUNNING || job->subjobs[index]->last_status == STOPPED) {
+            running++;
+        }
+    }
+
+    size_t over = array->launched - running;
+    dprintf(fd, "\t%zu running, %zu done, %zu failed, %zu pending\n", running, over - array->failed, array->failed,
+            array->count - array->launched);
+}
+
+/** Returns the job of `array`, an instance running the arguments that follow the size. Returns NULL on failure. */
+job *new_array_job(command_call *command_call, size_t count, size_t limit) {
+    char *instance_string = join_strings(command_call->argv + 2, command_call->argc - 2, " ");
+    if (instance_string == NULL) {
+        return NULL;
+    }
+
+    command *template = parse_command(instance_string);
+    free(instance_string);
+    if (template == NULL) {
+        return NULL;
+    }
+
+    if (is_internal_command(template->command_calls[0])) {
+        dprintf(command_call->stderr, "array: %s: internal commands cannot be run as an array\n",
+                template->command_calls[0]->name);
+        destroy_command(template);
+        return NULL;
+    }
+
+    array_job *array = malloc(sizeof(array_job));
+    if (array == NULL) {
+        perror("malloc");
+        destroy_command(template);
+        return NULL;
+    }
+
+    // The redirections of `array` are closed once it returns, the instances keep using them
+    int streams[3] = {command_call->stdin, command_call->stdout, command_call->stderr};
+    for (int stream = 0; stream < 3; stream++) {
+        array->streams[stream] = streams[stream];
+        if (streams[stream] > STDERR_FILENO) {
+            array->streams[stream] = fcntl(streams[stream], F_DUPFD_CLOEXEC, 0);
+        }
+    }
+
+    array->template = template;
+    array->count = count;
+    array->limit = limit;
+    array->launched = 0;
+    array->failed = 0;
+    array->halted = 0;
+    template->command_calls[0]->stdin = array->streams[0];
+    template->command_calls[0]->stdout = array->streams[1];
+    template->command_calls[0]->stderr = array->streams[2];
+
+    job *job = new_job(count, command_call->command_string);
+    if (job == NULL) {
+        destroy_array_job(array);
+        return NULL;
+    }
+    job->array = array;
+    return job;
+}
+
+int array_command(command *command, command_call *command_call) {
+    // The job of the instances cannot be part of another one
+    if (is_subshell || command->command_call_count > 1) {
+        dprintf(command_call->stderr, "array: cannot be run inside a pipeline\n");
+        return 1;
+    }
+
+    if (command_call->argc < 3) {
+        dprintf(command_call->stderr, "array: correct usage: array N[%%K] command [argument ...]\n");
+        return 1;
+    }
+
+    size_t count;
+    size_t limit;
+    if (parse_array_size(command_call->argv[1], &count, &limit, command_call->stderr) == -1) {
+        return 1;
+    }
+
+    job *job = new_array_job(command_call, count, limit);
+    if (job == NULL) {
+        return 1;
+    }
+
+    int background = command->background;
+    add_job(job);
+    refill_array_job(job, !background);
+    if (job->pgid == 0) {
+        remove_job(job->id);
+        return 1;
+    }
+
+    if (background) {
+        print_job(job, STDERR_FILENO);
+        return 0;
+    }
+
+    int exit_code = blocking_wait_for_job(job) == 0 ? 0 : 1;
+    if (tcsetpgrp(STDERR_FILENO, getpgrp()) == -1) {
+        perror("tcsetpgrp");
+    }
+
+    if (job->status == DONE || job->status == KILLED || job->status == DETACHED) {
+        if (is_job_over(job)) {
+            remove_job(job->id);
+        } else { // The orphans it left behind are tracked until they are over
+            print_job(job, STDERR_FILENO);
+        }
+        return exit_code;
+    }
+
+    print_job(job, STDERR_FILENO);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include "command.h"
+
+#include <stddef.h>
+
+/** Name of the internal command launching indexed instances of a command as a single job. */
+#define ARRAY_COMMAND "array"
+
+/** Environment variable holding the index of an instance, from 1 to the number of instances. */
+#define ARRAY_TASK_ID_ENV "JSH_TASK_ID"
+
+struct job;
+
+/**
+ * Instances of a command run by `array N[%K] cmd ...`, the subjobs of its job.
+ * `subjobs[i]` stays NULL until instance i + 1 is launched.
+ */
+typedef struct array_job {
+    command *template; // Command of an instance, launched once for each task id
+    int streams[3];    // Standard streams of `array`, shared by every instance
+    size_t count;      // Number of instances
+    size_t limit;      // Maximal number of instances running at once
+    size_t launched;
+    size_t failed; // Instances that exited with a non zero code or were killed
+    int halted;    // 1 once no instance is launched anymore, because one of them was killed or could not be launched
+} array_job;
+
+/**
+ * Parses `N` or `N%K` into the number of instances and the number of them running at once, `N` by default.
+ * Returns -1 and prints an error to `error_fd` if it is invalid.
+ */
+int parse_array_size(const char *string, size_t *count, size_t *limit, int error_fd);
+
+/** Frees the instances of the array, and closes the streams it kept for them. */
+void destroy_array_job(array_job *array);
+
+/** Returns 1 if no instance of the array is left to launch, 0 otherwise. */
+int is_array_exhausted(const array_job *array);
+
+/**
+ * Launches instances of the array job until `limit` of them are running, the first ones creating its process group.
+ * Once every instance of the group was reaped, the next ones start a new group, which takes the terminal if the
+ * previous one had it. Nothing is launched while one of the instances is stopped, nor once one of them was killed.
+ * The job is given the terminal if `take_terminal` is 1.
+ */
+void refill_array_job(struct job *job, int take_terminal);
+
+/** Counts the instance as failed depending on the status it was reaped with. */
+void count_array_instance(array_job *array, int status);
+
+/** Returns the exit code of a finished array job, 0 if every instance succeeded, 1 otherwise. */
+int array_exit_code(const array_job *array);
+
+/** Prints how many instances of the array job are running, done, failed and not launched yet. */
+void print_array_progress(struct job *job, int fd);
+
+#endif // ARRAY_H
@@ -1,75 +1,47 @@
+#define _GNU_SOURCE // pipe2
+
 #include "command.h"
+#include "arena.h"
 #include "internals.h"
 #include "jobs.h"
+#include "lexer.h"
 #include "string_utils.h"
 #include "utils.h"
 
 #include <errno.h>
 #include <fcntl.h>
 
-const char internal_commands[INTERNAL_COMMANDS_COUNT][100] = {"cd", "exit", "pwd", "?", "jobs", "fg", "bg", "kill"};
-
-const char *redirection_caret_symbols[REDIRECTION_CARET_SYMBOLS_COUNT] = {
-    ">", "<", ">|", ">>", "2>", "2>|", "2>>", COMMAND_SUBSTITUTION_START, COMMAND_SUBSTITUTION_END, PIPE_SYMBOL};
+const char internal_commands[INTERNAL_COMMANDS_COUNT][100] = {"cd",    "exit", "pwd",  "?",    "jobs",    "fg",
+                                                              "bg",    "kill", "hash", "type", "setnice", "setcpus",
+                                                              "array"};
 
 #define UNINITIALIZED_FD -1
 
-// This variable represents the last command call on the main pipeline
-// for example in a | b | c it should be c
-// and in a | b | c <( d ) it should also be c
-// The call to `parse_command` resets it.
-command_call *last_parsed_command_call = NULL;
-
-// The same as the previous one but this is limited to a particular
-// substitution. It gets reset every time we parse a new substitution.
-command_call *last_parsed_command_call_substitution = NULL;
-
-command_call *parse_command_call(command *, char *, int, int);
-
-/** Returns a new command call with the given name, argc and argv. */
-command_call *new_command_call(size_t argc, char **argv, char *command_string) {
-    command_call *command_call = malloc(sizeof(*command_call));
-    if (command_call == NULL) {
-        perror("malloc");
-        return NULL;
-    }
-
+/** Initializes the command call with the given argc, argv and string used to call it. */
+void init_command_call(command_call *command_call, size_t argc, char **argv, char *command_string) {
     command_call->name = argv[0];
     command_call->argc = argc;
     command_call->argv = argv;
-    command_call->reading_pipes = NULL;
-    command_call->writing_pipes = NULL;
+    command_call->command_string = command_string;
+    command_call->reading_pipes.pipes = NULL;
+    command_call->reading_pipes.pipe_count = 0;
+    command_call->writing_pipes.pipes = NULL;
+    command_call->writing_pipes.pipe_count = 0;
+    command_call->redirections = NULL;
+    command_call->redirection_count = 0;
     command_call->stdin = STDIN_FILENO;
     command_call->stdout = STDOUT_FILENO;
     command_call->stderr = STDERR_FILENO;
-
-    command_call->command_string = malloc((strlen(command_string) + 1) * sizeof(char));
-    if (command_string == NULL) {
-        return NULL;
-    }
-
-    memmove(command_call->command_string, command_string, (strlen(command_string) + 1) * sizeof(char));
-
-    return command_call;
 }
 
-/** Frees the memory allocated for the command call.
- * Calls for `close_unused_file_descriptors`.
- */
-void destroy_command_call(command_call *command_call) {
+command_call *new_command_call(arena *arena, size_t argc, char **argv, char *command_string) {
+    command_call *command_call = arena_alloc(arena, sizeof(*command_call));
     if (command_call == NULL) {
-        return;
-    }
-
-    for (size_t index = 0; index < command_call->argc; index++) {
-        free(command_call->argv[index]);
+        return NULL;
     }
 
-    free(command_call->argv);
-    free(command_call->command_string);
-    destroy_pipe_info(command_call->reading_pipes);
-    destroy_pipe_info(command_call->writing_pipes);
-    free(command_call);
+    init_command_call(command_call, argc, argv, command_string);
+    return command_call;
 }
 
 /** Prints the command call. */
@@ -78,9 +50,12 @@ void command_call_print(command_call *command_call, int fd) {
 }
 
 int is_internal_command(command_call *command_call) {
-    int i;
-    for (i = 0; i < 8; i++) {
-        if (strcmp(command_call->name, internal_commands[i]) == 0) {
+    return is_internal_command_name(command_call->name);
+}
+
+int is_internal_command_name(const char *name) {
+    for (size_t i = 0; i < INTERNAL_COMMANDS_COUNT; i++) {
+        if (strcmp(name, internal_commands[i]) == 0) {
             return 1;
         }
     }
@@ -111,55 +86,30 @@ void destroy_command_result(command_result *command_result) {
     free(command_result);
 }
 
-command *new_command(command_call **call, size_t command_call_count, int **open_pipes, size_t open_pipes_size,
-                     char *command_string) {
-    command *command = malloc(sizeof(*command));
-
-    if (command == NULL) {
-        perror("malloc");
-        return NULL;
-    }
-
-    command->command_calls = call;
-    command->command_call_count = command_call_count;
-    command->background = 0;
-    command->open_pipes = open_pipes;
-    command->open_pipes_size = open_pipes_size;
-
-    char *command_string_copy = malloc((strlen(command_string) + 1) * sizeof(char));
-    if (command_string_copy == NULL) {
-        perror("malloc");
-        return NULL;
-    }
-    strcpy(command_string_copy, command_string);
-    command->command_string = command_string_copy;
-
-    return command;
-}
-
-command *new_empty_command(char *command_string) {
-    if (command_string == NULL) {
+command *new_empty_command() {
+    arena *arena = new_arena();
+    if (arena == NULL) {
         return NULL;
     }
-    if (strlen(command_string) == 0) {
-        return NULL;
-    }
-    if (is_only_composed_of(command_string, COMMAND_SEPARATOR)) {
-        return NULL;
-    }
-
-    command *command = malloc(sizeof(*command));
 
+    command *command = arena_alloc(arena, sizeof(*command));
     if (command == NULL) {
-        perror("malloc");
+        destroy_arena(arena);
         return NULL;
     }
 
+    command->arena = arena;
+    command->calls = NULL;
     command->command_calls = NULL;
     command->command_call_count = 0;
     command->command_string = NULL;
     command->background = 0;
+    command->timed = 0;
+    memset(&command->controls, 0, sizeof(command->controls));
+    command->environment = NULL;
     command->open_pipes = NULL;
+    command->pipe_links = NULL;
+    command->pipe_indices = NULL;
     command->open_pipes_size = 0;
 
     return command;
@@ -170,779 +120,1031 @@ void destroy_command(command *command) {
         return;
     }
 
-    for (size_t i = 0; i < command->command_call_count; i++) {
-        destroy_command_call(command->command_calls[i]);
-    }
-    free(command->command_calls);
+    // The command itself lives in its arena
+    destroy_arena(command->arena);
+}
 
-    for (size_t i = 0; i < command->open_pipes_size; i++) {
-        free(command->open_pipes[i]);
+/**
+ * Allocates the contiguous array of `count` command calls of the command, along with the pointers to them.
+ * Returns -1 on failure.
+ */
+int alloc_command_calls(command *command, size_t count) {
+    command->calls = arena_alloc(command->arena, count * sizeof(command_call));
+    command->command_calls = arena_alloc(command->arena, count * sizeof(command_call *));
+    if (command->calls == NULL || command->command_calls == NULL) {
+        return -1;
     }
 
-    free(command->open_pipes);
-    free(command->command_string);
-    free(command);
+    for (size_t index = 0; index < count; ++index) {
+        command->command_calls[index] = &command->calls[index];
+    }
+    return 0;
 }
 
-typedef struct command_call_builder {
-    int *fds;
-    pipe_info *reading_pipes;
-    pipe_info *writing_pipes;
-
-} command_call_builder;
+/**
+ * Fills the reading and writing pipes of every command call from the pipe links, as consecutive
+ * ranges of a single array of indices. Returns -1 on failure.
+ */
+int index_pipes(command *command) {
+    for (size_t index = 0; index < command->command_call_count; ++index) {
+        command->calls[index].reading_pipes.pipe_count = 0;
+        command->calls[index].writing_pipes.pipe_count = 0;
+    }
+    if (command->open_pipes_size == 0) {
+        return 0;
+    }
 
-command_call_builder *new_command_call_builder() {
-    command_call_builder *c = malloc(sizeof(command_call));
+    // Every pipe has one writer and one reader
+    command->pipe_indices = arena_alloc(command->arena, 2 * command->open_pipes_size * sizeof(int));
+    if (command->pipe_indices == NULL) {
+        return -1;
+    }
 
-    if (c == NULL) {
-        perror("malloc");
-        return NULL;
+    for (size_t index = 0; index < command->open_pipes_size; ++index) {
+        command->calls[command->pipe_links[index].writer].writing_pipes.pipe_count++;
+        command->calls[command->pipe_links[index].reader].reading_pipes.pipe_count++;
     }
 
-    pipe_info *reading_pipe_info = new_pipe_info();
-    if (reading_pipe_info == NULL) {
-        return NULL;
+    int *range = command->pipe_indices;
+    for (size_t index = 0; index < command->command_call_count; ++index) {
+        command_call *command_call = &command->calls[index];
+        command_call->reading_pipes.pipes = range;
+        range += command_call->reading_pipes.pipe_count;
+        command_call->reading_pipes.pipe_count = 0;
+        command_call->writing_pipes.pipes = range;
+        range += command_call->writing_pipes.pipe_count;
+        command_call->writing_pipes.pipe_count = 0;
     }
 
-    pipe_info *writing_pipe_info = new_pipe_info();
-    if (writing_pipe_info == NULL) {
-        return NULL;
+    for (size_t index = 0; index < command->open_pipes_size; ++index) {
+        pipe_info *writing_pipes = &command->calls[command->pipe_links[index].writer].writing_pipes;
+        pipe_info *reading_pipes = &command->calls[command->pipe_links[index].reader].reading_pipes;
+        writing_pipes->pipes[writing_pipes->pipe_count++] = index;
+        reading_pipes->pipes[reading_pipes->pipe_count++] = index;
     }
+    return 0;
+}
 
-    int *fds = malloc(3 * sizeof(int));
-    if (fds == NULL) {
-        perror("malloc");
-        return NULL;
+int max_pipe_fd(command *command) {
+    int max_fd = -1;
+    for (size_t i = 0; i < command->open_pipes_size; i++) {
+        for (size_t end = 0; end < 2; end++) {
+            if (command->open_pipes[i][end] > max_fd) {
+                max_fd = command->open_pipes[i][end];
+            }
+        }
     }
+    return max_fd;
+}
 
-    fds[0] = UNINITIALIZED_FD;
-    fds[1] = UNINITIALIZED_FD;
-    fds[2] = UNINITIALIZED_FD;
+/** Registers a new pipe in the command and returns its index, -1 on failure. */
+int add_pipe_link(command *command, size_t writer, size_t reader, int argv_index, int to_file) {
+    pipe_link *pipe_links =
+        arena_grow_array(command->arena, command->pipe_links, command->open_pipes_size, sizeof(pipe_link));
+    if (pipe_links == NULL) {
+        return -1;
+    }
 
-    c->fds = fds;
-    c->reading_pipes = reading_pipe_info;
-    c->writing_pipes = writing_pipe_info;
+    command->pipe_links = pipe_links;
+    command->pipe_links[command->open_pipes_size].writer = writer;
+    command->pipe_links[command->open_pipes_size].reader = reader;
+    command->pipe_links[command->open_pipes_size].argv_index = argv_index;
+    command->pipe_links[command->open_pipes_size].to_file = to_file;
 
-    return c;
+    return command->open_pipes_size++;
 }
 
-void soft_destroy_command_call_builder(command_call_builder *builder) {
-    free(builder->fds);
-    free(builder);
+/** Returns the standard stream (0, 1 or 2) a redirection applies to. */
+int redirection_target(token_kind kind) {
+    switch (kind) {
+        case TOKEN_REDIRECT_STDIN:
+            return STDIN_FILENO;
+        case TOKEN_REDIRECT_STDOUT:
+        case TOKEN_REDIRECT_STDOUT_TRUNC:
+        case TOKEN_REDIRECT_STDOUT_APPEND:
+            return STDOUT_FILENO;
+        default:
+            return STDERR_FILENO;
+    }
 }
 
-void destroy_command_call_builder(command_call_builder *builder) {
-    if (builder == NULL) {
-        return;
+/** Returns 1 if one of the redirections applies to `target`, 0 otherwise. */
+int redirects(const redirection *redirections, size_t redirection_count, int target) {
+    for (size_t index = 0; index < redirection_count; ++index) {
+        if (redirection_target(redirections[index].kind) == target) {
+            return 1;
+        }
     }
+    return 0;
+}
 
-    destroy_pipe_info(builder->reading_pipes);
-    destroy_pipe_info(builder->writing_pipes);
-    free(builder->fds);
-    free(builder);
+/** Replaces `*target` by `fd`, closing the file descriptor it held before if needed. */
+void replace_fd(int *target, int fd) {
+    if (*target > 2) {
+        close(*target);
+    }
+    *target = fd;
 }
 
-pipe_info *new_pipe_info() {
-    pipe_info *pi = malloc(sizeof(pipe_info));
+/**
+ * Opens the file of the redirection and stores it in `fds` at the index of the stream it
+ * applies to, closing the file that was previously there.
+ * Returns -1 on failure.
+ */
+int open_redirection(int *fds, const redirection *redirection) {
+    int fd;
+
+    switch (redirection->kind) {
+        case TOKEN_REDIRECT_STDIN:
+            fd = open(redirection->path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                dprintf(STDERR_FILENO, "jsh: %s: %s\n", redirection->path, strerror(errno));
+                return -1;
+            }
+            break;
 
-    if (pi == NULL) {
-        perror("malloc");
-        return NULL;
+        case TOKEN_REDIRECT_STDOUT:
+        case TOKEN_REDIRECT_STDERR:
+            fd = open(redirection->path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd < 0) {
+                dprintf(STDERR_FILENO, "jsh: %s: cannot overwrite existing file.\n", redirection->path);
+                return -1;
+            }
+            break;
+
+        case TOKEN_REDIRECT_STDOUT_TRUNC:
+        case TOKEN_REDIRECT_STDERR_TRUNC:
+            fd = open(redirection->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            if (fd < 0) {
+                return -1;
+            }
+            break;
+
+        case TOKEN_REDIRECT_STDOUT_APPEND:
+        case TOKEN_REDIRECT_STDERR_APPEND:
+            fd = open(redirection->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+            if (fd < 0) {
+                return -1;
+            }
+            break;
+
+        default:
+            return -1;
     }
 
-    pi->pipes = NULL;
-    pi->pipe_count = 0;
-    return pi;
+    replace_fd(&fds[redirection_target(redirection->kind)], fd);
+    return 0;
 }
 
-void destroy_pipe_info(pipe_info *pi) {
-    if (pi == NULL) {
-        return;
+/**
+ * Opens the redirections of the command call, in the order in which they were written, storing
+ * in `fds` the file each standard stream ends up redirected to (UNINITIALIZED_FD if none).
+ * Returns -1 on failure, after closing everything it opened.
+ */
+int open_redirection_plan(const command_call *command_call, int *fds) {
+    for (int target = 0; target < 3; ++target) {
+        fds[target] = UNINITIALIZED_FD;
     }
 
-    if (pi->pipes != NULL) {
-        free(pi->pipes);
+    for (size_t index = 0; index < command_call->redirection_count; ++index) {
+        if (open_redirection(fds, &command_call->redirections[index]) == -1) {
+            close_unused_file_descriptors_from_array(fds, 3);
+            return -1;
+        }
     }
-    free(pi);
+    return 0;
 }
 
-int add_pipe(command *command, int *pipe) {
-    if (command == NULL) {
+int open_redirections(command_call *command_call) {
+    int fds[3];
+    if (open_redirection_plan(command_call, fds) == -1) {
         return -1;
     }
 
-    command->open_pipes = reallocarray(command->open_pipes, command->open_pipes_size + 1, sizeof(int *));
+    if (fds[0] != UNINITIALIZED_FD) {
+        command_call->stdin = fds[0];
+    }
+    if (fds[1] != UNINITIALIZED_FD) {
+        command_call->stdout = fds[1];
+    }
+    if (fds[2] != UNINITIALIZED_FD) {
+        command_call->stderr = fds[2];
+    }
+    return 0;
+}
 
-    if (command->open_pipes == NULL) {
-        perror("reallocarray");
+int apply_redirections(const command_call *command_call) {
+    int fds[3];
+    if (open_redirection_plan(command_call, fds) == -1) {
         return -1;
     }
 
-    command->open_pipes[command->open_pipes_size] = pipe;
-    command->open_pipes_size++;
-
+    for (int target = 0; target < 3; ++target) {
+        if (fds[target] == UNINITIALIZED_FD) {
+            continue;
+        }
+        if (dup2(fds[target], target) == -1) {
+            perror("dup2");
+            close_unused_file_descriptors_from_array(fds, 3);
+            return -1;
+        }
+        close(fds[target]);
+    }
     return 0;
 }
 
-void add_pipe_pipe_info(pipe_info *pi, int index) {
-    if (pi == NULL) {
-        return;
+int instantiate_command(command *command) {
+    size_t opened = 0;
+
+    if (command->open_pipes_size > 0) {
+        command->open_pipes = arena_alloc(command->arena, command->open_pipes_size * sizeof(*command->open_pipes));
+        if (command->open_pipes == NULL) {
+            return -1;
+        }
     }
 
-    if (pi->pipes == NULL) {
-        pi->pipes = malloc(sizeof(int));
+    for (; opened < command->open_pipes_size; ++opened) {
+        const pipe_link *link = &command->pipe_links[opened];
+        command_call *reader = &command->calls[link->reader];
 
-        if (pi->pipes == NULL) {
-            perror("malloc");
-            return;
+        int *fd = command->open_pipes[opened];
+        // Children only get the ends they need, by dup2 or by clearing the flag of their substitutions
+        if (pipe2(fd, O_CLOEXEC) == -1) {
+            perror("pipe2");
+            goto error;
         }
 
-        pi->pipes[0] = index;
-        pi->pipe_count++;
-        return;
-    }
+        command->calls[link->writer].stdout = fd[1];
 
-    pi->pipes = reallocarray(pi->pipes, pi->pipe_count + 1, sizeof(int));
+        if (link->argv_index == PIPE_TO_STDIN) {
+            reader->stdin = fd[0];
+        } else {
+            char dev_file[PATH_MAX];
+            snprintf(dev_file, PATH_MAX, "/dev/fd/%d", fd[0]);
 
-    if (pi->pipes == NULL) {
-        perror("reallocarray");
-        return;
+            reader->argv[link->argv_index] = arena_strdup(command->arena, dev_file);
+            if (reader->argv[link->argv_index] == NULL) {
+                ++opened;
+                goto error;
+            }
+        }
     }
 
-    pi->pipes[pi->pipe_count] = index;
-    pi->pipe_count++;
-    return;
+    return 0;
+
+error:
+    command->open_pipes_size = opened;
+    close_command_file_descriptors(command);
+    return -1;
 }
 
-void add_call_at_the_beginning(command *command, command_call *call) {
-    if (command == NULL || call == NULL) {
-        return;
+void close_command_file_descriptors(command *command) {
+    close_unused_file_descriptors(command);
+    for (size_t index = 0; index < command->open_pipes_size; ++index) {
+        close(command->open_pipes[index][0]);
+        close(command->open_pipes[index][1]);
     }
+}
 
-    command_call **new_command_calls = malloc((command->command_call_count + 1) * sizeof(command_call *));
-    if (new_command_calls == NULL) {
-        perror("malloc");
-        return;
+/**
+ * Copies the command call into `copy`, allocating its content in `arena`, without any opened
+ * file descriptor. Its pipes are left to `index_pipes`.
+ * Returns -1 on failure.
+ */
+int copy_command_call(arena *arena, command_call *copy, const command_call *template) {
+    char **argv = arena_alloc(arena, (template->argc + 1) * sizeof(char *));
+    char *command_string = arena_strdup(arena, template->command_string);
+    if (argv == NULL || command_string == NULL) {
+        return -1;
     }
 
-    new_command_calls[0] = call;
-
-    for (size_t index = 0; index < command->command_call_count; ++index) {
-        new_command_calls[index + 1] = command->command_calls[index];
+    for (size_t index = 0; index < template->argc; ++index) {
+        // Substitution arguments are only known once the command is instantiated
+        argv[index] = NULL;
+        if (template->argv[index] != NULL) {
+            argv[index] = arena_strdup(arena, template->argv[index]);
+            if (argv[index] == NULL) {
+                return -1;
+            }
+        }
     }
+    argv[template->argc] = NULL;
 
-    free(command->command_calls);
-    command->command_calls = new_command_calls;
-    command->command_call_count++;
-}
+    init_command_call(copy, template->argc, argv, command_string);
 
-void add_call_at_the_end(command *command, command_call *call) {
-    if (command == NULL || call == NULL) {
-        return;
+    if (template->redirection_count > 0) {
+        copy->redirections = arena_alloc(arena, template->redirection_count * sizeof(redirection));
+        if (copy->redirections == NULL) {
+            return -1;
+        }
     }
-
-    command->command_calls =
-        reallocarray(command->command_calls, command->command_call_count + 1, sizeof(command_call *));
-    if (command->command_calls == NULL) {
-        perror("reallocarray");
-        return;
+    for (size_t index = 0; index < template->redirection_count; ++index) {
+        copy->redirections[index].kind = template->redirections[index].kind;
+        copy->redirections[index].path = arena_strdup(arena, template->redirections[index].path);
+        if (copy->redirections[index].path == NULL) {
+            return -1;
+        }
     }
+    copy->redirection_count = template->redirection_count;
 
-    command->command_calls[command->command_call_count] = call;
-    command->command_call_count++;
+    return 0;
 }
 
-command_call *build_command(command_call_builder *builder, size_t argc, char **argv, char *command_string) {
-    command_call *command = new_command_call(argc, argv, command_string);
+command *copy_command(const command *template) {
+    command *command = new_empty_command();
     if (command == NULL) {
         return NULL;
     }
 
-    if (builder->fds[0] != UNINITIALIZED_FD) {
-        command->stdin = builder->fds[0];
+    command->background = template->background;
+    command->timed = template->timed;
+    command->command_string = arena_strdup(command->arena, template->command_string);
+    if (command->command_string == NULL || alloc_command_calls(command, template->command_call_count) == -1 ||
+        copy_launch_controls(command->arena, &command->controls, &template->controls) == -1) {
+        goto error;
     }
-    if (builder->fds[1] != UNINITIALIZED_FD) {
-        command->stdout = builder->fds[1];
+
+    for (size_t index = 0; index < template->command_call_count; ++index) {
+        if (copy_command_call(command->arena, &command->calls[index], &template->calls[index]) == -1) {
+            goto error;
+        }
+        command->command_call_count++;
     }
-    if (builder->fds[2] != UNINITIALIZED_FD) {
-        command->stderr = builder->fds[2];
+
+    if (template->open_pipes_size > 0) {
+        command->pipe_links = arena_alloc(command->arena, template->open_pipes_size * sizeof(pipe_link));
+        if (command->pipe_links == NULL) {
+            goto error;
+        }
+        memcpy(command->pipe_links, template->pipe_links, template->open_pipes_size * sizeof(pipe_link));
     }
+    command->open_pipes_size = template->open_pipes_size;
 
-    command->writing_pipes = builder->writing_pipes;
-    command->reading_pipes = builder->reading_pipes;
+    if (index_pipes(command) == -1) {
+        goto error;
+    }
 
     return command;
-}
 
-int parse_redirections(int *fds, char *redirection_symbol, char *filename) {
-    if (strcmp(redirection_symbol, "<") == 0) {
-        int fd = open(filename, O_RDONLY);
-        if (fd < 0) {
-            dprintf(STDERR_FILENO, "jsh: %s: %s\n", filename, strerror(errno));
-            return -1;
-        }
-        if (fds[0] > 2) {
-            close(fds[0]);
-        }
-        fds[0] = fd;
-        return 0;
-    } else if (strcmp(redirection_symbol, ">") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666);
-        if (fd < 0) {
-            dprintf(STDERR_FILENO, "jsh: %s: cannot overwrite existing file.\n", filename);
-            return -1;
-        }
-        if (fds[1] > 2) {
-            close(fds[1]);
-        }
-        fds[1] = fd;
-        return 0;
-
-    } else if (strcmp(redirection_symbol, ">|") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-        if (fd < 0) {
-            return -1;
-        }
-        if (fds[1] > 2) {
-            close(fds[1]);
-        }
-        fds[1] = fd;
-        return 0;
+error:
+    destroy_command(command);
+    return NULL;
+}
 
-    } else if (strcmp(redirection_symbol, ">>") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0666);
-        if (fd < 0) {
-            return -1;
-        }
-        if (fds[1] > 2) {
-            close(fds[1]);
-        }
-        fds[1] = fd;
-        return 0;
+typedef struct command_call_builder {
+    redirection *redirections;
+    size_t redirection_count;
+} command_call_builder;
 
-    } else if (strcmp(redirection_symbol, "2>") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666);
-        if (fd < 0) {
-            dprintf(STDERR_FILENO, "jsh: %s: cannot overwrite existing file.\n", filename);
-            return -1;
-        }
-        if (fds[2] > 2) {
-            close(fds[2]);
-        }
-        fds[2] = fd;
-        return 0;
+command_call_builder *new_command_call_builder(arena *arena) {
+    command_call_builder *c = arena_alloc(arena, sizeof(*c));
+    if (c == NULL) {
+        return NULL;
+    }
 
-    } else if (strcmp(redirection_symbol, "2>|") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-        if (fd < 0) {
-            return -1;
-        }
-        if (fds[2] > 2) {
-            close(fds[2]);
-        }
-        fds[2] = fd;
-        return 0;
+    c->redirections = NULL;
+    c->redirection_count = 0;
 
-    } else if (strcmp(redirection_symbol, "2>>") == 0) {
-        int fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0666);
-        if (fd < 0) {
-            return -1;
-        }
-        if (fds[2] > 2) {
-            close(fds[2]);
-        }
-        fds[2] = fd;
-        return 0;
-    }
-    return -1;
+    return c;
 }
 
-void update_dependencies(command_call_builder *builder, command_call *command_call, int index) {
-    if (builder == NULL) {
-        return;
+/** Adds a redirection to the builder, returns -1 on failure. */
+int add_redirection(arena *arena, command_call_builder *builder, token_kind kind, char *path) {
+    redirection *redirections =
+        arena_grow_array(arena, builder->redirections, builder->redirection_count, sizeof(redirection));
+    if (redirections == NULL) {
+        return -1;
     }
 
-    add_pipe_pipe_info(builder->reading_pipes, index);
-    add_pipe_pipe_info(command_call->writing_pipes, index);
+    builder->redirections = redirections;
+    builder->redirections[builder->redirection_count].kind = kind;
+    builder->redirections[builder->redirection_count].path = path;
+    builder->redirection_count++;
+    return 0;
 }
 
-int parse_command_substitution(command *command, command_call_builder *builder, char **command_string,
-                               size_t positions_left, size_t *index) {
+command_call *build_command(arena *arena, command_call_builder *builder, size_t argc, char **argv,
+                            char *command_string) {
+    command_call *command = new_command_call(arena, argc, argv, command_string);
+    if (command == NULL) {
+        return NULL;
+    }
 
-    last_parsed_command_call_substitution = NULL;
+    command->redirections = builder->redirections;
+    command->redirection_count = builder->redirection_count;
 
-    size_t i;
-    int starts_found = 0;
-    for (i = 0; i < positions_left; i++) {
-        if (strcmp(command_string[i], COMMAND_SUBSTITUTION_START) == 0) {
-            starts_found++;
-        }
-        if (strcmp(command_string[i], COMMAND_SUBSTITUTION_END) == 0) {
-            if (starts_found == 0) {
-                break;
-            }
-            starts_found--;
-        }
-    }
+    return command;
+}
 
-    // If we are at the end of the string or we have not found enough
-    // closing characters that means that the command is malformed.
-    if (i == positions_left || starts_found != 0) {
-        return -1;
-    }
+/** Value of `parser->closing` for a substitution that is never closed. */
+#define NO_CLOSING_TOKEN ((size_t)-1)
 
-    int pipe_pos = command->open_pipes_size;
+/**
+ * State shared while turning the tokens of a single command into its command calls.
+ * Tokens are views over `source`, nothing is copied until a command call is built.
+ * Calls are designated by their slot, their position in the source.
+ */
+typedef struct parser {
+    const char *source;
+    const token *tokens;
+    size_t start;         // index of the first token of the command
+    size_t *closing;      // closing[i - start] is the index of the `)` matching the `<(` or `=(` at index i
+    command *command;     // command whose pipes are being registered
+    command_call **calls; // calls in the order in which they appear in the source
+    size_t calls_count;
+    size_t max_depth; // maximal nesting of substitutions
+} parser;
+
+/** Returns a copy of the token, allocated in the arena of the command. */
+char *token_to_string(parser *parser, size_t index) {
+    const token *token = &parser->tokens[index];
+    return arena_strndup(parser->command->arena, parser->source + token->offset, token->length);
+}
 
-    int *fd = malloc(2 * sizeof(int));
+/** Returns a copy of the source spanned by the tokens from `start` to `end` (excluded). */
+char *span_to_string(parser *parser, size_t start, size_t end) {
+    const token *first = &parser->tokens[start];
+    const token *last = &parser->tokens[end - 1];
+    return arena_strndup(parser->command->arena, parser->source + first->offset,
+                         last->offset + last->length - first->offset);
+}
 
-    if (fd == NULL) {
-        perror("malloc");
+/**
+ * Matches every `<(` and `=(` with its `)` in a single pass, so that the rest of the parser
+ * can skip a whole substitution in constant time.
+ * Returns -1 on failure.
+ */
+int match_substitutions(parser *parser, size_t start, size_t end) {
+    size_t *stack = arena_alloc(parser->command->arena, (end - start) * sizeof(size_t));
+    if (stack == NULL) {
         return -1;
     }
+    size_t depth = 0;
+    parser->max_depth = 0;
 
-    if (pipe(fd) == -1) {
-        perror("pipe");
-        return -1;
+    for (size_t index = start; index < end; ++index) {
+        parser->closing[index - start] = NO_CLOSING_TOKEN;
+
+        if (is_substitution_start_token(&parser->tokens[index])) {
+            stack[depth++] = index;
+            if (depth > parser->max_depth) {
+                parser->max_depth = depth;
+            }
+        } else if (parser->tokens[index].kind == TOKEN_SUBSTITUTION_END && depth > 0) {
+            parser->closing[stack[--depth] - start] = index;
+        }
     }
 
-    add_pipe(command, fd);
+    return 0;
+}
 
-    char *joined_command = join_strings(command_string, i, " ");
-    if (joined_command == NULL) {
-        return -1;
+/**
+ * Returns the index of the pipe ending the pipeline stage starting at `start`,
+ * or `end` if it is the last one. Pipes inside a substitution are skipped.
+ * Sets `arguments` to the number of words and substitutions of the stage, at least its number of arguments.
+ */
+size_t find_stage_end(parser *parser, size_t start, size_t end, size_t *arguments) {
+    *arguments = 0;
+    for (size_t index = start; index < end; ++index) {
+        if (is_substitution_start_token(&parser->tokens[index])) {
+            ++*arguments;
+            size_t closing = parser->closing[index - parser->start];
+            if (closing == NO_CLOSING_TOKEN || closing >= end) {
+                return end;
+            }
+            index = closing;
+        } else if (parser->tokens[index].kind == TOKEN_WORD) {
+            ++*arguments;
+        } else if (parser->tokens[index].kind == TOKEN_PIPE) {
+            return index;
+        }
     }
-    command_call *call = parse_command_call(command, joined_command, 1, 0);
-    free(joined_command);
+    return end;
+}
 
-    if (last_parsed_command_call_substitution == NULL) {
+/**
+ * A pipeline being parsed, along with the command call of its current stage.
+ * Substitutions are parsed by pushing a new frame instead of recursing, so that the depth
+ * of the input does not translate into the depth of the C stack.
+ */
+typedef struct parse_frame {
+    size_t end; // end of the pipeline (excluded)
+    size_t stage_start;
+    size_t stage_end;
+    int followed_by_pipe;
+    int previous; // slot of the previous stage, -1 for the first one
+    size_t slot;
+    command_call_builder *builder;
+    char **argv;
+    size_t argc;
+    size_t index; // next token of the stage to read
+    int to_file;  // For substitutions, 1 if the output is stored in a file (`=(`) rather than piped (`<(`)
+} parse_frame;
+
+/**
+ * Starts the pipeline stage of the frame beginning at `stage_start`, registering its command call.
+ * Calls are registered before parsing their substitutions to keep the source order.
+ * Returns -1 on errors.
+ */
+int begin_stage(parser *parser, parse_frame *frame) {
+    size_t arguments;
+    frame->stage_end = find_stage_end(parser, frame->stage_start, frame->end, &arguments);
+    frame->followed_by_pipe = frame->stage_end < frame->end;
+
+    if (frame->stage_start == frame->stage_end || is_operator_token(&parser->tokens[frame->stage_start])) {
+        if (frame->followed_by_pipe) {
+            dprintf(STDERR_FILENO, "jsh: parse error near |\n");
+        } else {
+            dprintf(STDERR_FILENO, "jsh: parse error\n");
+        }
         return -1;
     }
 
-    if (call == NULL) {
-        return -1;
-    }
+    frame->slot = parser->calls_count++;
+    parser->calls[frame->slot] = NULL;
 
-    // The last element of process substitution should not redirect stdout
-    if (last_parsed_command_call_substitution->stdout != STDOUT_FILENO) {
-        destroy_command_call(call);
-        int fds[3] = {call->stdin, call->stdout, call->stderr};
-        close_unused_file_descriptors_from_array(fds, 3);
-        dprintf(STDERR_FILENO, "jsh: parse error\n");
+    frame->builder = new_command_call_builder(parser->command->arena);
+    if (frame->builder == NULL) {
         return -1;
     }
 
-    last_parsed_command_call_substitution->stdout = fd[1];
-
-    char *dev_file = malloc(PATH_MAX * sizeof(char));
-
-    if (dev_file == NULL) {
-        perror("malloc");
+    // Sized once for every argument and the final NULL, the tokens of the substitutions are not counted
+    frame->argc = 0;
+    frame->argv = arena_alloc(parser->command->arena, (arguments + 1) * sizeof(char *));
+    if (frame->argv == NULL) {
         return -1;
     }
+    frame->index = frame->stage_start;
+    return 0;
+}
 
-    snprintf(dev_file, PATH_MAX, "/dev/fd/%d", fd[0]);
+/**
+ * Reads the tokens of the current stage of the frame, until its end or until a substitution starts.
+ * Returns the index of the `<(` or `=(` starting a substitution, `stage_end` if the stage is over, -1 on errors.
+ */
+ssize_t read_stage(parser *parser, parse_frame *frame) {
+    arena *arena = parser->command->arena;
 
-    free(command_string[i]);
-    command_string[i] = dev_file;
+    for (; frame->index < frame->stage_end; ++frame->index) {
+        size_t index = frame->index;
+        const token *token = &parser->tokens[index];
 
-    for (size_t j = 0; j < i; j++) {
-        free(command_string[j]);
-        command_string[j] = NULL;
-    }
+        if (token->kind == TOKEN_WORD) {
+            frame->argv[frame->argc] = token_to_string(parser, index);
+            if (frame->argv[frame->argc] == NULL) {
+                return -1;
+            }
+            frame->argc++;
+            continue;
+        }
+
+        // Every operator needs a word after it
+        if (index == frame->stage_end - 1 || is_operator_token(&parser->tokens[index + 1])) {
+            if (index == frame->stage_end - 1 && !frame->followed_by_pipe) {
+                dprintf(STDERR_FILENO, "jsh: parse error\n");
+            } else {
+                dprintf(STDERR_FILENO, "jsh: parse error near %.*s\n", (int)token->length,
+                        parser->source + token->offset);
+            }
+            return -1;
+        }
 
-    *index = *index + i + 1;
+        if (is_substitution_start_token(token)) {
+            size_t closing = parser->closing[index - parser->start];
+            if (closing == NO_CLOSING_TOKEN || closing >= frame->stage_end) {
+                dprintf(STDERR_FILENO, "jsh: parse error near %.*s\n", (int)token->length,
+                        parser->source + token->offset);
+                return -1;
+            }
 
-    update_dependencies(builder, last_parsed_command_call_substitution, pipe_pos);
+            // The argument is the path of the pipe, it is filled in once the pipe is opened
+            frame->argv[frame->argc] = NULL;
+            frame->index = closing + 1;
+            return index;
+        }
 
-    last_parsed_command_call_substitution = NULL;
+        if (is_redirection_token(token)) {
+            char *path = token_to_string(parser, index + 1);
+            if (path == NULL || add_redirection(arena, frame->builder, token->kind, path) == -1) {
+                return -1;
+            }
+            ++frame->index;
+            continue;
+        }
 
-    add_call_at_the_end(command, call);
+        dprintf(STDERR_FILENO, "jsh: parse error near %.*s\n", (int)token->length, parser->source + token->offset);
+        return -1;
+    }
 
-    return 0;
+    return frame->stage_end;
 }
 
-int link_pipelines(command *command, command_call_builder *prev, command_call *call) {
-
-    int *fd = malloc(2 * sizeof(int));
+/**
+ * Builds the command call of the current stage of the frame once all its tokens are read, and pipes
+ * the previous stage into it.
+ * Reading from (resp. writing to) a pipe forbids redirecting stdin (resp. stdout).
+ * Returns -1 on errors.
+ */
+int end_stage(parser *parser, parse_frame *frame) {
+    arena *arena = parser->command->arena;
+    command_call_builder *builder = frame->builder;
 
-    if (fd == NULL) {
-        perror("malloc");
+    if (frame->previous != -1 && redirects(builder->redirections, builder->redirection_count, STDIN_FILENO)) {
+        dprintf(STDERR_FILENO, "jsh: parse error\n");
         return -1;
     }
 
-    if (pipe(fd) == -1) {
-        perror("pipe");
+    // If we are followed by a pipe we need to make sure that we do not have set an stdout, since
+    // we need to pipe the output of this command to the next one.
+    if (frame->followed_by_pipe && redirects(builder->redirections, builder->redirection_count, STDOUT_FILENO)) {
+        dprintf(STDERR_FILENO, "jsh: parse error near |\n");
         return -1;
     }
 
-    add_pipe_pipe_info(prev->writing_pipes, command->open_pipes_size);
-    add_pipe_pipe_info(call->reading_pipes, command->open_pipes_size);
+    frame->argv[frame->argc] = NULL;
 
-    add_pipe(command, fd);
+    char *command_string = span_to_string(parser, frame->stage_start, frame->stage_end);
+    if (command_string == NULL) {
+        return -1;
+    }
 
-    prev->fds[1] = fd[1];
-    call->stdin = fd[0];
+    command_call *command_call = build_command(arena, builder, frame->argc, frame->argv, command_string);
+    if (command_call == NULL) {
+        return -1;
+    }
+    parser->calls[frame->slot] = command_call;
 
+    if (frame->previous != -1 && add_pipe_link(parser->command, frame->previous, frame->slot, PIPE_TO_STDIN, 0) == -1) {
+        return -1;
+    }
     return 0;
 }
 
-char *sanitize_command_string(char *command_string) {
-    char *result = trim_spaces(command_string);
-    return result;
-}
-
-command *parse_command(char *command_string) {
-    command *command = new_empty_command(command_string);
+/**
+ * Links the pipeline of a substitution, whose last command call is in `last_slot`, to the
+ * argument of the command call of `frame` it is substituted to.
+ * Returns -1 on errors.
+ */
+int end_substitution(parser *parser, parse_frame *frame, size_t last_slot, int to_file) {
+    command_call *last_call = parser->calls[last_slot];
 
-    if (command == NULL) {
-        return NULL;
+    // The last element of process substitution should not redirect stdout
+    if (redirects(last_call->redirections, last_call->redirection_count, STDOUT_FILENO)) {
+        dprintf(STDERR_FILENO, "jsh: parse error\n");
+        return -1;
     }
 
-    char *sanitized_command_string = sanitize_command_string(command_string);
-    if (sanitized_command_string == NULL) {
-        destroy_command(command);
-        return NULL;
+    if (add_pipe_link(parser->command, last_slot, frame->slot, frame->argc, to_file) == -1) {
+        return -1;
     }
-    command->command_string = sanitized_command_string;
 
-    last_parsed_command_call = NULL;
-
-    command_call *call = parse_command_call(command, command_string, 0, 0);
-
-    if (call == NULL) {
-        if (last_parsed_command_call != NULL) {
-            // We add it to let command take care of closing the file descriptors and destroying the command call
-            add_call_at_the_end(command, last_parsed_command_call);
-        }
-        goto error;
-    }
+    frame->argc++;
+    return 0;
+}
 
-    if (last_parsed_command_call == NULL) {
-        // We add it to let command take care of closing the file descriptors and destroying the command call
-        add_call_at_the_end(command, call);
-        goto error;
+/**
+ * Parses the pipeline going from `start` to `end` (excluded), along with all its substitutions,
+ * using an explicit stack of frames bounded by the nesting of the substitutions.
+ * Returns the slot of the last command call of the pipeline, -1 on errors.
+ */
+int parse_pipeline(parser *parser, size_t start, size_t end) {
+    parse_frame *stack = arena_alloc(parser->command->arena, (parser->max_depth + 1) * sizeof(parse_frame));
+    if (stack == NULL) {
+        return -1;
     }
 
-    if (last_parsed_command_call != call) {
-        add_call_at_the_end(command, call);
+    size_t depth = 1;
+    stack[0].end = end;
+    stack[0].stage_start = start;
+    stack[0].previous = -1;
+    stack[0].to_file = 0;
+    if (begin_stage(parser, &stack[0]) == -1) {
+        return -1;
     }
 
-    add_call_at_the_beginning(command, last_parsed_command_call);
+    while (1) {
+        parse_frame *frame = &stack[depth - 1];
 
-    last_parsed_command_call = NULL;
-
-    return command;
+        ssize_t stop = read_stage(parser, frame);
+        if (stop == -1) {
+            return -1;
+        }
 
-error:
-    close_unused_file_descriptors(command);
-    if (command->open_pipes != NULL) {
-        for (size_t index = 0; index < command->open_pipes_size; ++index) {
-            if (command->open_pipes[index] == NULL) {
-                continue;
+        if ((size_t)stop < frame->stage_end) {
+            // A substitution starts at `stop`, it is parsed before the rest of the stage
+            parse_frame *substitution = &stack[depth++];
+            substitution->end = parser->closing[stop - parser->start];
+            substitution->stage_start = stop + 1;
+            substitution->previous = -1;
+            substitution->to_file = parser->tokens[stop].kind == TOKEN_FILE_SUBSTITUTION_START;
+            if (begin_stage(parser, substitution) == -1) {
+                return -1;
             }
-            close(command->open_pipes[index][0]);
-            close(command->open_pipes[index][1]);
+            continue;
         }
-    }
-    destroy_command(command);
-    return NULL;
-}
 
-char *remove_extra_pipes(char *command_string) {
-    char *result = malloc((strlen(command_string) + 1) * sizeof(char));
-    if (result == NULL) {
-        perror("malloc");
-        return NULL;
-    }
-
-    int found_substitutions = 0;
-    size_t i;
+        if (end_stage(parser, frame) == -1) {
+            return -1;
+        }
 
-    for (i = 0; i < strlen(command_string); i++) {
-        // I'd rather avoid this kind of hacks but for this time it's ok
-        if (command_string[i] == '(') {
-            found_substitutions++;
-        } else if (command_string[i] == ')') {
-            found_substitutions--;
-        } else {
-            // This means that we have a pipe that it's not inside a substitution
-            // so we ignore the rest of the string
-            if (command_string[i] == '|' && found_substitutions == 0) {
-                break;
+        if (frame->followed_by_pipe) {
+            frame->previous = frame->slot;
+            frame->stage_start = frame->stage_end + 1;
+            if (begin_stage(parser, frame) == -1) {
+                return -1;
             }
+            continue;
         }
-        result[i] = command_string[i];
-    }
 
-    result[i] = '\0';
-    result = reallocarray(result, i + 1, sizeof(char));
-    if (result == NULL) {
-        perror("reallocarray");
-        return NULL;
+        // The pipeline of the frame is over
+        --depth;
+        if (depth == 0) {
+            return frame->slot;
+        }
+        if (end_substitution(parser, &stack[depth - 1], frame->slot, frame->to_file) == -1) {
+            return -1;
+        }
     }
+}
 
-    return result;
+/** Returns 1 if the token is the word `word`, 0 otherwise. */
+int is_word_token(const char *source, const token *token, const char *word) {
+    return token->kind == TOKEN_WORD && token->length == strlen(word) &&
+           strncmp(source + token->offset, word, token->length) == 0;
 }
 
-command_call *parse_command_call(command *command, char *command_string, int inside_substitution, int inside_pipeline) {
-    size_t argc;
-    char **parsed_command_string = split_string(command_string, COMMAND_SEPARATOR, &argc);
-    if (argc == 0 || parsed_command_string == NULL) {
-        free(parsed_command_string);
-        return NULL;
-    }
+/** Returns 1 if the token is the `time` keyword, which is only one when a command follows it. */
+int is_time_keyword(const char *source, const token *tokens, size_t index, size_t end) {
+    return index + 1 < end && is_word_token(source, &tokens[index], TIME_KEYWORD);
+}
 
-    command_call_builder *command_builder = new_command_call_builder();
-    if (command_builder == NULL) {
-        for (size_t index = 0; index < argc; ++index) {
-            free(parsed_command_string[index]);
-        }
-        free(parsed_command_string);
-        return NULL;
-    }
+/**
+ * Reads the options following the `run` keyword at `index` into the controls of the command.
+ * Returns the index of the first token of the command, or -1 and prints an error if the options are invalid.
+ */
+ssize_t parse_run_options(parser *parser, size_t index, size_t end) {
+    const char *source = parser->source;
+    launch_controls *controls = &parser->command->controls;
 
-    /*
-     * For each argument,
-     *  - if it is not a caret symbol, pass
-     *  - if the symbol isn't followed by a correct argument; return NULL
-     *          -> A wrong argument could be NULL or also a caret symbol
-     *
-     *  - Then parse caret symbol and filename to file descriptor
-     *  - If correctly parsed, map both to NULL arguments
-     */
-    for (size_t index = 0; index < argc; ++index) {
-        if (!contains_string(redirection_caret_symbols, REDIRECTION_CARET_SYMBOLS_COUNT,
-                             parsed_command_string[index])) {
-            continue;
+    ++index;
+    while (index < end && parser->tokens[index].kind == TOKEN_WORD && source[parser->tokens[index].offset] == '-') {
+        if (is_word_token(source, &parser->tokens[index], RUN_END_OF_OPTIONS)) {
+            ++index;
+            break;
         }
 
-        if (index == argc - 1 || parsed_command_string[index + 1] == NULL || index == 0) {
-            dprintf(STDERR_FILENO, "jsh: parse error\n");
-            goto error;
+        char *option = token_to_string(parser, index);
+        if (option == NULL) {
+            return -1;
         }
-
-        if (contains_string(redirection_caret_symbols, REDIRECTION_CARET_SYMBOLS_COUNT,
-                            parsed_command_string[index + 1])) {
-            dprintf(STDERR_FILENO, "jsh: parse error near %s\n", parsed_command_string[index]);
-            goto error;
+        if (index + 1 == end || parser->tokens[index + 1].kind != TOKEN_WORD) {
+            dprintf(STDERR_FILENO, "jsh: %s: %s: missing value\n", RUN_KEYWORD, option);
+            return -1;
         }
 
-        if (strcmp(parsed_command_string[index], COMMAND_SUBSTITUTION_START) == 0) {
-            free(parsed_command_string[index]);
-            parsed_command_string[index] = NULL;
-
-            if (parse_command_substitution(command, command_builder, parsed_command_string + index + 1,
-                                           argc - index - 1, &index) == -1) {
-
-                dprintf(STDERR_FILENO, "jsh: parse error near %s\n", parsed_command_string[index]);
-                goto error;
-            }
-        } else if (strcmp(parsed_command_string[index], PIPE_SYMBOL) == 0) {
-            // If we find a pipe symbol we need to make sure that we do not have set an stdout, since
-            // we need to pipe the output of this command to the next one.
-            if (command_builder->fds[1] != UNINITIALIZED_FD) {
-                dprintf(STDERR_FILENO, "jsh: parse error near %s\n", parsed_command_string[index]);
-                goto error;
-            }
-            char *joined = join_strings(parsed_command_string + index + 1, argc - index - 1, " ");
-
-            command_call *pipped_command_call = parse_command_call(command, joined, inside_substitution, 1);
-            free(joined);
-            if (pipped_command_call == NULL) {
-                dprintf(STDERR_FILENO, "jsh: parse error near %s\n", parsed_command_string[index]);
-                goto error;
-            }
-
-            if (link_pipelines(command, command_builder, pipped_command_call) == -1) {
-                dprintf(STDERR_FILENO, "jsh: parse error near %s\n", parsed_command_string[index]);
-                goto error;
-            }
+        char *value = token_to_string(parser, index + 1);
+        if (value == NULL) {
+            return -1;
+        }
+        if (add_launch_control(controls, parser->command->arena, option, value, STDERR_FILENO) == -1) {
+            return -1;
+        }
+        index += 2;
+    }
 
-            if (last_parsed_command_call != pipped_command_call || inside_substitution) {
-                add_call_at_the_end(command, pipped_command_call);
-            }
+    if (index == end) {
+        dprintf(STDERR_FILENO, "jsh: %s: missing command\n", RUN_KEYWORD);
+        return -1;
+    }
+    return index;
+}
 
-            // A pipe indicated the end of a command, so no need to parse the rest since
-            // `pipped_command_call` has already done it.
-            for (size_t i = index; i < argc; i++) {
-                free(parsed_command_string[i]);
-                parsed_command_string[i] = NULL;
-            }
+/**
+ * Builds the template of the command made of the tokens going from `start` to `end` (excluded).
+ * The last command call of the main pipeline is placed first, since it is the one
+ * whose exit code is the one of the command.
+ */
+command *parse_command_tokens(const char *source, const token *tokens, size_t start, size_t end) {
+    if (start == end) {
+        return NULL;
+    }
 
-            break;
-        } else {
-            int status = parse_redirections(command_builder->fds, parsed_command_string[index],
-                                            parsed_command_string[index + 1]);
+    command *command = new_empty_command();
+    if (command == NULL) {
+        return NULL;
+    }
 
-            if (status < 0) {
-                goto error;
-            }
+    parser parser = {.source = source, .tokens = tokens, .start = start, .command = command, .calls_count = 0};
+    parser.closing = arena_alloc(command->arena, (end - start) * sizeof(size_t));
+    parser.calls = arena_alloc(command->arena, (end - start) * sizeof(command_call *));
+    if (parser.closing == NULL || parser.calls == NULL) {
+        goto error;
+    }
 
-            free(parsed_command_string[index]);
-            free(parsed_command_string[index + 1]);
+    if (match_substitutions(&parser, start, end) == -1) {
+        goto error;
+    }
 
-            parsed_command_string[index] = NULL;
-            parsed_command_string[index + 1] = NULL;
-            ++index;
-        }
+    command->command_string = span_to_string(&parser, start, end);
+    if (command->command_string == NULL) {
+        goto error;
     }
 
-    if (inside_pipeline) {
-        if (command_builder->fds[0] != UNINITIALIZED_FD) {
-            dprintf(STDERR_FILENO, "jsh: parse error\n");
+    // The keyword stays in the string of the command, as it is shown by `jobs`
+    size_t first = start;
+    if (is_time_keyword(source, tokens, start, end)) {
+        command->timed = 1;
+        ++first;
+    }
+    if (first + 1 < end && is_word_token(source, &tokens[first], RUN_KEYWORD)) {
+        ssize_t command_start = parse_run_options(&parser, first, end);
+        if (command_start == -1) {
             goto error;
         }
-
-        // This condition means that we are inside a pipeline
-        // but not at the end, which means that we are not allowed to redirect stdout.
-        if (!(last_parsed_command_call == NULL || last_parsed_command_call_substitution == NULL)) {
-            if (command_builder->fds[1] != UNINITIALIZED_FD) {
-                dprintf(STDERR_FILENO, "jsh: parse error\n");
-                goto error;
-            }
-        }
+        first = command_start;
     }
 
-    int not_null_arguments = 0;
-
-    // Filter non NULL arguments
-    for (size_t index = 0; index < argc; ++index) {
-        if (parsed_command_string[index] != NULL) {
-            not_null_arguments += 1;
-        }
+    int last_slot = parse_pipeline(&parser, first, end);
+    if (last_slot == -1) {
+        goto error;
     }
 
-    char **redirection_parsed_command_string = malloc((not_null_arguments + 1) * sizeof(char *));
-    if (redirection_parsed_command_string == NULL) {
-        perror("malloc");
+    size_t *positions = arena_alloc(command->arena, parser.calls_count * sizeof(size_t));
+    if (positions == NULL || alloc_command_calls(command, parser.calls_count) == -1) {
         goto error;
     }
-    redirection_parsed_command_string[not_null_arguments] = NULL;
 
-    for (size_t index = 0, new_index = 0; index < argc; ++index) {
-        if (parsed_command_string != NULL && parsed_command_string[index] != NULL) {
-            redirection_parsed_command_string[new_index] = parsed_command_string[index];
-            new_index++;
+    positions[last_slot] = command->command_call_count;
+    command->calls[command->command_call_count++] = *parser.calls[last_slot];
+    for (size_t slot = parser.calls_count; slot > 0; --slot) {
+        if (slot - 1 != (size_t)last_slot) {
+            positions[slot - 1] = command->command_call_count;
+            command->calls[command->command_call_count++] = *parser.calls[slot - 1];
         }
     }
 
-    free(parsed_command_string);
-
-    char *trimmed_command_string = sanitize_command_string(command_string);
-    if (trimmed_command_string == NULL) {
-        free(redirection_parsed_command_string);
-        return NULL;
-    }
-    char *removed_extra_pipes = remove_extra_pipes(trimmed_command_string);
-    if (removed_extra_pipes == NULL) {
-        free(trimmed_command_string);
-        free(redirection_parsed_command_string);
-        return NULL;
+    // Pipes were registered using slots
+    for (size_t index = 0; index < command->open_pipes_size; ++index) {
+        command->pipe_links[index].writer = positions[command->pipe_links[index].writer];
+        command->pipe_links[index].reader = positions[command->pipe_links[index].reader];
     }
-    free(trimmed_command_string);
-    command_call *command_call =
-        build_command(command_builder, not_null_arguments, redirection_parsed_command_string, removed_extra_pipes);
-    free(removed_extra_pipes);
-    soft_destroy_command_call_builder(command_builder);
 
-    if (last_parsed_command_call == NULL && !inside_substitution) {
-        last_parsed_command_call = command_call;
-    }
-
-    if (last_parsed_command_call_substitution == NULL && inside_substitution) {
-        last_parsed_command_call_substitution = command_call;
+    if (index_pipes(command) == -1) {
+        goto error;
     }
 
-    return command_call;
+    return command;
 
 error:
-    for (size_t index = 0; index < argc; ++index) {
-        free(parsed_command_string[index]);
-    }
-    free(parsed_command_string);
-    close_unused_file_descriptors_from_array(command_builder->fds, 3);
-    destroy_command_call_builder(command_builder);
-
+    destroy_command(command);
     return NULL;
 }
 
-command **parse_read_line(char *command_string, size_t *total_commands) {
+command *parse_command(char *command_string) {
+    size_t size;
+    token *tokens = tokenize(command_string, &size);
 
-    if (starts_with(command_string, BACKGROUND_FLAG)) {
-        *total_commands = 0;
+    command *command = parse_command_tokens(command_string, tokens, 0, size);
+    free(tokens);
+
+    if (command != NULL && instantiate_command(command) == -1) {
+        destroy_command(command);
         return NULL;
     }
+    return command;
+}
 
-    // Split with BACKGROUND_FLAG
-    int last_background_command_index = -1;
-    char **bg_flag_parsed =
-        split_string_keep_trace(command_string, BACKGROUND_FLAG, total_commands, &last_background_command_index);
+command **parse_read_line_templates(char *command_string, size_t *total_commands, int *dropped_last,
+                                    int *reported_error) {
+    *total_commands = 0;
+    *dropped_last = 0;
+    *reported_error = 0;
 
-    if (bg_flag_parsed == NULL) {
+    if (starts_with(command_string, BACKGROUND_FLAG)) {
         return NULL;
     }
 
-    command **commands = malloc(*total_commands * sizeof(command_call));
+    size_t size;
+    token *tokens = tokenize(command_string, &size);
+    if (tokens == NULL) {
+        return NULL;
+    }
+
+    // Commands are separated by BACKGROUND_FLAG, two flags next to each other
+    // (or a flag at the end of the line) do not delimit any command.
+    size_t commands_capacity = 1;
+    for (size_t index = 0; index < size; ++index) {
+        commands_capacity += tokens[index].kind == TOKEN_BACKGROUND;
+    }
+
+    command **commands = malloc(commands_capacity * sizeof(command *));
     if (commands == NULL) {
         perror("malloc");
-        for (size_t index = 0; index < *total_commands; ++index) {
-            free(bg_flag_parsed[index]);
-        }
-        free(bg_flag_parsed);
+        free(tokens);
         return NULL;
     }
 
-    // Parse each command
-    int abort = 0, trim_last = 0;
-    for (size_t index = 0; index < *total_commands; ++index) {
-        commands[index] = NULL;
-        if (!abort) {
-            commands[index] = parse_command(bg_flag_parsed[index]);
+    // Only the last command holding something other than flags is allowed to be malformed
+    size_t length = strlen(command_string);
+    size_t content_end = length;
+    while (content_end > 0 && command_string[content_end - 1] == '&') {
+        --content_end;
+    }
+
+    size_t segment_offset = 0;
+    size_t segment_start = 0;
+
+    for (size_t index = 0; index <= size; ++index) {
+        int is_end = index == size;
+        if (!is_end && tokens[index].kind != TOKEN_BACKGROUND) {
+            continue;
+        }
 
-            if (commands[index] == NULL) {
+        size_t segment_end_offset = is_end ? length : tokens[index].offset;
+        if (segment_end_offset > segment_offset) {
+            command *command = parse_command_tokens(command_string, tokens, segment_start, index);
+
+            if (command == NULL) {
                 last_exit_code = 1;
-                if (index == *total_commands - 1) {
-                    trim_last = 1;
-                } else {
-                    abort = 1;
+                *dropped_last = 1;
+                // Blank commands are the only ones failing silently
+                *reported_error |= segment_start != index;
+
+                // A malformed last command is simply dropped
+                if (segment_end_offset < content_end) {
+                    for (size_t to_free = 0; to_free < *total_commands; ++to_free) {
+                        destroy_command(commands[to_free]);
+                    }
+                    free(commands);
+                    free(tokens);
+                    *total_commands = 0;
+                    return NULL;
                 }
             } else {
-                if ((int)((ssize_t)index) <= last_background_command_index) {
-                    commands[index]->background = 1;
-                }
+                command->background = !is_end;
+                commands[(*total_commands)++] = command;
             }
         }
+
+        if (!is_end) {
+            segment_offset = tokens[index].offset + 1;
+            segment_start = index + 1;
+        }
     }
 
-    for (size_t index = 0; index < *total_commands; ++index) {
-        free(bg_flag_parsed[index]);
+    free(tokens);
+
+    if (*total_commands == 0) {
+        free(commands);
+        return NULL;
     }
-    free(bg_flag_parsed);
 
-    if (abort) {
+    return commands;
+}
+
+command **instantiate_commands(command **commands, size_t *total_commands, int dropped_last) {
+    for (size_t index = 0; index < *total_commands; ++index) {
+        if (instantiate_command(commands[index]) == 0) {
+            continue;
+        }
+
+        last_exit_code = 1;
+
+        // The last command can be dropped, unless it was not the last one of the line
+        if (index == *total_commands - 1 && !dropped_last) {
+            destroy_command(commands[index]);
+            *total_commands -= 1;
+            break;
+        }
+
+        // Only the commands before this one have been instantiated
         for (size_t to_free = 0; to_free < *total_commands; ++to_free) {
-            free(commands[to_free]);
+            if (to_free < index) {
+                close_command_file_descriptors(commands[to_free]);
+            }
+            destroy_command(commands[to_free]);
         }
         free(commands);
+        *total_commands = 0;
         return NULL;
     }
 
-    if (!trim_last) {
-        return commands;
-    }
-
-    if (*total_commands == 1) {
+    if (*total_commands == 0) {
         free(commands);
         return NULL;
     }
 
-    *total_commands -= 1;
-    commands = reallocarray(commands, *total_commands, sizeof(command_call));
+    return commands;
+}
 
+command **parse_read_line(char *command_string, size_t *total_commands) {
+    int dropped_last;
+    int reported_error;
+
+    command **commands = parse_read_line_templates(command_string, total_commands, &dropped_last, &reported_error);
     if (commands == NULL) {
-        perror("reallocarray");
         return NULL;
     }
 
-    return commands;
+    return instantiate_commands(commands, total_commands, dropped_last);
 }
@@ -1,6 +1,10 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
+#include "arena.h"
+#include "launch_controls.h"
+#include "lexer.h"
+
 #include <linux/limits.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -8,36 +12,31 @@
 #include <string.h>
 #include <unistd.h>
 
-#define REDIRECTION_CARET_SYMBOLS_COUNT 10
-#define INTERNAL_COMMANDS_COUNT 8
+#define INTERNAL_COMMANDS_COUNT 13
 #define UNINITIALIZED_PID -2
 
-/** Separator used to split commands. In our case a single space character. */
-#define COMMAND_SEPARATOR " "
-
 /** Indicator of a background execution. */
 #define BACKGROUND_FLAG "&"
 
-#define COMMAND_SUBSTITUTION_START "<("
-#define COMMAND_SUBSTITUTION_END ")"
-#define PIPE_SYMBOL "|"
+/** Keyword prefixing a command whose resource usage is printed once it is over. */
+#define TIME_KEYWORD "time"
 
 /** Array of internal command names. */
 extern const char internal_commands[INTERNAL_COMMANDS_COUNT][100];
 
-/** Array of possible caret symbols. */
-extern const char *redirection_caret_symbols[REDIRECTION_CARET_SYMBOLS_COUNT];
-
+/** Indices of the pipes a command call reads from or writes to.
+ *  It is a range of the `pipe_indices` shared by all the command calls of a command.
+ */
 typedef struct pipe_info {
     int *pipes;
     size_t pipe_count;
 } pipe_info;
 
-pipe_info *new_pipe_info();
-
-void destroy_pipe_info(pipe_info *);
-
-void add_pipe_pipe_info(pipe_info *, int);
+/** A redirection of one of the standard streams to a file, opened when the command is instantiated. */
+typedef struct redirection {
+    token_kind kind;
+    char *path;
+} redirection;
 
 /** Structure that represents a command call. */
 typedef struct command_call {
@@ -45,21 +44,20 @@ typedef struct command_call {
     size_t argc;
     char **argv;
     char *command_string;
-    pipe_info *reading_pipes;
-    pipe_info *writing_pipes;
+    pipe_info reading_pipes;
+    pipe_info writing_pipes;
+    redirection *redirections; // In the order in which they were written
+    size_t redirection_count;
     int stdin;
     int stdout;
     int stderr;
 } command_call;
 
-/** Returns a new command call with the given argc, argv and string used to call it. */
-command_call *new_command_call(size_t argc, char **argv, char *command_string);
-
-/** Frees the memory allocated for the command call.
- * It also destroys all of its dependencies.
- * Calls for `close_unused_file_descriptors`.
+/** Returns a new command call with the given argc, argv and string used to call it.
+ *  The command call is allocated in `arena`, as `argv` and `command_string` should be,
+ *  they are not copied.
  */
-void destroy_command_call(command_call *command_call);
+command_call *new_command_call(arena *arena, size_t argc, char **argv, char *command_string);
 
 /** Prints the command call to `fd`, following the format:
  *  name argv[0] argv[1] ... argv[argc - 1]
@@ -69,20 +67,70 @@ void command_call_print(command_call *command_call, int fd);
 /** Returns 1 if the command call is an internal command, 0 otherwise. */
 int is_internal_command(command_call *command_call);
 
+/** Returns 1 if `name` is the name of an internal command, 0 otherwise. */
+int is_internal_command_name(const char *name);
+
+/** Value of `pipe_link.argv_index` for a pipe plugged to the standard input of its reader. */
+#define PIPE_TO_STDIN -1
+
+/** Describes where a pipe of a command is plugged, using the indices of its command calls. */
+typedef struct pipe_link {
+    size_t writer;
+    size_t reader;
+    int argv_index; // For substitutions, the argument of the reader receiving the path of the pipe
+    int to_file;    // For `=(` substitutions, the output is stored in a file before the reader starts
+} pipe_link;
+
+/** Structure that represents a command.
+ *  Everything it points to is allocated in its arena, including itself.
+ */
 typedef struct command {
+    arena *arena;
     char *command_string;
-    command_call **command_calls;
+    command_call *calls;          // The command calls, stored contiguously
+    command_call **command_calls; // command_calls[i] points to calls[i]
     size_t command_call_count;
-    int background; // 1 if the command is to be executed in background, 0 otherwise
-    int **open_pipes;
+    int background;        // 1 if the command is to be executed in background, 0 otherwise
+    int timed;             // 1 if the command is prefixed by `TIME_KEYWORD`
+    launch_controls controls; // Set by the options of `RUN_KEYWORD`
+    char **environment;       // Environment of its processes while they are launched, NULL for the one of the shell
+    int (*open_pipes)[2];  // NULL until the command is instantiated
+    pipe_link *pipe_links; // One for each pipe
+    int *pipe_indices;     // Reading and writing pipes of every command call, one range per call
     size_t open_pipes_size;
 } command;
 
-command *new_command(command_call **call, size_t command_call_count, int **open_pipes, size_t open_pipes_size,
-                     char *command_string);
+/** Returns a new command without any command call, owning a new arena. */
+command *new_empty_command();
 
+/** Frees the command and everything allocated in its arena at once. */
 void destroy_command(command *command);
 
+/** Returns a deep copy of the command, which should not have been instantiated. */
+command *copy_command(const command *command);
+
+/** Opens the pipes of a parsed command, its redirections are only opened when it is executed.
+ *  Returns -1 on failure, in which case everything opened is closed and the command should be destroyed.
+ */
+int instantiate_command(command *command);
+
+/** Returns the highest file descriptor used by the pipes of the command, -1 if it has none. */
+int max_pipe_fd(command *command);
+
+/** Closes the pipes of an instantiated command, and the redirections opened for its internal commands. */
+void close_command_file_descriptors(command *command);
+
+/** Opens the redirections of the command call and makes its streams point to them.
+ *  Used in the shell for internal commands, the files are closed with the other file descriptors of the command.
+ *  Returns -1 on failure.
+ */
+int open_redirections(command_call *command_call);
+
+/** Opens the redirections of the command call onto the standard streams of the current process.
+ *  Meant to be called in the child, right before `execvp`. Returns -1 on failure.
+ */
+int apply_redirections(const command_call *command_call);
+
 /** Parse unique command string to `command_call`.
  *  Returns `command_call` if correctly written, NULL otherwise.
  *
@@ -93,9 +141,23 @@ void destroy_command(command *command);
  */
 command *parse_command(char *command_string);
 
-/** Parses the command string and returns an array of commands. */
+/** Parses the command string and returns an array of commands, ready to be executed. */
 command **parse_read_line(char *command, size_t *total_commands);
 
+/** Parses the command string and returns an array of commands that are not instantiated yet:
+ *  no pipe has been created and no file has been opened.
+ *  `dropped_last` is set if a malformed last command was dropped and `reported_error`
+ *  if an error message was printed while parsing.
+ */
+command **parse_read_line_templates(char *command, size_t *total_commands, int *dropped_last, int *reported_error);
+
+/** Instantiates the commands returned by `parse_read_line_templates`.
+ *  If one of them fails, the whole line is dropped, unless it is the last command
+ *  and `dropped_last` is not set, in which case only the last command is dropped.
+ *  Returns NULL if nothing is left to execute.
+ */
+command **instantiate_commands(command **commands, size_t *total_commands, int dropped_last);
+
 /** Structure that represents the result of a command.
  *  - If the command is an internal command or it is ran on foreground then
  *  `pid` is set to `UNINITIALIZED_PID` and `job_id` to `UNINITIALIZED_JOB_ID`.
@@ -113,7 +175,7 @@ typedef struct command_result {
 command_result *new_command_result(int exit_code, command *command);
 
 /** Frees the memory allocated for the command result.
- *  Calls `destroy_command_call` to free `command_result-> call`.
+ *  Calls `destroy_command` to free `command_result-> command`.
  */
 void destroy_command_result(command_result *command_result);
 
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE // memfd_create, splice and O_TMPFILE
+
+#include "file_substitution.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/** Number of bytes moved from a pipe at once, the default capacity of a pipe. */
+#define SPOOL_CHUNK_SIZE 65536
+
+/** Directory of the temporary files when `TMPDIR` is not set. */
+#define DEFAULT_TEMPORARY_DIRECTORY "/tmp"
+
+/** The output of a `=(` substitution being stored. */
+typedef struct spool {
+    int pipe_fd; // Read end of the pipe, replaced by the file once the output is complete
+    int file_fd;
+    off_t size;
+    int in_memory;
+} spool;
+
+int *file_substitution_phases(command *command, size_t *phase_count) {
+    int *phases = calloc(command->command_call_count, sizeof(int));
+    if (phases == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+
+    // Each call writes to a single pipe, the links form a tree rooted in the main pipeline
+    *phase_count = 1;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (size_t index = 0; index < command->open_pipes_size; ++index) {
+            const pipe_link *link = &command->pipe_links[index];
+            int phase = phases[link->reader] + link->to_file;
+            if (phases[link->writer] < phase) {
+                phases[link->writer] = phase;
+                changed = 1;
+                if ((size_t)phase >= *phase_count) {
+                    *phase_count = phase + 1;
+                }
+            }
+        }
+    }
+
+    return phases;
+}
+
+/** Opens an anonymous file in `TMPDIR`, closed on exec. Returns -1 on failure. */
+int open_temporary_file() {
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || *directory == '\0') {
+        directory = DEFAULT_TEMPORARY_DIRECTORY;
+    }
+
+    int fd = open(directory, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd != -1 || (errno != EOPNOTSUPP && errno != EISDIR)) {
+        if (fd == -1) {
+            perror("open");
+        }
+        return fd;
+    }
+
+    // The file system does not support unnamed files, the name is removed right away instead
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/jsh-substitution-XXXXXX", directory);
+    fd = mkostemp(path, O_CLOEXEC);
+    if (fd == -1) {
+        perror("mkostemp");
+        return -1;
+    }
+    unlink(path);
+    return fd;
+}
+
+/** Moves what was stored in memory so far to a temporary file. Returns -1 on failure. */
+int spill_spool(spool *spool) {
+    int file_fd = open_temporary_file();
+    if (file_fd == -1) {
+        return -1;
+    }
+
+    off_t offset = 0;
+    while (offset < spool->size) {
+        if (sendfile(file_fd, spool->file_fd, &offset, spool->size - offset) == -1) {
+            perror("sendfile");
+            close(file_fd);
+            return -1;
+        }
+    }
+
+    close(spool->file_fd);
+    spool->file_fd = file_fd;
+    spool->in_memory = 0;
+    return 0;
+}
+
+/** Copies a chunk of the pipe to the file without splice. Returns the number of bytes copied, -1 on failure. */
+ssize_t copy_chunk(int pipe_fd, int file_fd) {
+    char buffer[SPOOL_CHUNK_SIZE];
+    ssize_t length = read(pipe_fd, buffer, sizeof(buffer));
+    for (ssize_t written = 0; written < length;) {
+        ssize_t count = write(file_fd, buffer + written, length - written);
+        if (count == -1) {
+            return -1;
+        }
+        written += count;
+    }
+    return length;
+}
+
+/**
+ * Moves what is available in the pipe of the spool to its file.
+ * Returns the number of bytes moved, 0 at the end of the output, -1 on failure.
+ */
+ssize_t fill_spool(spool *spool) {
+    ssize_t moved = splice(spool->pipe_fd, NULL, spool->file_fd, NULL, SPOOL_CHUNK_SIZE, 0);
+    if (moved == -1 && errno == EINVAL) {
+        // Some file systems cannot be spliced to
+        moved = copy_chunk(spool->pipe_fd, spool->file_fd);
+    }
+    if (moved == -1) {
+        perror("splice");
+    }
+    if (moved <= 0) {
+        return moved;
+    }
+
+    spool->size += moved;
+    if (spool->in_memory && spool->size > FILE_SUBSTITUTION_MEMORY_CAP && spill_spool(spool) == -1) {
+        return -1;
+    }
+    return moved;
+}
+
+/** Returns 1 if one of the processes of the group is stopped, 0 otherwise. */
+int is_group_stopped(pid_t pgid) {
+    siginfo_t info = {0};
+    return waitid(P_PGID, pgid, &info, WSTOPPED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0;
+}
+
+/** Reads every pipe until its end, the producers run concurrently. Returns -1 on failure. */
+int drain_spools(spool *spools, size_t count, pid_t pgid) {
+    struct pollfd *fds = malloc(count * sizeof(struct pollfd));
+    if (fds == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    for (size_t index = 0; index < count; ++index) {
+        fds[index].fd = spools[index].pipe_fd;
+        fds[index].events = POLLIN;
+    }
+
+    size_t remaining = count;
+    while (remaining > 0) {
+        int ready = poll(fds, count, FILE_SUBSTITUTION_POLL_INTERVAL_MS);
+        if (ready == -1 && errno != EINTR) {
+            perror("poll");
+            goto error;
+        }
+
+        if (ready == 0 && is_group_stopped(pgid)) {
+            dprintf(STDERR_FILENO, "jsh: stopped while running a =( substitution\n");
+            goto error;
+        }
+
+        for (size_t index = 0; ready > 0 && index < count; ++index) {
+            if (fds[index].fd == -1 || fds[index].revents == 0) {
+                continue;
+            }
+
+            ssize_t moved = fill_spool(&spools[index]);
+            if (moved == -1) {
+                goto error;
+            }
+            if (moved == 0) {
+                fds[index].fd = -1; // Ignored by poll from now on
+                --remaining;
+            }
+        }
+    }
+
+    free(fds);
+    return 0;
+
+error:
+    free(fds);
+    return -1;
+}
+
+int spool_file_substitutions(command *command, const int *phases, int phase, pid_t pgid) {
+    spool *spools = malloc(command->open_pipes_size * sizeof(spool));
+    if (spools == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    // The shell keeps the numbers of the pipes of the phase taken until the command is over, but not the pipes
+    // themselves, otherwise their readers would never see the end of their input
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (null_fd == -1) {
+        perror("open");
+        free(spools);
+        return -1;
+    }
+
+    size_t count = 0;
+    int result = -1;
+    for (size_t index = 0; index < command->open_pipes_size; ++index) {
+        const pipe_link *link = &command->pipe_links[index];
+        if (phases[link->writer] != phase) {
+            continue;
+        }
+
+        dup3(null_fd, command->open_pipes[index][1], O_CLOEXEC);
+        if (!link->to_file) {
+            dup3(null_fd, command->open_pipes[index][0], O_CLOEXEC);
+            continue;
+        }
+
+        spool *spool = &spools[count];
+        spool->pipe_fd = command->open_pipes[index][0];
+        spool->size = 0;
+        spool->in_memory = 1;
+        spool->file_fd = memfd_create("jsh-substitution", MFD_CLOEXEC);
+        if (spool->file_fd == -1) {
+            spool->in_memory = 0;
+            spool->file_fd = open_temporary_file();
+            if (spool->file_fd == -1) {
+                goto end;
+            }
+        }
+        ++count;
+    }
+
+    if (drain_spools(spools, count, pgid) == -1) {
+        goto end;
+    }
+
+    // The readers find the whole output at the place of the pipe
+    for (size_t index = 0; index < count; ++index) {
+        lseek(spools[index].file_fd, 0, SEEK_SET);
+        if (dup3(spools[index].file_fd, spools[index].pipe_fd, O_CLOEXEC) == -1) {
+            perror("dup3");
+            goto end;
+        }
+    }
+    result = 0;
+
+end:
+    for (size_t index = 0; index < count; ++index) {
+        close(spools[index].file_fd);
+    }
+    close(null_fd);
+    free(spools);
+    return result;
+}
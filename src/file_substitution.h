@@ -0,0 +1,34 @@
+#ifndef FILE_SUBSTITUTION_H
+#define FILE_SUBSTITUTION_H
+
+#include "command.h"
+
+#include <sys/types.h>
+
+/** Size above which the output of a `=(` substitution moves from memory to a temporary file. */
+#ifndef FILE_SUBSTITUTION_MEMORY_CAP
+#define FILE_SUBSTITUTION_MEMORY_CAP (64 * 1024 * 1024)
+#endif
+
+/** Delay after which the shell checks that the producers it is reading from are not stopped. */
+#define FILE_SUBSTITUTION_POLL_INTERVAL_MS 100
+
+/**
+ * Returns the phase in which every command call of the command has to be launched, and sets `phase_count`.
+ * Calls writing to a `=(` substitution, along with everything piped into them, run one phase before
+ * their reader. Phase 0 holds the main pipeline, higher phases have to complete first.
+ * Returns NULL on failure.
+ */
+int *file_substitution_phases(command *command, size_t *phase_count);
+
+/**
+ * Reads the outputs of the `=(` substitutions written by the calls of `phase` until their end, storing them
+ * in memory or in a temporary file past `FILE_SUBSTITUTION_MEMORY_CAP`.
+ * The pipes are then replaced by the files, rewound, so that the `/dev/fd` paths of the readers stay valid.
+ * The shell lets go of the other pipes of the phase, which are only used by its processes.
+ * Fails if one of the processes of the group `pgid` stops in the meantime.
+ * Returns -1 on failure.
+ */
+int spool_file_substitutions(command *command, const int *phases, int phase, pid_t pgid);
+
+#endif // FILE_SUBSTITUTION_H
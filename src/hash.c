@@ -0,0 +1,45 @@
+#include "internals.h"
+#include "path_cache.h"
+
+int hash_command(command_call *command_call) {
+    if (command_call->argc == 1) {
+        print_path_cache(command_call->stdout);
+        return 0;
+    }
+
+    char *option = command_call->argv[1];
+    if (strcmp(option, "-r") == 0) {
+        if (command_call->argc > 2) {
+            dprintf(command_call->stderr, "hash: too many arguments\n");
+            return 1;
+        }
+        clear_path_cache(0);
+        return 0;
+    }
+
+    if (strcmp(option, "-p") == 0) {
+        if (command_call->argc != 4) {
+            dprintf(command_call->stderr, "hash: correct usage: hash -p path name\n");
+            return 1;
+        }
+        return pin_command_path(command_call->argv[3], command_call->argv[2]) == -1 ? 1 : 0;
+    }
+
+    if (option[0] == '-') {
+        dprintf(command_call->stderr, "hash: %s: invalid option\n", option);
+        dprintf(command_call->stderr, "hash: correct usage: hash [-r] [-p path] [name ...]\n");
+        return 1;
+    }
+
+    int exit_code = 0;
+    for (size_t index = 1; index < command_call->argc; ++index) {
+        char *name = command_call->argv[index];
+        const char *path;
+        if (strchr(name, '/') == NULL && resolve_command_path(name, &path) != COMMAND_FOUND) {
+            dprintf(command_call->stderr, "hash: %s: not found\n", name);
+            exit_code = 1;
+        }
+    }
+
+    return exit_code;
+}
@@ -2,8 +2,11 @@
 #include <stdio.h>
 #include <sys/wait.h>
 
+#include "file_substitution.h"
 #include "internals.h"
 #include "jobs.h"
+#include "launch.h"
+#include "reaper.h"
 #include "signals.h"
 #include "utils.h"
 
@@ -12,8 +15,9 @@ char lwd[PATH_MAX];
 const size_t LIMIT_PROMPT_SIZE = 30;
 
 int should_exit;
+int is_subshell;
 
-int execute_internal_command(command_call *command_call);
+int execute_internal_command(command *command, command_call *command_call);
 command_result *execute_external_command(command *command_call);
 
 #define UNINITIALIZED_EXIT_CODE -1
@@ -50,15 +54,28 @@ int has_exit_code(internal_exit_info *info) {
 void init_internals() {
     last_exit_code = 0;
     should_exit = 0;
+    is_subshell = 0;
     init_job_table();
 }
 
 command_result *execute_command(command *command) {
     command_result *result;
 
-    if (command->command_call_count == 1 && is_internal_command(command->command_calls[0])) {
-        int exit_code = execute_internal_command(command->command_calls[0]);
+    if (command->command_call_count == 1 && is_internal_command(command->command_calls[0]) &&
+        !has_launch_controls(&command->controls)) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int exit_code = 1;
+        if (open_redirections(command->command_calls[0]) != -1) {
+            exit_code = execute_internal_command(command, command->command_calls[0]);
+        }
         result = new_command_result(exit_code, command);
+
+        // Run by the shell itself, the command has no process whose resources could be reported
+        if (command->timed) {
+            dprintf(STDERR_FILENO, "real\t%.3fs\n", elapsed_seconds(&start));
+        }
     } else {
         result = execute_external_command(command);
     }
@@ -69,8 +86,8 @@ command_result *execute_command(command *command) {
     return result;
 }
 
-/** Executes an internal command call. */
-int execute_internal_command(command_call *command_call) {
+/** Executes an internal command call of the command. */
+int execute_internal_command(command *command, command_call *command_call) {
     int exit_code = 0;
 
     if (strcmp(command_call->name, "cd") == 0) {
@@ -89,189 +106,223 @@ int execute_internal_command(command_call *command_call) {
         exit_code = fg_command(command_call);
     } else if (strcmp(command_call->name, "bg") == 0) {
         exit_code = bg_command(command_call);
+    } else if (strcmp(command_call->name, "hash") == 0) {
+        exit_code = hash_command(command_call);
+    } else if (strcmp(command_call->name, "type") == 0) {
+        exit_code = type_command(command_call);
+    } else if (strcmp(command_call->name, "setnice") == 0) {
+        exit_code = setnice_command(command_call);
+    } else if (strcmp(command_call->name, "setcpus") == 0) {
+        exit_code = setcpus_command(command_call);
+    } else if (strcmp(command_call->name, "array") == 0) {
+        exit_code = array_command(command, command_call);
     }
 
     return exit_code;
 }
 
-void close_reading_pipes(command *command, command_call *command_call) {
-    if (command == NULL || command->open_pipes == NULL || command->open_pipes_size == 0 || command_call == NULL) {
-        return;
-    }
-
-    for (size_t i = 0; i < command->open_pipes_size; i++) {
-        if (contains(command_call->reading_pipes->pipes, command_call->reading_pipes->pipe_count, i)) {
-            continue;
-        }
-        if (command->open_pipes[i] == NULL) {
-            continue;
-        }
-        close(command->open_pipes[i][0]);
+/**
+ * Executes the internal command call in a process of the job, so that the shell does not block writing
+ * to a pipe whose reader has not been released yet, or so that the controls of `run` do not apply to the shell.
+ * Returns the pid of the process, -1 on failure.
+ */
+pid_t fork_internal_command(command *command, command_call *command_call, pid_t pgid, launch_barrier *barrier) {
+    pid_t pid = fork_into_job(pgid, barrier);
+    if (pid != 0) {
+        return pid;
     }
-}
 
-void close_writing_pipes(command *command, command_call *command_call) {
-    if (command == NULL || command->open_pipes == NULL || command->open_pipes_size == 0 || command_call == NULL) {
-        return;
+    is_subshell = 1;
+    if (apply_launch_controls(&command->controls) == -1) {
+        exit(1);
     }
 
-    for (size_t i = 0; i < command->open_pipes_size; i++) {
-        if (contains(command_call->writing_pipes->pipes, command_call->writing_pipes->pipe_count, i)) {
-            continue;
-        }
-        if (command->open_pipes[i] == NULL) {
-            continue;
-        }
-
-        close(command->open_pipes[i][1]);
+    // Only its own streams are kept, otherwise it would hold the pipes of the job open
+    dup2(command_call->stdin, STDIN_FILENO);
+    dup2(command_call->stdout, STDOUT_FILENO);
+    dup2(command_call->stderr, STDERR_FILENO);
+    close_from(STDERR_FILENO + 1);
+    command_call->stdin = STDIN_FILENO;
+    command_call->stdout = STDOUT_FILENO;
+    command_call->stderr = STDERR_FILENO;
+
+    int exit_code = 1;
+    if (open_redirections(command_call) != -1) {
+        exit_code = execute_internal_command(command, command_call);
     }
+    exit(exit_code);
 }
 
-internal_exit_info *execute_single_command(command *command, command_call *command_call, job *job) {
-    if (is_internal_command(command_call)) {
-        int exit_code = execute_internal_command(command_call);
+internal_exit_info *execute_single_command(command *command, command_call *command_call, job *job,
+                                           launch_barrier *barrier) {
+    pid_t pid;
+    if (!is_internal_command(command_call)) {
+        pid = launch_command_call(command, command_call, job->pgid, barrier);
+    } else if (command_call->writing_pipes.pipe_count > 0 || has_launch_controls(&command->controls)) {
+        pid = fork_internal_command(command, command_call, job->pgid, barrier);
+    } else {
+        int exit_code = 1;
+        if (open_redirections(command_call) != -1) {
+            exit_code = execute_internal_command(command, command_call);
+        }
         return new_internal_exit_info(UNINITIALIZED_PID, exit_code);
     }
 
-    // These 2 pipes ensure that the group is created at the right moment.
-    // The parent tells the child which pgid they should use,
-    // the child sets it and the tells the parent it's ok.
-    int fd[2];
-    int fd_2[2];
-    if (pipe(fd) == -1) {
-        perror("pipe");
-        return NULL;
-    }
-    if (pipe(fd_2) == -1) {
-        perror("pipe");
+    if (pid == -1) {
         return NULL;
     }
 
-    pid_t pid = fork();
-    if (pid == -1) {
-        perror("fork");
-        return NULL;
+    if (job->pgid == 0) {
+        job->pgid = pid;
     }
 
-    if (pid == 0) {
-        close(fd[1]);
-        close(fd_2[0]);
+    return new_internal_exit_info(pid, UNINITIALIZED_EXIT_CODE);
+}
 
-        // Getting the pgid for this process
-        pid_t pgid;
-        if (read(fd[0], &pgid, sizeof(int)) != sizeof(int)) {
-            perror("read");
-            exit(1);
-        }
-        close(fd[0]);
+/** Kills the processes of the job launched so far and waits for them. */
+void abort_job(job *job) {
+    if (job->pgid == 0) {
+        return;
+    }
 
-        // Every process in the job should be in the same process group.
-        if ((setpgid(0, pgid)) == -1) {
-            perror("setpgid");
-            exit(1);
+    kill(-job->pgid, SIGKILL);
+    for (size_t i = 0; i < job->subjobs_size; i++) {
+        if (job->subjobs[i] != NULL) {
+            waitpid(job->subjobs[i]->pid, NULL, 0);
         }
+    }
+}
 
-        // Telling the parent that the pgid has been set
-        if (write(fd_2[1], &pgid, sizeof(int)) != sizeof(int)) {
-            perror("write");
-            exit(1);
-        }
+/**
+ * Launches the command calls of the job that belong to `phase`, and creates their subjobs.
+ * Sets `info` when the first command call is launched.
+ * Returns -1 on failure.
+ */
+int launch_phase(command *command, job *job, const int *phases, int phase, internal_exit_info **info) {
+    // Stages are forked back to back and all start together once the barrier is released
+    launch_barrier barrier;
+    if (open_launch_barrier(&barrier) == -1) {
+        return -1;
+    }
 
-        close(fd_2[1]);
+    for (size_t i = 0; i < command->command_call_count; i++) {
+        if (phases[i] != phase) {
+            continue;
+        }
 
-        close_reading_pipes(command, command_call);
-        close_writing_pipes(command, command_call);
+        internal_exit_info *info_ = execute_single_command(command, command->command_calls[i], job, &barrier);
 
-        // Putting the process to the foreground
-        if (command->background == 0) {
-            if (tcsetpgrp(STDERR_FILENO, pgid) == -1) {
-                perror("tcsetpgrp");
-                exit(1);
-            }
+        if (info_ == NULL) {
+            release_launch_barrier(&barrier);
+            return -1;
         }
 
-        restore_signals();
+        if (i == 0) {
+            *info = new_internal_exit_info(info_->pid, info_->exit_code);
+        }
 
-        dup2(command_call->stdin, STDIN_FILENO);
-        dup2(command_call->stdout, STDOUT_FILENO);
-        dup2(command_call->stderr, STDERR_FILENO);
+        if (info_->pid != UNINITIALIZED_PID) { // Avoid internal commands
+            subjob *subjob = new_subjob(command->command_calls[i], info_->pid, RUNNING);
+            if (subjob == NULL || add_subjob(job, i, subjob) == -1) {
+                destroy_subjob(subjob);
+                destroy_internal_exit_info(info_);
+                release_launch_barrier(&barrier);
+                return -1;
+            }
+        }
 
-        execvp(command_call->name, command_call->argv);
-        dprintf(command_call->stderr, "jsh: %s: %s\n", command_call->name, strerror(errno));
-        exit(1);
+        destroy_internal_exit_info(info_);
     }
 
-    if (job->pgid == 0) {
-        job->pgid = pid;
+    // Putting the job to the foreground before any of its processes runs
+    if (command->background == 0 && job->pgid != 0 && tcsetpgrp(STDERR_FILENO, job->pgid) == -1) {
+        perror("tcsetpgrp");
+        release_launch_barrier(&barrier);
+        return -1;
     }
 
-    close(fd[0]);
-    close(fd_2[1]);
+    release_launch_barrier(&barrier);
+    return 0;
+}
 
-    // Telling the child the pgid it should use
-    if (write(fd[1], &job->pgid, sizeof(int)) != sizeof(int)) {
-        perror("write");
-        kill(pid, SIGKILL); // It is important to kill the child if the parent fails to write
-                            // since the child would never know its pgid
-        return NULL;
-    }
+/**
+ * Waits for the processes of `phase` to exit, without reaping them so that the process group of the job
+ * outlives them. Returns -1 if one of them was stopped or killed.
+ */
+int wait_for_phase(command *command, job *job, const int *phases, int phase) {
+    for (size_t i = 0; i < command->command_call_count; i++) {
+        if (phases[i] != phase || job->subjobs[i] == NULL) {
+            continue;
+        }
 
-    close(fd[1]);
+        siginfo_t status = {0};
+        while (waitid(P_PID, job->subjobs[i]->pid, &status, WEXITED | WSTOPPED | WNOWAIT) == -1) {
+            if (errno != EINTR) {
+                perror("waitid");
+                return -1;
+            }
+        }
 
-    int dump;
+        if (status.si_code != CLD_EXITED) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** Launches the phases of the job one after the other. Returns the pid of the first command call, NULL on failure. */
+internal_exit_info *execute_phases(command *command, job *job) {
+    internal_exit_info *info = NULL;
 
-    // Waiting for the child to set the pgid
-    if (read(fd_2[0], &dump, sizeof(int)) != sizeof(int)) {
-        perror("read");
-        kill(pid, SIGKILL); // It is important to kill the child if the parent fails to read
-                            // since the child would never know that teh parent is waiting for it
+    size_t phase_count;
+    int *phases = file_substitution_phases(command, &phase_count);
+    if (phases == NULL) {
         return NULL;
     }
 
-    close(fd_2[0]);
+    for (int phase = phase_count - 1; phase >= 0; phase--) {
+        if (launch_phase(command, job, phases, phase, &info) == -1 ||
+            (phase > 0 && (spool_file_substitutions(command, phases, phase, job->pgid) == -1 ||
+                           wait_for_phase(command, job, phases, phase) == -1))) {
+            abort_job(job); // If there was an error, kill the whole group
+            if (command->background == 0 && phase > 0) {
+                tcsetpgrp(STDERR_FILENO, getpgrp()); // The job may already own the terminal
+            }
+            free(phases);
+            destroy_internal_exit_info(info);
+            return NULL;
+        }
+    }
 
-    return new_internal_exit_info(pid, UNINITIALIZED_EXIT_CODE);
+    free(phases);
+    return info;
 }
 
 /**
  * Executes a command call as a job, it assumes the job has enough room to fit
  * all the calls.
+ * The producers of `=(` substitutions are launched first, and complete before their readers start.
+ * SIGCHLD is blocked meanwhile, so that the producers are not reaped with their process group.
  *
  * Returns the pid of the first executed command_call.
  */
 internal_exit_info *execute_as_job(command *command, job *job) {
-    internal_exit_info *info = NULL;
+    sigset_t previous;
+    block_child_signals(&previous);
+    apply_child_events(); // Events left about reaped processes would otherwise be applied to new ones
 
-    for (size_t i = 0; i < command->command_call_count; i++) {
-
-        internal_exit_info *info_ = execute_single_command(command, command->command_calls[i], job);
-
-        if (info_ == NULL) {
-            if (job->pgid != 0) {
-                kill(-job->pgid, SIGKILL); // If there was an error, kill the whole group
-            }
-            destroy_internal_exit_info(info);
-            return NULL;
-        }
-
-        if (i == 0) {
-            info = new_internal_exit_info(info_->pid, info_->exit_code);
-        }
-
-        if (info_->pid != UNINITIALIZED_PID) { // Avoid internal commands
-            subjob *subjob = new_subjob(command->command_calls[i], info_->pid, RUNNING);
-            job->subjobs[i] = subjob;
-        }
-
-        destroy_internal_exit_info(info_);
-    }
+    internal_exit_info *info = execute_phases(command, job);
 
+    restore_child_signals(&previous);
     return info;
 }
 
 job *setup_job(command *command) {
     size_t dependencies_count = command->command_call_count;
     job *job = new_job(dependencies_count, command->command_string);
+    if (job != NULL) {
+        job->timed = command->timed;
+    }
 
     return job;
 }
@@ -285,9 +336,6 @@ command_result *execute_external_command(command *command) {
     internal_exit_info *info = execute_as_job(command, job);
 
     for (size_t i = 0; i < command->open_pipes_size; i++) {
-        if (command->open_pipes[i] == NULL) {
-            continue;
-        }
         close(command->open_pipes[i][0]);
         close(command->open_pipes[i][1]);
     }
@@ -312,13 +360,20 @@ command_result *execute_external_command(command *command) {
         }
 
         if (job->status == DONE || job->status == KILLED || job->status == DETACHED) {
+            print_job_time(job, STDERR_FILENO);
             if (has_exit_code(info)) {
                 // If the chief was an internal command, we need to use its exit code
                 command_result->exit_code = info->exit_code;
             } else {
                 command_result->exit_code = exit_code;
             }
-            destroy_job(job);
+
+            if (is_job_over(job)) {
+                destroy_job(job);
+            } else { // The orphans it left behind are tracked until they are over
+                command_result->job_id = add_job(job);
+                print_job(job, STDERR_FILENO);
+            }
         } else {
             int job_id = add_job(job);
 
@@ -354,11 +409,8 @@ void update_command_history(command_result *result) {
     }
 }
 
-void close_unused_file_descriptors_helper(command *command, command_call *command_call) {
-    if (command == NULL) {
-        return;
-    }
-
+/** Closes the standard streams of the command call that are neither standard nor pipes of the command. */
+void close_unused_file_descriptors_helper(command_call *command_call, const uint64_t *pipe_fds, int max_fd) {
     size_t nb_fds_to_close = 3;
 
     int *fds_to_close = malloc(nb_fds_to_close * sizeof(int));
@@ -376,8 +428,7 @@ void close_unused_file_descriptors_helper(command *command, command_call *comman
     add_set(fds_to_close, nb_fds_to_close, command_call->stderr);
 
     for (size_t index = 0; index < nb_fds_to_close; ++index) {
-        if (fds_to_close[index] > 2 &&
-            !contains2(command->open_pipes, command->open_pipes_size, 2, fds_to_close[index])) {
+        if (fds_to_close[index] > 2 && !contains_fd_bitmap(pipe_fds, max_fd, fds_to_close[index])) {
             close(fds_to_close[index]);
         }
     }
@@ -390,7 +441,20 @@ void close_unused_file_descriptors(command *command) {
         return;
     }
 
+    // The pipes are looked up once per stream of every call, so they are gathered in a bitmap first
+    int max_fd = max_pipe_fd(command);
+    uint64_t *pipe_fds = new_fd_bitmap(max_fd < 0 ? 0 : max_fd);
+    if (pipe_fds == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < command->open_pipes_size; i++) {
+        add_fd_bitmap(pipe_fds, command->open_pipes[i][0]);
+        add_fd_bitmap(pipe_fds, command->open_pipes[i][1]);
+    }
+
     for (size_t index = 0; index < command->command_call_count; ++index) {
-        close_unused_file_descriptors_helper(command, command->command_calls[index]);
+        close_unused_file_descriptors_helper(command->command_calls[index], pipe_fds, max_fd);
     }
+
+    free(pipe_fds);
 }
@@ -14,6 +14,9 @@ extern char lwd[PATH_MAX];
 /** 1 if the shell should exit, 0 otherwise. */
 extern int should_exit;
 
+/** 1 in a process forked to run an internal command inside a pipeline, which cannot wait for the jobs. */
+extern int is_subshell;
+
 /** Executes the command call. */
 command_result *execute_command(command *command);
 
@@ -76,4 +79,42 @@ int fg_command(command_call *command_call);
 
 int bg_command(command_call *command_call);
 
+/**
+ * Lists the commands remembered by the path cache, or changes it.
+ * `hash -r` forgets every command, `hash -p path name` makes `name` refer to `path`,
+ * and `hash name ...` looks the names up in `PATH` and remembers them.
+ *
+ * @return `0` if worked, `1` otherwise.
+ */
+int hash_command(command_call *command_call);
+
+/**
+ * Prints, for every argument, whether it is an internal command or where the executable it refers to is.
+ *
+ * @return `0` if every argument was found, `1` otherwise.
+ */
+int type_command(command_call *command_call);
+
+/**
+ * Changes the nice value of every thread of the processes of a job still running, `setnice N %job`.
+ *
+ * @return `0` if worked, `1` otherwise.
+ */
+int setnice_command(command_call *command_call);
+
+/**
+ * Restricts every thread of the processes of a job still running to a list of CPUs, `setcpus LIST %job`.
+ *
+ * @return `0` if worked, `1` otherwise.
+ */
+int setcpus_command(command_call *command_call);
+
+/**
+ * Launches `N` instances of a command as a single job, `array N[%K] command ...`, at most `K` of them at once.
+ * Each instance finds its index, from 1 to `N`, in `ARRAY_TASK_ID_ENV`.
+ *
+ * @return `0` if the job was launched in background or if every instance succeeded, `1` otherwise.
+ */
+int array_command(command *command, command_call *command_call);
+
 #endif // INTERNALS_H
@@ -1,8 +1,17 @@
+#define _GNU_SOURCE // ppoll
+
 #include "jobs.h"
 #include "command.h"
+#include "internals.h"
 #include "proc.h"
+#include "proc_events.h"
+#include "proc_snapshot.h"
+#include "reaper.h"
 #include "string_utils.h"
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 void destroy_job_table();
@@ -11,6 +20,29 @@ job **job_table;
 size_t job_table_size;
 size_t job_table_capacity;
 
+/** The jobs of the table, in no particular order, so that they are iterated without going through the empty slots. */
+job **live_jobs;
+
+/** Min-heap of the ids freed below `next_job_id`, the smallest one being given to the next job. */
+size_t *free_job_ids;
+size_t free_job_ids_count;
+
+/** Smallest id never given since the table was last empty, used once no freed id is left. */
+size_t next_job_id;
+
+/** Original number of buckets of the pid index, doubled whenever it holds as many subjobs as buckets. */
+#define INITIAL_SUBJOB_INDEX_CAPACITY 64
+
+/** Subjobs whose process was not reaped yet, by pid, chained through `next_in_index` within a bucket. */
+subjob **subjob_index;
+size_t subjob_index_size;
+size_t subjob_index_capacity;
+
+/** Jobs a child event was applied to since the last update, or added since then. */
+job **changed_jobs;
+size_t changed_jobs_count;
+size_t changed_jobs_capacity;
+
 char *job_status_to_string(job_status status) {
     switch (status) {
         case RUNNING:
@@ -45,19 +77,194 @@ subjob *new_subjob(command_call *command, pid_t pid, job_status status) {
     strcpy(j->command, command->command_string);
     j->pid = pid;
     j->last_status = status;
+    j->reaped = 0;
+    j->wait_status = 0;
+    memset(&j->usage, 0, sizeof(subjob_usage));
+    j->job = NULL;
+    j->next_in_index = NULL;
+    j->adopted = 0;
 
     return j;
 }
 
+/** Returns the bucket of the pid index holding the pid, the capacity being a power of two. */
+size_t subjob_index_bucket(pid_t pid, size_t capacity) {
+    return (size_t)pid & (capacity - 1);
+}
+
+/** Doubles the number of buckets of the pid index, creating it if needed. Returns -1 on failure. */
+int grow_subjob_index() {
+    size_t capacity = subjob_index == NULL ? INITIAL_SUBJOB_INDEX_CAPACITY : subjob_index_capacity * 2;
+    subjob **index = calloc(capacity, sizeof(subjob *));
+    if (index == NULL) {
+        perror("calloc");
+        return -1;
+    }
+
+    for (size_t bucket = 0; bucket < subjob_index_capacity; bucket++) {
+        subjob *next;
+        for (subjob *j = subjob_index[bucket]; j != NULL; j = next) {
+            next = j->next_in_index;
+            size_t new_bucket = subjob_index_bucket(j->pid, capacity);
+            j->next_in_index = index[new_bucket];
+            index[new_bucket] = j;
+        }
+    }
+
+    free(subjob_index);
+    subjob_index = index;
+    subjob_index_capacity = capacity;
+    return 0;
+}
+
+/** Removes the subjob from the pid index, if it is there. */
+void unindex_subjob(subjob *j) {
+    if (subjob_index == NULL) {
+        return;
+    }
+
+    subjob **link = &subjob_index[subjob_index_bucket(j->pid, subjob_index_capacity)];
+    for (; *link != NULL; link = &(*link)->next_in_index) {
+        if (*link == j) {
+            *link = j->next_in_index;
+            j->next_in_index = NULL;
+            subjob_index_size--;
+            return;
+        }
+    }
+}
+
 void destroy_subjob(subjob *j) {
     if (j == NULL) {
         return;
     }
 
+    unindex_subjob(j);
     free(j->command);
     free(j);
 }
 
+/** Adds the subjob to the pid index. Returns -1 on failure. */
+int index_subjob(subjob *j) {
+    if (subjob_index_size >= subjob_index_capacity && grow_subjob_index() == -1) {
+        return -1;
+    }
+
+    size_t bucket = subjob_index_bucket(j->pid, subjob_index_capacity);
+    j->next_in_index = subjob_index[bucket];
+    subjob_index[bucket] = j;
+    subjob_index_size++;
+    return 0;
+}
+
+int add_subjob(job *job, size_t index, subjob *j) {
+    if (index_subjob(j) == -1) {
+        return -1;
+    }
+
+    j->job = job;
+    job->subjobs[index] = j;
+    return 0;
+}
+
+subjob *find_subjob(pid_t pid) {
+    if (subjob_index == NULL) {
+        return NULL;
+    }
+
+    for (subjob *j = subjob_index[subjob_index_bucket(pid, subjob_index_capacity)]; j != NULL; j = j->next_in_index) {
+        if (j->pid == pid) {
+            return j;
+        }
+    }
+    return NULL;
+}
+
+/** Returns a new subjob for an orphan adopted by the shell, named after its command line. Returns NULL on failure. */
+subjob *new_orphan(pid_t pid) {
+    subjob *j = malloc(sizeof(subjob));
+    if (j == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    j->command = get_process_command(pid);
+    if (j->command == NULL) {
+        free(j);
+        return NULL;
+    }
+
+    j->pid = pid;
+    j->last_status = RUNNING;
+    j->reaped = 0;
+    j->wait_status = 0;
+    memset(&j->usage, 0, sizeof(subjob_usage));
+    j->job = NULL;
+    j->next_in_index = NULL;
+    j->adopted = 1;
+
+    return j;
+}
+
+/** Adds the orphan to the ones of the job, and indexes it by pid. Returns -1 on failure. */
+int add_orphan(job *job, subjob *orphan) {
+    if (job->orphans_count == job->orphans_capacity) {
+        size_t capacity = job->orphans_capacity == 0 ? 4 : job->orphans_capacity * 2;
+        subjob **grown = reallocarray(job->orphans, capacity, sizeof(subjob *));
+        if (grown == NULL) {
+            perror("reallocarray");
+            return -1;
+        }
+        job->orphans = grown;
+        job->orphans_capacity = capacity;
+    }
+
+    if (index_subjob(orphan) == -1) {
+        return -1;
+    }
+
+    orphan->job = job;
+    job->orphans[job->orphans_count++] = orphan;
+    job->live_orphans++;
+    return 0;
+}
+
+/** Adds the job to the list of jobs looked at by the next update, if it is not there yet. */
+void mark_job_changed(job *j) {
+    if (j->changed) {
+        return;
+    }
+
+    if (changed_jobs_count == changed_jobs_capacity) {
+        size_t capacity = changed_jobs_capacity == 0 ? INITIAL_JOB_TABLE_CAPACITY : changed_jobs_capacity * 2;
+        job **grown = reallocarray(changed_jobs, capacity, sizeof(job *));
+        if (grown == NULL) {
+            perror("reallocarray");
+            return;
+        }
+        changed_jobs = grown;
+        changed_jobs_capacity = capacity;
+    }
+
+    changed_jobs[changed_jobs_count++] = j;
+    j->changed = 1;
+}
+
+/** Removes the job from the list of changed jobs, if it is there. */
+void unmark_job_changed(job *j) {
+    if (!j->changed) {
+        return;
+    }
+
+    for (size_t i = 0; i < changed_jobs_count; i++) {
+        if (changed_jobs[i] == j) {
+            changed_jobs[i] = changed_jobs[--changed_jobs_count];
+            break;
+        }
+    }
+    j->changed = 0;
+}
+
 job *new_job(size_t subjobs_size, char *command_string) {
     job *j = malloc(sizeof(job));
     j->id = UNINITIALIZED_JOB_ID;
@@ -80,6 +287,15 @@ job *new_job(size_t subjobs_size, char *command_string) {
     j->command_string = command_string_copy;
 
     j->status = RUNNING;
+    j->timed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &j->start);
+    j->array = NULL;
+    j->changed = 0;
+    j->live_index = 0;
+    j->orphans = NULL;
+    j->orphans_count = 0;
+    j->orphans_capacity = 0;
+    j->live_orphans = 0;
 
     return j;
 }
@@ -92,9 +308,15 @@ void destroy_job(job *j) {
     for (size_t i = 0; i < j->subjobs_size; i++) {
         destroy_subjob(j->subjobs[i]);
     }
+    for (size_t i = 0; i < j->orphans_count; i++) {
+        destroy_subjob(j->orphans[i]);
+    }
 
+    unmark_job_changed(j);
     free(j->subjobs);
+    free(j->orphans);
     free(j->command_string);
+    destroy_array_job(j->array);
     free(j);
 }
 
@@ -104,59 +326,142 @@ void print_subjob(subjob *j, int fd) {
 
 void print_job(job *j, int fd) {
     dprintf(fd, "[%ld]\t%d\t%s\t%s\n", j->id, j->pgid, job_status_to_string(j->status), j->command_string);
+    if (j->array != NULL) {
+        print_array_progress(j, fd);
+    }
 }
 
-void init_job_table() {
-    destroy_job_table();
-    job_table = malloc(INITIAL_JOB_TABLE_CAPACITY * sizeof(job *));
-    if (job_table == NULL) {
-        perror("malloc");
+subjob_usage get_subjob_usage(subjob *j) {
+    if (j->reaped) {
+        return j->usage;
+    }
+
+    subjob_usage usage = {0};
+    read_process_usage(j->pid, &usage);
+    return usage;
+}
+
+/** Prints the resources used by each subjob of the job, and adds them to `total`. */
+void print_subjobs_usage(job *j, int fd, subjob_usage *total) {
+    print_usage_header(fd);
+
+    // Subjobs are stored with the last stage first, in reverse every stage comes after the ones feeding it
+    for (size_t i = j->subjobs_size; i > 0; i--) {
+        subjob *subjob = j->subjobs[i - 1];
+        if (subjob != NULL) {
+            subjob_usage usage = get_subjob_usage(subjob);
+            print_usage(fd, &usage, subjob->command);
+            add_usage(total, &usage);
+        }
+    }
+}
+
+void print_job_time(job *j, int fd) {
+    if (!j->timed) {
+        return;
+    }
+
+    dprintf(fd, "real\t%.3fs\n", elapsed_seconds(&j->start));
+    subjob_usage total = {0};
+    print_subjobs_usage(j, fd, &total);
+    print_usage(fd, &total, "total");
+}
+
+/** Resizes the job table, its jobs having ids up to the new capacity. Exits on failure. */
+void resize_job_table(size_t capacity) {
+    job **table = reallocarray(job_table, capacity, sizeof(job *));
+    job **live = reallocarray(live_jobs, capacity, sizeof(job *));
+    size_t *free_ids = reallocarray(free_job_ids, capacity, sizeof(size_t));
+    if (table == NULL || live == NULL || free_ids == NULL) {
+        perror("reallocarray");
         exit(EXIT_FAILURE);
     }
-    job_table_capacity = INITIAL_JOB_TABLE_CAPACITY;
-    job_table_size = 0;
 
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        job_table[i] = NULL;
+    for (size_t i = job_table_capacity; i < capacity; i++) {
+        table[i] = NULL;
     }
+    job_table = table;
+    live_jobs = live;
+    free_job_ids = free_ids;
+    job_table_capacity = capacity;
+}
+
+void init_job_table() {
+    destroy_job_table();
+    resize_job_table(INITIAL_JOB_TABLE_CAPACITY);
+    job_table_size = 0;
+    free_job_ids_count = 0;
+    next_job_id = 1;
 }
 
 void destroy_job_table() {
     if (job_table == NULL) {
         return;
     }
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        destroy_job(job_table[i]);
-        job_table[i] = NULL;
+    for (size_t i = 0; i < job_table_size; i++) {
+        job_table[live_jobs[i]->id - 1] = NULL;
+        destroy_job(live_jobs[i]);
     }
     free(job_table);
+    free(live_jobs);
+    free(free_job_ids);
+    job_table = NULL;
+    live_jobs = NULL;
+    free_job_ids = NULL;
+    job_table_size = 0;
+    job_table_capacity = 0;
 }
 
-int add_job(job *j) {
-    if (j == NULL) {
-        return -1;
+/** Adds the id to the heap of free ids. */
+void push_free_job_id(size_t id) {
+    size_t child = free_job_ids_count++;
+    while (child > 0 && free_job_ids[(child - 1) / 2] > id) {
+        free_job_ids[child] = free_job_ids[(child - 1) / 2];
+        child = (child - 1) / 2;
     }
-    if (job_table_size == job_table_capacity) {
-        job_table_capacity += INITIAL_JOB_TABLE_CAPACITY;
-        job_table = reallocarray(job_table, job_table_capacity, sizeof(job *));
-        if (job_table == NULL) {
-            perror("reallocarray");
-            exit(EXIT_FAILURE);
+    free_job_ids[child] = id;
+}
+
+/** Removes the smallest id from the heap of free ids, and returns it. The heap must not be empty. */
+size_t pop_free_job_id() {
+    size_t smallest = free_job_ids[0];
+    size_t last = free_job_ids[--free_job_ids_count];
+
+    size_t parent = 0;
+    while (2 * parent + 1 < free_job_ids_count) {
+        size_t child = 2 * parent + 1;
+        if (child + 1 < free_job_ids_count && free_job_ids[child + 1] < free_job_ids[child]) {
+            child++;
         }
-        for (size_t i = job_table_size; i < job_table_capacity; i++) {
-            job_table[i] = NULL;
+        if (free_job_ids[child] >= last) {
+            break;
         }
+        free_job_ids[parent] = free_job_ids[child];
+        parent = child;
     }
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        if (job_table[i] == NULL) {
-            j->id = i + 1;
-            job_table[i] = j;
-            job_table_size++;
-            return i + 1;
-        }
+    if (free_job_ids_count > 0) {
+        free_job_ids[parent] = last;
+    }
+    return smallest;
+}
+
+int add_job(job *j) {
+    if (j == NULL) {
+        return -1;
     }
 
-    return -1;
+    // The smallest free id, the freed ones all being below the ones never given
+    size_t id = free_job_ids_count > 0 ? pop_free_job_id() : next_job_id++;
+    if (id > job_table_capacity) {
+        resize_job_table(job_table_capacity * 2);
+    }
+
+    j->id = id;
+    job_table[id - 1] = j;
+    j->live_index = job_table_size;
+    live_jobs[job_table_size++] = j;
+    mark_job_changed(j);
+    return id;
 }
 
 int remove_job(size_t id) {
@@ -164,16 +469,27 @@ int remove_job(size_t id) {
         return 1;
     }
 
-    if (job_table[id - 1] == NULL) {
+    job *j = job_table[id - 1];
+    if (j == NULL) {
         return 1;
     }
 
-    destroy_job(job_table[id - 1]);
-
+    live_jobs[j->live_index] = live_jobs[--job_table_size];
+    live_jobs[j->live_index]->live_index = j->live_index;
     job_table[id - 1] = NULL;
+    destroy_job(j);
 
-    job_table_size--;
+    if (job_table_size > 0) {
+        push_free_job_id(id);
+        return 0;
+    }
 
+    // Once the shell is idle, the ids start over and the table goes back to its initial size
+    free_job_ids_count = 0;
+    next_job_id = 1;
+    if (job_table_capacity > INITIAL_JOB_TABLE_CAPACITY) {
+        resize_job_table(INITIAL_JOB_TABLE_CAPACITY);
+    }
     return 0;
 }
 
@@ -203,6 +519,10 @@ int is_finished_status(job_status status) {
     return 0;
 }
 
+int is_job_over(job *j) {
+    return is_finished_status(j->status) && j->live_orphans == 0;
+}
+
 /**
  * Returns 1 if the job is dead.
  * Returns 0 otherwise.
@@ -212,6 +532,11 @@ int is_job_finished(job *j) {
         return 1;
     }
 
+    // Instances not launched yet are not subjobs yet
+    if (j->array != NULL && !is_array_exhausted(j->array)) {
+        return 0;
+    }
+
     for (size_t i = 0; i < j->subjobs_size; i++) {
         if (j->subjobs[i] == NULL) {
             continue;
@@ -306,13 +631,13 @@ void update_job_status(job *j) {
         return;
     }
 
-    // TODO: Handle detached
     if (is_job_running(j)) {
         j->status = RUNNING;
     } else if (is_job_suspended(j)) {
         j->status = STOPPED;
     } else if (is_job_finished(j)) {
-        if (kill(-j->pgid, 0) == 0) { // Ping to check existence
+        // A subreaper tracks the processes left behind by the job, otherwise its process group is pinged
+        if (is_subreaper ? j->live_orphans > 0 : kill(-j->pgid, 0) == 0) {
             j->status = DETACHED;
         } else if (is_job_killed(j)) {
             j->status = KILLED;
@@ -341,59 +666,139 @@ job_status job_status_from_int(int status) {
     return RUNNING;
 }
 
-/**
- * Updates the subjob status based on the information
- * returned by the waitpid function.
- *
- * Returns 0 if the process was updated successfully.
- * Returns -1 if an error occurred.
- */
-int process_waitpid_response(pid_t pid, int status, job_status *last_status) {
-    if (pid == -1) {
-        perror("waitpid");
-        return -1;
+/** Returns the job whose process group is `pgid`, looking at `origin` first. Returns `origin` if there is none. */
+job *find_job_of_group(pid_t pgid, job *origin) {
+    if (origin->pgid == pgid) {
+        return origin;
     }
 
-    if (pid == 0) {
-        return 0;
+    for (size_t i = 0; i < job_table_size; i++) {
+        if (live_jobs[i]->pgid == pgid) {
+            return live_jobs[i];
+        }
     }
-
-    *last_status = job_status_from_int(status);
-    return 0;
+    return origin;
 }
 
 /**
- * Updates the status of the job's subjobs by calling
- * the waitpid function with the WNOHANG flag.
- *
- * Returns 0 if the job was updated successfully.
- * Returns -1 if an error occurred.
+ * Adds the children of the shell that are neither subjobs nor known orphans to the orphans of the job whose
+ * process group they are in. The ones that left it, daemons calling setsid for instance, are given to `origin`,
+ * the job of the process whose end had them reparented to the shell.
  */
-int wait_for_job(job *j) {
-    if (j == NULL) {
-        return -1;
+void adopt_orphans(job *origin) {
+    size_t count;
+    int *children = get_children(getpid(), &count);
+    if (children == NULL) {
+        return;
     }
 
-    for (size_t i = 0; i < j->subjobs_size; i++) {
-        subjob *subjob = j->subjobs[i];
-        if (subjob == NULL) {
+    for (size_t i = 0; i < count; i++) {
+        if (find_subjob(children[i]) != NULL) {
             continue;
         }
 
-        // Ignore finished jobs
-        if (is_finished_status(subjob->last_status)) {
+        pid_t pgid = getpgid(children[i]);
+        subjob *orphan = pgid == -1 ? NULL : new_orphan(children[i]);
+        if (orphan == NULL) {
+            continue; // Already over, its event is ignored
+        }
+
+        job *job = find_job_of_group(pgid, origin);
+        if (add_orphan(job, orphan) == -1) {
+            destroy_subjob(orphan);
             continue;
         }
+        mark_job_changed(job);
+    }
+    free(children);
+}
 
-        int status;
-        pid_t pid = waitpid(subjob->pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
+/**
+ * Applies a change of state of a child to its subjob, and marks its job as changed.
+ * Returns the job of the subjob if it ended, NULL otherwise.
+ */
+job *apply_child_event(const child_event *event) {
+    subjob *subjob = find_subjob(event->pid);
+    if (subjob == NULL) {
+        return NULL; // Its job was destroyed meanwhile
+    }
 
-        if (process_waitpid_response(pid, status, &subjob->last_status) == -1) {
-            return -1;
+    subjob->last_status = job_status_from_int(event->status);
+    subjob->wait_status = event->status;
+    if (WIFEXITED(event->status) || WIFSIGNALED(event->status)) {
+        subjob->usage = event->usage;
+        subjob->reaped = 1;
+        unindex_subjob(subjob); // Its pid may be given to another process from now on
+        if (subjob->adopted) {
+            subjob->job->live_orphans--;
+        } else if (subjob->job->array != NULL) {
+            count_array_instance(subjob->job->array, event->status);
         }
     }
+    mark_job_changed(subjob->job);
+    return subjob->reaped ? subjob->job : NULL;
+}
 
+void apply_child_events() {
+    sigset_t previous;
+    block_child_signals(&previous);
+
+    child_event event;
+    do {
+        job *ended = NULL;
+        while (next_child_event(&event)) {
+            job *job = apply_child_event(&event);
+            if (job != NULL) {
+                ended = job;
+            }
+        }
+
+        // The children the ended processes left were reparented to the shell before their end was reported,
+        // the children of the shell are listed once for all of them
+        if (is_subreaper && ended != NULL) {
+            adopt_orphans(ended);
+        }
+    } while (reap_children() > 0);
+
+    restore_child_signals(&previous);
+}
+
+/**
+ * Updates the status of the job from the last status of its subjobs, after launching the next instances of an array.
+ * `apply_child_events` has to be called before.
+ */
+void update_job(job *j) {
+    if (j->array != NULL) {
+        refill_array_job(j, 0);
+    }
     update_job_status(j);
+}
+
+/**
+ * Waits until a process of the job changes, `SIGCHLD` being blocked and `previous` being the mask to restore.
+ * The events of the proc connector are read meanwhile, its socket would otherwise overflow while a long job runs in
+ * the foreground. Returns -1 on failure.
+ */
+int wait_for_job_change(job *j, const sigset_t *previous) {
+    if (proc_events_fd == -1) {
+        // Only notices the next change of a process of the job, whichever it is, the next iteration reaps it
+        siginfo_t info;
+        if (waitid(P_PGID, j->pgid, &info, WEXITED | WSTOPPED | WNOWAIT) == -1 && errno != EINTR) {
+            perror("waitid");
+            return -1;
+        }
+        return 0;
+    }
+
+    // A change of a child since it was blocked is pending, `SIGCHLD` then interrupts the wait as soon as it starts
+    sigset_t waiting = *previous;
+    sigdelset(&waiting, SIGCHLD);
+    struct pollfd events = {.fd = proc_events_fd, .events = POLLIN};
+    if (ppoll(&events, 1, NULL, &waiting) == -1 && errno != EINTR) {
+        perror("ppoll");
+        return -1;
+    }
+    read_proc_events();
     return 0;
 }
 
@@ -402,161 +807,242 @@ int blocking_wait_for_job(job *j) {
         return -1;
     }
 
-    int exit_status = 0;
+    // A change of state happening between the last look at the job and the wait would otherwise go unnoticed
+    sigset_t previous;
+    block_child_signals(&previous);
 
-    for (size_t i = 0; i < j->subjobs_size; i++) {
-        subjob *subjob = j->subjobs[i];
-        if (subjob == NULL) {
-            continue;
+    int result = 0;
+    while (1) {
+        apply_child_events();
+        update_job(j);
+        if (j->status != RUNNING) {
+            break;
         }
 
-        // Ignore finished jobs
-        if (is_finished_status(subjob->last_status)) {
-            continue;
-        }
-
-        int status;
-        pid_t pid = waitpid(subjob->pid, &status, WUNTRACED);
-
-        if (process_waitpid_response(pid, status, &subjob->last_status) == -1) {
-            return -1;
+        if (wait_for_job_change(j, &previous) == -1) {
+            result = -1;
+            break;
         }
+    }
+    restore_child_signals(&previous);
 
-        if (i == 0) {
-            if (subjob->last_status != RUNNING && subjob->last_status != STOPPED) {
-                exit_status = WEXITSTATUS(status);
-            }
-        }
+    if (result == -1) {
+        return -1;
     }
+    if (j->array != NULL) {
+        return is_finished_status(j->status) ? array_exit_code(j->array) : 0;
+    }
+    if (j->subjobs[0] != NULL && j->subjobs[0]->reaped) {
+        return WEXITSTATUS(j->subjobs[0]->wait_status);
+    }
+    return 0;
+}
 
-    update_job_status(j);
-    return exit_status;
+int have_jobs_changed() {
+    apply_child_events();
+    return changed_jobs_count > 0;
 }
 
 int are_jobs_running() {
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        if (job_table[i] != NULL) {
-            if (is_job_alive(job_table[i])) {
-                return 1;
-            }
+    for (size_t i = 0; i < job_table_size; i++) {
+        if (is_job_alive(live_jobs[i])) {
+            return 1;
         }
     }
     return 0;
 }
 
-void fd_update_jobs(int fd) {
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        job *job = job_table[i];
-        if (job_table[i] == NULL) {
-            continue;
+/** Orders jobs by decreasing job number, for `qsort`. */
+int compare_job_ids_decreasing(const void *first, const void *second) {
+    size_t first_id = (*(job *const *)first)->id;
+    size_t second_id = (*(job *const *)second)->id;
+    return first_id < second_id ? 1 : first_id > second_id ? -1 : 0;
+}
+
+/**
+ * Updates the jobs, printing the ones whose status changed to `fd`, with their resource usage if `verbose` is 1,
+ * and removes the finished ones.
+ */
+void fd_update_jobs(int fd, int verbose) {
+    apply_child_events();
+
+    // Printed by job number, the list being consumed from its end
+    qsort(changed_jobs, changed_jobs_count, sizeof(job *), compare_job_ids_decreasing);
+    while (changed_jobs_count > 0) {
+        job *job = changed_jobs[--changed_jobs_count];
+        job->changed = 0;
+        if (job->id == 0) {
+            continue; // Waited for in the foreground, it is not in the job table
         }
 
         job_status last_status = job->status;
-
-        if (wait_for_job(job) == -1) {
-            continue;
-        }
+        update_job(job);
 
         if (last_status != job->status) {
             print_job(job, fd);
+            if (verbose) {
+                subjob_usage total = {0};
+                print_subjobs_usage(job, fd, &total);
+            }
         }
 
-        if (is_job_finished(job)) {
+        if (is_job_over(job)) {
+            print_job_time(job, fd);
             remove_job(job->id);
         }
     }
 }
 
 void update_jobs() {
-    fd_update_jobs(STDERR_FILENO);
+    fd_update_jobs(STDERR_FILENO, 0);
 }
 
-void print_children(subjob *job, pid_t pid, size_t tabulation, int fd) {
+/**
+ * Returns the status shown for a process of a snapshot, from its state in /proc. A process whose state is unknown is
+ * shown with the status of the process of the job it descends from, which received the same stop and continue signals.
+ */
+job_status status_from_process_state(char state, job_status ancestor_status) {
+    switch (state) {
+        case UNKNOWN_PROCESS_STATE:
+            return ancestor_status;
+        case 'T':
+        case 't':
+            return STOPPED;
+        case 'Z':
+        case 'X':
+            return DONE; // Over, but not reaped by its parent yet
+        default:
+            return RUNNING;
+    }
+}
 
-    size_t size = 0;
-    int *children = get_children(pid, &size);
+/**
+ * Prints the descendants of the process of the snapshot to `fd`, indented by their depth below `tabulation`.
+ * `ancestor_status` is the status of the process of the job they descend from.
+ */
+void print_children(const process_snapshot *snapshot, const snapshot_process *parent, job_status ancestor_status,
+                    size_t tabulation, int fd) {
+    if (parent == NULL) {
+        return; // It ended before the snapshot was taken
+    }
 
-    // This is the lowest level of printing. This can be upgraded.
     char *spaces = repeat("\t", tabulation);
-
     if (spaces == NULL) {
         return;
     }
 
-    for (size_t index = 0; index < size; ++index) {
-        dprintf(fd, "\t%s%s\t%d\t%s\t%s\n", spaces, "| ", children[index], job_status_to_string(job->last_status),
-                job->command);
-        print_children(job, children[index], tabulation + 1, fd);
+    for (size_t child = parent->first_child; child != NO_SNAPSHOT_PROCESS;
+         child = snapshot->processes[child].next_sibling) {
+        const snapshot_process *process = &snapshot->processes[child];
+        dprintf(fd, "\t%s%s\t%d\t%s\t%s\n", spaces, "| ", process->pid,
+                job_status_to_string(status_from_process_state(process->state, ancestor_status)), process->name);
+        print_children(snapshot, process, ancestor_status, tabulation + 1, fd);
     }
 
     free(spaces);
-    free(children);
 }
 
-void print_job_tree(job *job, int fd) {
+/** Prints the job to `fd` with the processes of the snapshot descending from each of its processes. */
+void print_job_tree(job *job, const process_snapshot *snapshot, int fd) {
+    dprintf(fd, "[%zu]", job->id);
     for (size_t index = 0; index < job->subjobs_size; ++index) {
-        if (index == 0) {
-            dprintf(fd, "[%zu]", job->id);
+        subjob *subjob = job->subjobs[index];
+        if (subjob == NULL) {
+            continue; // Internal commands, and instances of an array not launched yet
+        }
+        print_subjob(subjob, fd);
+        if (!subjob->reaped) {
+            print_children(snapshot, find_snapshot_process(snapshot, subjob->pid), subjob->last_status, 0, fd);
+        }
+    }
+
+    for (size_t index = 0; index < job->orphans_count; ++index) {
+        subjob *orphan = job->orphans[index];
+        if (!orphan->reaped) {
+            dprintf(fd, "\t%d\t%s\t%s (orphan)\n", orphan->pid, job_status_to_string(orphan->last_status),
+                    orphan->command);
+            print_children(snapshot, find_snapshot_process(snapshot, orphan->pid), orphan->last_status, 0, fd);
         }
-        print_subjob(job->subjobs[index], fd);
-        print_children(job->subjobs[index], job->subjobs[index]->pid, 0, fd);
     }
 }
 
-int jobs_command(command_call *call) {
+/**
+ * Prints the job to `fd` as a tree of processes if a snapshot of the processes is given, followed by its resource
+ * usage if `verbose` is 1.
+ */
+void print_job_with_options(job *job, const process_snapshot *tree, int verbose, int fd) {
+    if (tree != NULL) {
+        print_job_tree(job, tree, fd);
+    } else {
+        print_job(job, fd);
+    }
 
-    fd_update_jobs(call->stdout);
+    if (verbose) {
+        subjob_usage total = {0};
+        print_subjobs_usage(job, fd, &total);
+    }
+}
 
-    if (call->argc > 3) {
+int jobs_command(command_call *call) {
+    if (call->argc > 4) {
         dprintf(call->stderr, "jobs: too many arguments\n");
         return 1;
     }
 
     int tree = 0;
-    job *job = NULL;
-
-    // Looking if `-t` and/or %[job_id] options were passed.
-    if (call->argc > 1) {
-        size_t string_job_index = 1;
+    int verbose = 0;
+    char *job_id = NULL;
 
-        if (strcmp(call->argv[1], "-t") == 0) {
-            tree = 1;
-            string_job_index = 2;
-        } else if (call->argc == 3 && strcmp(call->argv[2], "-t") == 0) {
+    // Looking for the `-t` and `-v` options and a %[job_id], in any order
+    for (size_t index = 1; index < call->argc; ++index) {
+        if (strcmp(call->argv[index], "-t") == 0) {
             tree = 1;
+        } else if (strcmp(call->argv[index], "-v") == 0) {
+            verbose = 1;
+        } else if (starts_with(call->argv[index], "%")) {
+            job_id = call->argv[index];
         }
+    }
 
-        if (call->argc > string_job_index && starts_with(call->argv[string_job_index], "%")) {
-            job = get_job(call->argv[string_job_index], call->stderr);
+    // The jobs are children of the shell, a subshell only prints what the shell knew when forking it
+    if (!is_subshell) {
+        fd_update_jobs(call->stdout, verbose);
+    }
 
-            if (job == NULL) {
-                return 1;
-            }
-        }
+    job *selected_job = NULL;
+    if (job_id != NULL && (selected_job = get_job(job_id, call->stderr)) == NULL) {
+        return 1;
     }
 
-    if (job != NULL) {
-        if (tree) {
-            print_job_tree(job, call->stdout);
-            return 0;
-        }
+    // Every tree is printed from a single reading of /proc, or from the processes known from the proc connector
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    if (tree && (proc_events_fd == -1 || take_process_snapshot_from_events(&snapshot) == -1)) {
+        take_process_snapshot(&snapshot);
+    }
+    const process_snapshot *processes = tree ? &snapshot : NULL;
 
-        print_job(job, call->stdout);
+    if (selected_job != NULL) {
+        print_job_with_options(selected_job, processes, verbose, call->stdout);
+        destroy_process_snapshot(&snapshot);
         return 0;
     }
 
-    for (size_t i = 0; i < job_table_capacity; i++) {
-        job = job_table[i];
-        if (job == NULL) {
-            continue;
-        }
-        if (tree) {
-            print_job_tree(job, call->stdout);
-        } else {
-            print_job(job_table[i], call->stdout);
-        }
+    // Printed by job number
+    job **jobs = malloc((job_table_size + 1) * sizeof(job *));
+    if (jobs == NULL) {
+        perror("malloc");
+        destroy_process_snapshot(&snapshot);
+        return 1;
+    }
+    memcpy(jobs, live_jobs, job_table_size * sizeof(job *));
+    qsort(jobs, job_table_size, sizeof(job *), compare_job_ids_decreasing);
+    for (size_t i = job_table_size; i > 0; i--) {
+        print_job_with_options(jobs[i - 1], processes, verbose, call->stdout);
     }
 
+    free(jobs);
+    destroy_process_snapshot(&snapshot);
     return 0;
 }
 
@@ -584,7 +1070,8 @@ int put_job_in_foreground(job *job) {
         return 0;
     }
 
-    if (is_job_finished(job)) {
+    if (is_job_over(job)) {
+        print_job_time(job, STDERR_FILENO);
         remove_job(job->id);
     } else {
         print_job(job, STDERR_FILENO);
@@ -619,6 +1106,17 @@ int continue_job_in_background(job *job) {
     return 1;
 }
 
+size_t signal_job_orphans(job *job, int sig) {
+    size_t signaled = 0;
+    for (size_t index = 0; index < job->orphans_count; ++index) {
+        subjob *orphan = job->orphans[index];
+        if (!orphan->reaped && getpgid(orphan->pid) != job->pgid && kill(orphan->pid, sig) == 0) {
+            signaled++;
+        }
+    }
+    return signaled;
+}
+
 job *get_job(char *job_id_string, int error_fd) {
     // Check if job id starts with %
     if (!starts_with(job_id_string, "%")) {
@@ -653,3 +1151,43 @@ job *get_job(char *job_id_string, int error_fd) {
 
     return job_table[job_id - 1];
 }
+
+pid_t *get_job_threads(job *job, size_t *count) {
+    *count = 0;
+    pid_t *threads = NULL;
+    for (size_t index = 0; index < job->subjobs_size; ++index) {
+        subjob *subjob = job->subjobs[index];
+        if (subjob == NULL) {
+            continue; // Internal commands, and instances of an array not launched yet
+        }
+        if (subjob->last_status != RUNNING && subjob->last_status != STOPPED) {
+            continue;
+        }
+
+        size_t thread_count;
+        pid_t *subjob_threads = get_threads(subjob->pid, &thread_count);
+        if (subjob_threads == NULL) {
+            continue; // It ended since the job was last updated
+        }
+
+        pid_t *grown = realloc(threads, (*count + thread_count) * sizeof(pid_t));
+        if (grown == NULL) {
+            perror("realloc");
+            free(subjob_threads);
+            free(threads);
+            return NULL;
+        }
+        threads = grown;
+        memcpy(threads + *count, subjob_threads, thread_count * sizeof(pid_t));
+        *count += thread_count;
+        free(subjob_threads);
+    }
+
+    if (threads == NULL) {
+        threads = malloc(sizeof(pid_t)); // Not a failure, the job has no process left
+        if (threads == NULL) {
+            perror("malloc");
+        }
+    }
+    return threads;
+}
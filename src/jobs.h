@@ -1,9 +1,12 @@
 #ifndef JOBS_H
 #define JOBS_H
 
+#include "array.h"
 #include "command.h"
+#include "usage.h"
 #include <linux/limits.h>
 #include <sys/types.h>
+#include <time.h>
 
 #define UNINITIALIZED_JOB_ID 0;
 
@@ -16,6 +19,12 @@ typedef struct subjob {
     char *command;
     pid_t pid;
     job_status last_status;
+    int reaped;                   // 1 once the process is over and `usage` holds its final figures
+    int wait_status;              // Last status reported by wait4 for the process
+    subjob_usage usage;           // Filled when the process is reaped
+    struct job *job;              // Job the subjob was added to with `add_subjob`
+    struct subjob *next_in_index; // Next subjob of the same bucket of the pid index
+    int adopted;                  // 1 for an orphan the job left behind, adopted by the shell as a subreaper
 } subjob;
 
 typedef struct job {
@@ -25,16 +34,34 @@ typedef struct job {
     pid_t pgid; // Process group id for all the subjobs
     char *command_string;
     subjob **subjobs;
+    int timed;             // 1 if the command was prefixed by `time`
+    struct timespec start; // When the job was launched, on the monotonic clock
+    array_job *array;      // Instances launched by `array`, NULL for the other jobs
+    int changed;           // 1 while the job waits in the list of jobs looked at by the next update
+    size_t live_index;     // Position of the job among the jobs of the table, while it is in the table
+    subjob **orphans;      // Processes left behind by the job and adopted by the shell, see `is_subreaper`
+    size_t orphans_count;
+    size_t orphans_capacity;
+    size_t live_orphans; // Orphans not reaped yet, the job stays in the table until there is none
 } job;
 
 /** Returns a new subjob with the given command call, pid, last status and type. */
 subjob *new_subjob(command_call *, pid_t, job_status);
 
-/** Frees the memory allocated for the subjob.
- *  Calls `destroy_command_call` to free `subjob-> command`.
- */
+/** Frees the memory allocated for the subjob, and removes it from the pid index. */
 void destroy_subjob(subjob *);
 
+/**
+ * Sets the subjob at `index` in the job, and indexes it by pid so that the changes of state of its process are
+ * applied to it. SIGCHLD has to be blocked from the launch of the process, and the pending child events applied
+ * before it, so that no event is lost or applied to another process that had the same pid.
+ * Returns -1 on failure.
+ */
+int add_subjob(struct job *, size_t index, subjob *);
+
+/** Returns the subjob whose process has the pid and was not reaped yet, NULL if there is none. */
+subjob *find_subjob(pid_t);
+
 /** Returns a new job with the given subjobs size and name, the
  * subjobs will be set to NULL. */
 job *new_job(size_t, char *);
@@ -50,19 +77,39 @@ void destroy_job(job *);
 void print_job(job *, int fd);
 
 /**
- * Updates the status of the job's subjobs by calling
- * the waitpid with the WUNTRACED flag, this will block
- * until all the subjobs have finished or have been stopped.
+ * Returns the resources used by the process of the subjob, its final figures once it is reaped,
+ * what /proc reports so far otherwise.
+ */
+subjob_usage get_subjob_usage(subjob *);
+
+/**
+ * Prints the resources used by every subjob of the job and their total to `fd`, along with the time
+ * elapsed since the job was launched. Does nothing if the job was not prefixed by `time`.
+ */
+void print_job_time(job *, int fd);
+
+/**
+ * Applies the changes of state of the children queued by the reaper to their subjobs, and marks their jobs
+ * as changed. Children that were not reaped yet, because the queue was full or because SIGCHLD is blocked, are
+ * reaped meanwhile. It only costs as much as the number of changes, whatever the number of jobs.
+ */
+void apply_child_events();
+
+/**
+ * Updates the status of the job's subjobs until none of them is running anymore,
+ * this will block until all the subjobs have finished or have been stopped.
+ * The changes are applied in the order they happen, whichever process of the job's group changes first.
  *
  * Returns the exit status of the first subjob, since it
  * is the only one that can change the exit status of the job.
+ * An array job launches its instances meanwhile, and returns the exit code of the whole array.
  *
  * Returns -1 if an error occurred.
  */
 int blocking_wait_for_job(job *);
 
 /** Original capacity of the job table. Every time the job table expands
- *  it will be expanded by this number */
+ *  its capacity is doubled, and it goes back to this one once it is empty. */
 #define INITIAL_JOB_TABLE_CAPACITY 64
 
 extern job **job_table;
@@ -79,8 +126,8 @@ extern size_t job_table_capacity;
  * */
 void init_job_table();
 
-/** Adds a new job to the job table. Expands it
- * if needed.
+/** Adds a new job to the job table, with the smallest job number
+ * that is not used. Expands it if needed. The job is looked at by the next update.
  *
  * Returns the job number of the added job.
  * If there was an error, returns -1.
@@ -98,10 +145,20 @@ int remove_job(size_t);
 void destroy_job_table();
 
 /** Updates the jobs in the job table and prints the ones that
- *  have finished.
+ *  have finished. Only the jobs whose children changed state since
+ *  the last update are looked at.
  */
 void update_jobs();
 
+/**
+ * Returns 1 if the processes of the job are over and no orphan it left behind is still tracked, 0 otherwise.
+ * A job that is not over is kept in the job table.
+ */
+int is_job_over(job *);
+
+/** Returns 1 if the next update has jobs to look at, after applying the pending child events, 0 otherwise. */
+int have_jobs_changed();
+
 /** Return 1 if there are jobs running or stopped, 0 otherwise.
  * It looks the last status of the jobs in the job table, so it
  * could not be accurate, should be used after a call to `update_jobs`
@@ -123,6 +180,12 @@ int put_job_in_foreground(job *);
  */
 int continue_job_in_background(job *);
 
+/**
+ * Sends the signal to the orphans of the job that left its process group, the others receive the ones sent to it.
+ * Returns the number of orphans the signal was sent to.
+ */
+size_t signal_job_orphans(job *, int sig);
+
 /**
  * Returns the job with the given job number.
  * If there is no job with that job number or an error occured,
@@ -130,4 +193,10 @@ int continue_job_in_background(job *);
  */
 job *get_job(char *job_id_string, int error_fd);
 
+/**
+ * Returns the ids of the threads of every process of the job still running or stopped, and sets `count`.
+ * Returns NULL on failure.
+ */
+pid_t *get_job_threads(job *, size_t *count);
+
 #endif // JOBS_H
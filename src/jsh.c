@@ -1,18 +1,40 @@
 #include "jobs.h"
+#include "launch.h"
+#include "parse_cache.h"
+#include "path_cache.h"
+#include "proc_events.h"
 #include "prompt.h"
+#include "reaper.h"
 #include "signals.h"
+#include "utils.h"
 
 int main(int argc, char *argv[]) {
-    if (argc > 1) {
-        printf("Usage: %s\n", argv[0]);
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], CHECK_FDS_OPTION) != 0)) {
+        printf("Usage: %s [%s]\n", argv[0], CHECK_FDS_OPTION);
         return EXIT_FAILURE;
     }
+    check_file_descriptors = argc == 2;
+
+    // Descriptors inherited by the shell are not passed on to the commands it executes
+    set_cloexec_from(STDERR_FILENO + 1);
 
     ignore_signals();
 
     init_internals();
+    init_reaper();
+    init_proc_events();
+    init_launch_backend();
+    init_parse_cache(PARSE_CACHE_DEFAULT_CAPACITY);
+    init_path_cache();
     prompt();
 
+    if (getenv(PARSE_CACHE_STATS_ENV) != NULL) {
+        print_parse_cache_stats(STDERR_FILENO);
+    }
+
+    destroy_parse_cache();
+    destroy_path_cache();
+    destroy_proc_events();
     destroy_job_table();
     return last_exit_code;
 }
@@ -64,6 +64,11 @@ int kill_command(command_call *command_call) {
 
         id_to_kill = -job->pgid; // -pgid to send the signal to the whole process group
 
+        // Its orphans may have left the group, which may then be gone
+        if (signal_job_orphans(job, sig) > 0 && kill(id_to_kill, 0) == -1) {
+            return 0;
+        }
+
     } else { // pid
         if ((parse_intmax_t(command_call->argv[identifier_index], &parsed_value, call_stderr)) == 0) {
             return 1;
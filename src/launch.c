@@ -0,0 +1,301 @@
+#define _GNU_SOURCE // pipe2, execvpe and posix_spawn_file_actions_addtcsetpgrp_np
+
+#include "launch.h"
+#include "path_cache.h"
+#include "signals.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char **environ;
+
+launch_backend current_launch_backend = DEFAULT_LAUNCH_BACKEND;
+int check_file_descriptors = 0;
+
+/** Returns the environment the processes of the command start with. */
+char **launch_environment(command *command) {
+    return command->environment != NULL ? command->environment : environ;
+}
+
+void init_launch_backend() {
+    char *backend = getenv(LAUNCH_BACKEND_ENV);
+    if (backend == NULL) {
+        return;
+    }
+
+    if (strcmp(backend, "spawn") == 0) {
+        current_launch_backend = LAUNCH_SPAWN;
+    } else if (strcmp(backend, "fork") == 0) {
+        current_launch_backend = LAUNCH_FORK;
+    }
+}
+
+/**
+ * Returns the file descriptors the process of the command call keeps besides its standard streams,
+ * sorted in increasing order, and sets `count` to their number: the pipes of its substitutions,
+ * passed as `/dev/fd` paths. Returns NULL on failure.
+ */
+int *kept_file_descriptors(command *command, command_call *command_call, size_t *count) {
+    *count = 0;
+    int *kept = malloc((command_call->reading_pipes.pipe_count + 1) * sizeof(int));
+    if (kept == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    // Sorted by insertion, calls rarely have more than a few substitutions
+    for (size_t index = 0; index < command_call->reading_pipes.pipe_count; index++) {
+        int pipe_index = command_call->reading_pipes.pipes[index];
+        if (command->pipe_links[pipe_index].argv_index == PIPE_TO_STDIN) {
+            continue;
+        }
+
+        int fd = command->open_pipes[pipe_index][0];
+        size_t position = (*count)++;
+        for (; position > 0 && kept[position - 1] > fd; position--) {
+            kept[position] = kept[position - 1];
+        }
+        kept[position] = fd;
+    }
+
+    return kept;
+}
+
+/** Prints the file descriptor the command call would inherit by mistake, if any. Returns -1 if there is one. */
+int check_inherited_file_descriptors(command_call *command_call, const int *kept, size_t kept_count) {
+    int fd = find_inherited_file_descriptor(kept, kept_count);
+    if (fd == -1) {
+        return 0;
+    }
+
+    dprintf(STDERR_FILENO, "jsh: check-fds: %s would inherit file descriptor %d\n", command_call->name, fd);
+    return -1;
+}
+
+int open_launch_barrier(launch_barrier *barrier) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("pipe2");
+        return -1;
+    }
+
+    barrier->read_fd = fds[0];
+    barrier->write_fd = fds[1];
+    return 0;
+}
+
+void release_launch_barrier(launch_barrier *barrier) {
+    close(barrier->write_fd);
+    close(barrier->read_fd);
+}
+
+/** Blocks the child until the shell releases the barrier. */
+void wait_launch_barrier(launch_barrier *barrier) {
+    close(barrier->write_fd);
+
+    char dump;
+    while (read(barrier->read_fd, &dump, sizeof(dump)) == -1 && errno == EINTR) {
+    }
+
+    close(barrier->read_fd);
+}
+
+pid_t fork_into_job(pid_t pgid, launch_barrier *barrier) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        // Every process in the job should be in the same process group.
+        if ((setpgid(0, pgid)) == -1) {
+            perror("setpgid");
+            exit(1);
+        }
+
+        // Nothing is executed before the job owns the terminal
+        wait_launch_barrier(barrier);
+
+        restore_signals();
+        return 0;
+    }
+
+    if (pgid == 0) {
+        pgid = pid;
+    }
+
+    // The child does the same, whichever runs first creates the group. It cannot have executed anything
+    // yet, so this only fails if it already died.
+    setpgid(pid, pgid);
+
+    return pid;
+}
+
+pid_t fork_command_call(command *command, command_call *command_call, pid_t pgid, launch_barrier *barrier) {
+    pid_t pid = fork_into_job(pgid, barrier);
+    if (pid == 0) {
+        dup2(command_call->stdin, STDIN_FILENO);
+        dup2(command_call->stdout, STDOUT_FILENO);
+        dup2(command_call->stderr, STDERR_FILENO);
+
+        // Every other descriptor of the shell is close-on-exec, only the substitutions have to be kept
+        size_t kept_count;
+        int *kept = kept_file_descriptors(command, command_call, &kept_count);
+        if (kept == NULL) {
+            exit(1);
+        }
+        for (size_t index = 0; index < kept_count; index++) {
+            fcntl(kept[index], F_SETFD, 0);
+        }
+
+        if (apply_redirections(command_call) == -1) {
+            exit(1);
+        }
+
+        if (check_file_descriptors && check_inherited_file_descriptors(command_call, kept, kept_count) == -1) {
+            abort();
+        }
+        free(kept);
+
+        if (apply_launch_controls(&command->controls) == -1) {
+            exit(1);
+        }
+
+        // The shell resolved the command just before forking, the cache it left here is up to date
+        path_cache_entry *entry = find_command_path(command_call->name);
+        if (entry != NULL && entry->path == NULL) {
+            dprintf(STDERR_FILENO, "jsh: %s: %s\n", command_call->name, strerror(ENOENT));
+            exit(1);
+        }
+        if (entry != NULL) {
+            execve(entry->path, command_call->argv, launch_environment(command));
+        }
+
+        // Scripts without a shebang, or a binary removed since it was cached, are left to execvp
+        execvpe(command_call->name, command_call->argv, launch_environment(command));
+        dprintf(STDERR_FILENO, "jsh: %s: %s\n", command_call->name, strerror(errno));
+        exit(1);
+    }
+
+    return pid;
+}
+
+/**
+ * Adds the actions putting the standard streams of the command call in place and keeping its substitutions open.
+ * Everything else is close-on-exec.
+ */
+int add_file_actions(posix_spawn_file_actions_t *actions, command *command, command_call *command_call) {
+    int streams[3] = {command_call->stdin, command_call->stdout, command_call->stderr};
+    for (int target = 0; target < 3; target++) {
+        if (streams[target] != target && posix_spawn_file_actions_adddup2(actions, streams[target], target) != 0) {
+            return -1;
+        }
+    }
+
+    size_t kept_count;
+    int *kept = kept_file_descriptors(command, command_call, &kept_count);
+    if (kept == NULL) {
+        return -1;
+    }
+
+    // Duplicating a descriptor onto itself only clears its close-on-exec flag
+    int error = 0;
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 29)
+    for (size_t index = 0; index < kept_count && error == 0; index++) {
+        error = posix_spawn_file_actions_adddup2(actions, kept[index], kept[index]);
+    }
+#else
+    error = kept_count == 0 ? 0 : -1;
+#endif
+
+    free(kept);
+    return error == 0 ? 0 : -1;
+}
+
+pid_t spawn_command_call(command *command, command_call *command_call, pid_t pgid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        return -1;
+    }
+    if (posix_spawnattr_init(&attributes) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        return -1;
+    }
+
+    pid_t pid = -1;
+    sigset_t default_signals;
+    sigset_t no_signals;
+    fill_ignored_signals(&default_signals);
+    sigemptyset(&no_signals);
+
+    // The process group is set by the child before it executes anything, so no handshake is needed
+    if (posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF |
+                                                  POSIX_SPAWN_SETSIGMASK) != 0 ||
+        posix_spawnattr_setpgroup(&attributes, pgid) != 0 ||
+        posix_spawnattr_setsigdefault(&attributes, &default_signals) != 0 ||
+        posix_spawnattr_setsigmask(&attributes, &no_signals) != 0) {
+        goto end;
+    }
+
+    if (command->background == 0) {
+#if SPAWN_SETS_TERMINAL
+        if (posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDERR_FILENO) != 0) {
+            goto end;
+        }
+#else
+        // The process would run before the shell gives it the terminal, the fork path waits on the barrier
+        goto end;
+#endif
+    }
+
+    if (add_file_actions(&actions, command, command_call) == -1) {
+        goto end;
+    }
+
+    path_cache_entry *entry = find_command_path(command_call->name);
+    char **environment = launch_environment(command);
+    int error;
+    if (entry == NULL) {
+        error = posix_spawnp(&pid, command_call->name, &actions, &attributes, command_call->argv, environment);
+    } else if (entry->path != NULL) {
+        error = posix_spawn(&pid, entry->path, &actions, &attributes, command_call->argv, environment);
+    } else {
+        error = ENOENT; // The forked child reports it
+    }
+    if (error != 0) {
+        pid = -1;
+    }
+
+end:
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+pid_t launch_command_call(command *command, command_call *command_call, pid_t pgid, launch_barrier *barrier) {
+    // Fills the cache, both backends then look the command up without searching `PATH` again
+    const char *path;
+    resolve_command_path(command_call->name, &path);
+
+    // Redirections are opened by the child, which reports its own errors
+    // Only the forked child can look at its own descriptors right before executing the command,
+    // or apply the controls of `run`, which posix_spawn has no attribute for
+    if (current_launch_backend == LAUNCH_SPAWN && command_call->redirection_count == 0 && !check_file_descriptors &&
+        !has_launch_controls(&command->controls)) {
+        pid_t pid = spawn_command_call(command, command_call, pgid);
+        if (pid != -1) {
+            return pid;
+        }
+    }
+
+    return fork_command_call(command, command_call, pgid, barrier);
+}
@@ -0,0 +1,93 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include "command.h"
+
+#include <sys/types.h>
+
+/** Environment variable selecting the launch backend, either "spawn" or "fork". */
+#define LAUNCH_BACKEND_ENV "JSH_LAUNCH"
+
+/** Ways of starting the process of an external command call. */
+typedef enum launch_backend {
+    LAUNCH_FORK,  // fork, then set up the child by hand before execvp
+    LAUNCH_SPAWN, // posix_spawnp, which avoids copying the page tables of the shell
+} launch_backend;
+
+/** 1 if posix_spawn can give the terminal to the new process, which foreground jobs need, since glibc 2.35. */
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+#define SPAWN_SETS_TERMINAL 1
+#else
+#define SPAWN_SETS_TERMINAL 0
+#endif
+
+/**
+ * Backend used when `LAUNCH_BACKEND_ENV` is not set, can be changed at build time.
+ * Fork without `SPAWN_SETS_TERMINAL`, since only background jobs could be spawned.
+ */
+#ifndef DEFAULT_LAUNCH_BACKEND
+#if SPAWN_SETS_TERMINAL
+#define DEFAULT_LAUNCH_BACKEND LAUNCH_SPAWN
+#else
+#define DEFAULT_LAUNCH_BACKEND LAUNCH_FORK
+#endif
+#endif
+
+extern launch_backend current_launch_backend;
+
+/** Command line option making every child check the file descriptors it inherits before executing a command. */
+#define CHECK_FDS_OPTION "--check-fds"
+
+/** 1 if children abort when a descriptor besides their standard streams and substitutions would be inherited. */
+extern int check_file_descriptors;
+
+/**
+ * Holds back the forked processes of a job until the whole job is launched and owns the terminal.
+ * The processes wait for the end of file on `read_fd`, which happens once the shell closes `write_fd`.
+ */
+typedef struct launch_barrier {
+    int read_fd;
+    int write_fd;
+} launch_barrier;
+
+/** Selects the launch backend from `LAUNCH_BACKEND_ENV`, keeping the default one if it is unset or unknown. */
+void init_launch_backend();
+
+/** Opens the barrier of a job, closed on exec so that spawned processes never hold it. Returns -1 on failure. */
+int open_launch_barrier(launch_barrier *barrier);
+
+/** Lets every process waiting on the barrier go on, and closes it in the shell. */
+void release_launch_barrier(launch_barrier *barrier);
+
+/**
+ * Forks a process of the job in the process group `pgid`, or in a new one if `pgid` is 0.
+ * In the child, returns 0 once the barrier is released, with the default signal handlers.
+ * In the shell, returns the pid of the child, -1 on failure.
+ */
+pid_t fork_into_job(pid_t pgid, launch_barrier *barrier);
+
+/**
+ * Starts the external command call in the process group `pgid`, or in a new one if `pgid` is 0.
+ * The job is given the terminal if the command is not in background.
+ * The command is looked up in the path cache, which is filled first if needed.
+ * Calls that cannot be spawned fall back to fork, so that errors are reported by the child as usual. Without
+ * `SPAWN_SETS_TERMINAL`, this is the case of every call of a foreground job.
+ * Forked processes do not execute anything before `barrier` is released.
+ * Returns the pid of the new process, -1 on failure.
+ */
+pid_t launch_command_call(command *command, command_call *command_call, pid_t pgid, launch_barrier *barrier);
+
+/**
+ * Same as `launch_command_call`, always using fork.
+ * The process group is set by both the shell and the child, so that it exists as soon as this returns.
+ * The terminal is not given to the job, the shell has to do it before releasing the barrier.
+ */
+pid_t fork_command_call(command *command, command_call *command_call, pid_t pgid, launch_barrier *barrier);
+
+/**
+ * Same as `launch_command_call`, using posix_spawn on the path cached for the command, posix_spawnp if there is none.
+ * Returns -1 without printing anything on failure.
+ */
+pid_t spawn_command_call(command *command, command_call *command_call, pid_t pgid);
+
+#endif // LAUNCH_H
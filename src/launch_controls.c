@@ -0,0 +1,228 @@
+#define _GNU_SOURCE // cpu_set_t and sched_setaffinity
+
+#include "launch_controls.h"
+#include "string_utils.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Value of `--rlimit` removing a limit. */
+#define UNLIMITED_VALUE "unlimited"
+
+/** Names accepted by `--rlimit`, the ones of `prlimit`. */
+typedef struct rlimit_name {
+    const char *name;
+    int resource;
+} rlimit_name;
+
+const rlimit_name rlimit_names[] = {
+    {"as", RLIMIT_AS},           {"core", RLIMIT_CORE},   {"cpu", RLIMIT_CPU},     {"data", RLIMIT_DATA},
+    {"fsize", RLIMIT_FSIZE},     {"memlock", RLIMIT_MEMLOCK}, {"nofile", RLIMIT_NOFILE}, {"nproc", RLIMIT_NPROC},
+    {"rss", RLIMIT_RSS},         {"stack", RLIMIT_STACK}};
+
+#define RLIMIT_NAMES_COUNT (sizeof(rlimit_names) / sizeof(rlimit_names[0]))
+
+int has_launch_controls(const launch_controls *controls) {
+    return controls->set_nice || controls->cpus != NULL || controls->rlimit_count > 0;
+}
+
+int parse_nice(const char *string, int *nice, int error_fd) {
+    intmax_t value;
+    if (parse_intmax_t((char *)string, &value, error_fd) == 0) {
+        return -1;
+    }
+
+    if (value < -20 || value > 19) {
+        dprintf(error_fd, "%s: nice values go from -20 to 19\n", string);
+        return -1;
+    }
+
+    *nice = value;
+    return 0;
+}
+
+/**
+ * Parses the list of CPUs into `cpus`.
+ * Returns -1 and prints an error to `error_fd` if it is invalid, or if it does not contain any CPU.
+ */
+int parse_cpu_list(const char *string, cpu_set_t *cpus, int error_fd) {
+    CPU_ZERO(cpus);
+
+    const char *range = string;
+    while (1) {
+        char *end;
+        unsigned long first = strtoul(range, &end, 10);
+        unsigned long last = first;
+        if (end == range) {
+            goto error;
+        }
+
+        if (*end == '-') {
+            const char *next = end + 1;
+            last = strtoul(next, &end, 10);
+            if (end == next) {
+                goto error;
+            }
+        }
+
+        if (first > last || last >= CPU_SETSIZE || (*end != ',' && *end != '\0')) {
+            goto error;
+        }
+
+        for (unsigned long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+
+        if (*end == '\0') {
+            return 0;
+        }
+        range = end + 1;
+    }
+
+error:
+    dprintf(error_fd, "%s: invalid list of CPUs\n", string);
+    return -1;
+}
+
+int is_valid_cpu_list(const char *cpus, int error_fd) {
+    cpu_set_t set;
+    return parse_cpu_list(cpus, &set, error_fd) == 0;
+}
+
+int set_cpu_list(pid_t tid, const char *cpus) {
+    cpu_set_t set;
+    if (parse_cpu_list(cpus, &set, STDERR_FILENO) == -1) {
+        return -1;
+    }
+    return sched_setaffinity(tid, sizeof(set), &set);
+}
+
+/** Parses `name=value`, the value being a number with an optional K, M, G or T suffix, or `unlimited`. */
+int parse_rlimit(const char *string, launch_rlimit *rlimit, int error_fd) {
+    const char *value = strchr(string, '=');
+    if (value == NULL) {
+        dprintf(error_fd, "%s: expected name=value\n", string);
+        return -1;
+    }
+
+    size_t name_length = value - string;
+    ++value;
+
+    rlimit->resource = -1;
+    for (size_t index = 0; index < RLIMIT_NAMES_COUNT; index++) {
+        if (strlen(rlimit_names[index].name) == name_length &&
+            strncmp(rlimit_names[index].name, string, name_length) == 0) {
+            rlimit->resource = rlimit_names[index].resource;
+        }
+    }
+    if (rlimit->resource == -1) {
+        dprintf(error_fd, "%.*s: unknown resource\n", (int)name_length, string);
+        return -1;
+    }
+
+    if (strcmp(value, UNLIMITED_VALUE) == 0) {
+        rlimit->value = RLIM_INFINITY;
+        return 0;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long long number = strtoull(value, &end, 10);
+    const char *suffixes = "KMGT";
+    const char *suffix = *end == '\0' ? NULL : strchr(suffixes, *end);
+    if (end == value || *value == '-' || errno != 0 || (*end != '\0' && (suffix == NULL || end[1] != '\0'))) {
+        dprintf(error_fd, "%s: invalid limit\n", value);
+        return -1;
+    }
+
+    for (const char *power = suffixes; suffix != NULL && power <= suffix; power++) {
+        if (number > RLIM_INFINITY / 1024) {
+            dprintf(error_fd, "%s: invalid limit\n", value);
+            return -1;
+        }
+        number *= 1024;
+    }
+
+    rlimit->value = number;
+    return 0;
+}
+
+int add_launch_control(launch_controls *controls, arena *arena, const char *option, const char *value, int error_fd) {
+    if (strcmp(option, "--nice") == 0) {
+        controls->set_nice = 1;
+        return parse_nice(value, &controls->nice, error_fd);
+    }
+
+    if (strcmp(option, "--cpus") == 0) {
+        if (!is_valid_cpu_list(value, error_fd)) {
+            return -1;
+        }
+        controls->cpus = arena_strdup(arena, value);
+        return controls->cpus == NULL ? -1 : 0;
+    }
+
+    if (strcmp(option, "--rlimit") == 0) {
+        launch_rlimit *rlimits =
+            arena_grow_array(arena, controls->rlimits, controls->rlimit_count, sizeof(launch_rlimit));
+        if (rlimits == NULL) {
+            return -1;
+        }
+        controls->rlimits = rlimits;
+        if (parse_rlimit(value, &controls->rlimits[controls->rlimit_count], error_fd) == -1) {
+            return -1;
+        }
+        controls->rlimit_count++;
+        return 0;
+    }
+
+    dprintf(error_fd, "jsh: %s: %s: unknown option\n", RUN_KEYWORD, option);
+    return -1;
+}
+
+int copy_launch_controls(arena *arena, launch_controls *copy, const launch_controls *controls) {
+    *copy = *controls;
+
+    if (controls->cpus != NULL) {
+        copy->cpus = arena_strdup(arena, controls->cpus);
+        if (copy->cpus == NULL) {
+            return -1;
+        }
+    }
+
+    if (controls->rlimit_count > 0) {
+        copy->rlimits = arena_alloc(arena, controls->rlimit_count * sizeof(launch_rlimit));
+        if (copy->rlimits == NULL) {
+            return -1;
+        }
+        memcpy(copy->rlimits, controls->rlimits, controls->rlimit_count * sizeof(launch_rlimit));
+    }
+
+    return 0;
+}
+
+int apply_launch_controls(const launch_controls *controls) {
+    if (controls->set_nice && setpriority(PRIO_PROCESS, 0, controls->nice) == -1) {
+        perror("run: setpriority");
+        return -1;
+    }
+
+    if (controls->cpus != NULL && set_cpu_list(0, controls->cpus) == -1) {
+        perror("run: sched_setaffinity");
+        return -1;
+    }
+
+    for (size_t index = 0; index < controls->rlimit_count; index++) {
+        struct rlimit limit = {.rlim_cur = controls->rlimits[index].value, .rlim_max = controls->rlimits[index].value};
+        if (setrlimit(controls->rlimits[index].resource, &limit) == -1) {
+            perror("run: setrlimit");
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef LAUNCH_CONTROLS_H
+#define LAUNCH_CONTROLS_H
+
+#include "arena.h"
+
+#include <stddef.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/** Keyword prefixing a command whose processes are started with scheduling controls. */
+#define RUN_KEYWORD "run"
+
+/** Option of `run` ending its options, everything after it is the command. */
+#define RUN_END_OF_OPTIONS "--"
+
+/** A resource limit set by `run --rlimit`, it becomes both the soft and the hard limit. */
+typedef struct launch_rlimit {
+    int resource;
+    rlim_t value;
+} launch_rlimit;
+
+/** Scheduling controls applied by every process of a job before it executes its command. */
+typedef struct launch_controls {
+    int set_nice; // 1 if `nice` has to be applied
+    int nice;
+    char *cpus; // List of CPUs as given to `--cpus`, NULL to keep the affinity of the shell
+    launch_rlimit *rlimits;
+    size_t rlimit_count;
+} launch_controls;
+
+/** Returns 1 if the controls change anything, 0 otherwise. */
+int has_launch_controls(const launch_controls *controls);
+
+/**
+ * Adds the option of `run` (`--nice`, `--cpus` or `--rlimit`) along with its value to the controls,
+ * allocating what they keep in `arena`. Returns -1 and prints an error to `error_fd` if it is invalid.
+ */
+int add_launch_control(launch_controls *controls, arena *arena, const char *option, const char *value, int error_fd);
+
+/** Copies the controls, allocating their content in `arena`. Returns -1 on failure. */
+int copy_launch_controls(arena *arena, launch_controls *copy, const launch_controls *controls);
+
+/**
+ * Applies the controls to the calling process, meant to be called by a child right before it executes its command.
+ * Returns -1 and prints an error if one of them could not be applied.
+ */
+int apply_launch_controls(const launch_controls *controls);
+
+/** Parses a nice value, between -20 and 19. Returns -1 and prints an error to `error_fd` if it is invalid. */
+int parse_nice(const char *string, int *nice, int error_fd);
+
+/** Returns 1 if the string is a list of CPUs such as `0,2,4-7`, otherwise prints an error to `error_fd`, returns 0. */
+int is_valid_cpu_list(const char *cpus, int error_fd);
+
+/** Restricts the thread (or process) `tid` to the list of CPUs, 0 being the calling thread. Returns -1 on failure. */
+int set_cpu_list(pid_t tid, const char *cpus);
+
+#endif // LAUNCH_CONTROLS_H
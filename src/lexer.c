@@ -0,0 +1,198 @@
+#include "lexer.h"
+#include "string_utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_TOKEN_CAPACITY 16
+
+/** Symbols read by the operator state machine, derived from the byte classes. */
+typedef enum operator_symbol {
+    SYMBOL_OTHER,
+    SYMBOL_PIPE,
+    SYMBOL_LESS,
+    SYMBOL_GREATER,
+    SYMBOL_OPEN,
+    SYMBOL_CLOSE,
+    SYMBOL_STDERR, // `2` followed by `>`
+    SYMBOL_EQUALS,
+    SYMBOL_COUNT
+} operator_symbol;
+
+/** States of the operator state machine, named after what has been read so far. */
+typedef enum operator_state {
+    STATE_REJECT, // Not an operator, every missing transition leads here
+    STATE_START,
+    STATE_PIPE,
+    STATE_LESS,
+    STATE_SUBSTITUTION,
+    STATE_EQUALS,
+    STATE_FILE_SUBSTITUTION,
+    STATE_CLOSE,
+    STATE_GREATER,
+    STATE_GREATER_PIPE,
+    STATE_GREATER_GREATER,
+    STATE_TWO,
+    STATE_TWO_GREATER,
+    STATE_TWO_GREATER_PIPE,
+    STATE_TWO_GREATER_GREATER,
+    STATE_COUNT
+} operator_state;
+
+const unsigned char operator_transitions[STATE_COUNT][SYMBOL_COUNT] = {
+    [STATE_START] = {[SYMBOL_PIPE] = STATE_PIPE,
+                     [SYMBOL_LESS] = STATE_LESS,
+                     [SYMBOL_GREATER] = STATE_GREATER,
+                     [SYMBOL_CLOSE] = STATE_CLOSE,
+                     [SYMBOL_STDERR] = STATE_TWO,
+                     [SYMBOL_EQUALS] = STATE_EQUALS},
+    [STATE_LESS] = {[SYMBOL_OPEN] = STATE_SUBSTITUTION},
+    [STATE_EQUALS] = {[SYMBOL_OPEN] = STATE_FILE_SUBSTITUTION},
+    [STATE_GREATER] = {[SYMBOL_PIPE] = STATE_GREATER_PIPE, [SYMBOL_GREATER] = STATE_GREATER_GREATER},
+    [STATE_TWO] = {[SYMBOL_GREATER] = STATE_TWO_GREATER},
+    [STATE_TWO_GREATER] = {[SYMBOL_PIPE] = STATE_TWO_GREATER_PIPE, [SYMBOL_GREATER] = STATE_TWO_GREATER_GREATER},
+};
+
+/** Kind of the token read when the word ends in a given state, TOKEN_WORD if it is not accepting. */
+const token_kind accepted_kinds[STATE_COUNT] = {
+    [STATE_PIPE] = TOKEN_PIPE,
+    [STATE_LESS] = TOKEN_REDIRECT_STDIN,
+    [STATE_SUBSTITUTION] = TOKEN_SUBSTITUTION_START,
+    [STATE_FILE_SUBSTITUTION] = TOKEN_FILE_SUBSTITUTION_START,
+    [STATE_CLOSE] = TOKEN_SUBSTITUTION_END,
+    [STATE_GREATER] = TOKEN_REDIRECT_STDOUT,
+    [STATE_GREATER_PIPE] = TOKEN_REDIRECT_STDOUT_TRUNC,
+    [STATE_GREATER_GREATER] = TOKEN_REDIRECT_STDOUT_APPEND,
+    [STATE_TWO_GREATER] = TOKEN_REDIRECT_STDERR,
+    [STATE_TWO_GREATER_PIPE] = TOKEN_REDIRECT_STDERR_TRUNC,
+    [STATE_TWO_GREATER_GREATER] = TOKEN_REDIRECT_STDERR_APPEND,
+};
+
+/** Returns the symbol of a byte of class `class`. */
+operator_symbol symbol_of(char c, uint8_t class) {
+    switch (class) {
+        case CHAR_PIPE:
+            return SYMBOL_PIPE;
+        case CHAR_LESS:
+            return SYMBOL_LESS;
+        case CHAR_GREATER:
+            return SYMBOL_GREATER;
+        case CHAR_OPEN_PARENTHESIS:
+            return SYMBOL_OPEN;
+        case CHAR_CLOSE_PARENTHESIS:
+            return SYMBOL_CLOSE;
+        case CHAR_FD_DIGIT:
+            return c == '2' ? SYMBOL_STDERR : SYMBOL_OTHER;
+        default:
+            // `=` only matters at the start of `=(`, it does not deserve a class of its own
+            return c == '=' ? SYMBOL_EQUALS : SYMBOL_OTHER;
+    }
+}
+
+/** Returns the kind of the word starting at `word` of length `length`, given the classes of its bytes. */
+token_kind classify_word(const char *word, const uint8_t *classes, size_t length) {
+    unsigned char state = STATE_START;
+
+    for (size_t index = 0; index < length && state != STATE_REJECT; ++index) {
+        state = operator_transitions[state][symbol_of(word[index], classes[index])];
+    }
+
+    return accepted_kinds[state];
+}
+
+/** Appends a token to the array, growing it if needed. Returns -1 on failure. */
+int push_token(token **tokens, size_t *size, size_t *capacity, size_t offset, size_t length, token_kind kind) {
+    if (*size == *capacity) {
+        size_t new_capacity = *capacity == 0 ? INITIAL_TOKEN_CAPACITY : 2 * *capacity;
+        token *new_tokens = reallocarray(*tokens, new_capacity, sizeof(token));
+        if (new_tokens == NULL) {
+            perror("reallocarray");
+            return -1;
+        }
+        *tokens = new_tokens;
+        *capacity = new_capacity;
+    }
+
+    (*tokens)[*size].offset = offset;
+    (*tokens)[*size].length = length;
+    (*tokens)[*size].kind = kind;
+    (*size)++;
+    return 0;
+}
+
+token *tokenize(const char *string, size_t *size) {
+    *size = 0;
+    if (string == NULL) {
+        return NULL;
+    }
+
+    size_t length = strlen(string);
+    uint8_t *classes = malloc(length + 1);
+    if (classes == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    classify_bytes(string, length, classes);
+
+    token *tokens = NULL;
+    size_t capacity = 0;
+    size_t index = 0;
+
+    while (index < length) {
+        if (classes[index] == CHAR_SPACE) {
+            ++index;
+            continue;
+        }
+
+        if (classes[index] == CHAR_AMPERSAND) {
+            if (push_token(&tokens, size, &capacity, index, 1, TOKEN_BACKGROUND) == -1) {
+                goto error;
+            }
+            ++index;
+            continue;
+        }
+
+        size_t start = index;
+        while (index < length && classes[index] != CHAR_SPACE && classes[index] != CHAR_AMPERSAND) {
+            ++index;
+        }
+
+        token_kind kind = classify_word(string + start, classes + start, index - start);
+        if (push_token(&tokens, size, &capacity, start, index - start, kind) == -1) {
+            goto error;
+        }
+    }
+
+    free(classes);
+    return tokens;
+
+error:
+    free(classes);
+    free(tokens);
+    *size = 0;
+    return NULL;
+}
+
+int is_substitution_start_token(const token *token) {
+    return token->kind == TOKEN_SUBSTITUTION_START || token->kind == TOKEN_FILE_SUBSTITUTION_START;
+}
+
+int is_redirection_token(const token *token) {
+    switch (token->kind) {
+        case TOKEN_REDIRECT_STDIN:
+        case TOKEN_REDIRECT_STDOUT:
+        case TOKEN_REDIRECT_STDOUT_TRUNC:
+        case TOKEN_REDIRECT_STDOUT_APPEND:
+        case TOKEN_REDIRECT_STDERR:
+        case TOKEN_REDIRECT_STDERR_TRUNC:
+        case TOKEN_REDIRECT_STDERR_APPEND:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int is_operator_token(const token *token) {
+    return token->kind != TOKEN_WORD;
+}
@@ -0,0 +1,49 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stddef.h>
+
+/** Kind of a token produced by `tokenize`. */
+typedef enum token_kind {
+    TOKEN_WORD,
+    TOKEN_BACKGROUND,              // &
+    TOKEN_PIPE,                    // |
+    TOKEN_SUBSTITUTION_START,      // <(
+    TOKEN_FILE_SUBSTITUTION_START, // =(
+    TOKEN_SUBSTITUTION_END,        // )
+    TOKEN_REDIRECT_STDIN,          // <
+    TOKEN_REDIRECT_STDOUT,         // >
+    TOKEN_REDIRECT_STDOUT_TRUNC,   // >|
+    TOKEN_REDIRECT_STDOUT_APPEND,  // >>
+    TOKEN_REDIRECT_STDERR,         // 2>
+    TOKEN_REDIRECT_STDERR_TRUNC,   // 2>|
+    TOKEN_REDIRECT_STDERR_APPEND   // 2>>
+} token_kind;
+
+/** A token is a view over the string it was read from, no copy is made. */
+typedef struct token {
+    size_t offset;
+    size_t length;
+    token_kind kind;
+} token;
+
+/**
+ * Reads `string` once and returns the array of its tokens, setting `size` to its length.
+ *
+ * Words are separated by spaces. `&` is always a token on its own, even when it is
+ * glued to a word, every other operator has to be surrounded by spaces to be recognized.
+ *
+ * Returns NULL if there is no token or on allocation failure.
+ */
+token *tokenize(const char *string, size_t *size);
+
+/** Returns 1 if the token starts a substitution (`<(` or `=(`), 0 otherwise. */
+int is_substitution_start_token(const token *);
+
+/** Returns 1 if the token is a redirection (`<`, `>`, `2>>`, ...), 0 otherwise. */
+int is_redirection_token(const token *);
+
+/** Returns 1 if the token is anything but a word, 0 otherwise. */
+int is_operator_token(const token *);
+
+#endif // LEXER_H
@@ -0,0 +1,233 @@
+#include "parse_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+parse_cache line_cache;
+
+void init_parse_cache(size_t capacity) {
+    destroy_parse_cache();
+
+    if (capacity == 0) {
+        return;
+    }
+
+    // Twice as many buckets as entries keeps the chains short
+    line_cache.buckets = calloc(2 * capacity, sizeof(parse_cache_entry *));
+    if (line_cache.buckets == NULL) {
+        perror("calloc");
+        return;
+    }
+
+    line_cache.bucket_count = 2 * capacity;
+    line_cache.capacity = capacity;
+}
+
+void destroy_parse_cache_entry(parse_cache_entry *entry) {
+    for (size_t index = 0; index < entry->command_count; ++index) {
+        destroy_command(entry->commands[index]);
+    }
+    free(entry->commands);
+    free(entry->line);
+    free(entry);
+}
+
+void destroy_parse_cache() {
+    parse_cache_entry *entry = line_cache.most_recent;
+    while (entry != NULL) {
+        parse_cache_entry *next = entry->next;
+        destroy_parse_cache_entry(entry);
+        entry = next;
+    }
+
+    free(line_cache.buckets);
+    memset(&line_cache, 0, sizeof(line_cache));
+}
+
+uint64_t hash_line(const char *line) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const unsigned char *c = (const unsigned char *)line; *c != '\0'; ++c) {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/** Removes the entry from the recency list. */
+void unlink_entry(parse_cache_entry *entry) {
+    if (entry->previous != NULL) {
+        entry->previous->next = entry->next;
+    } else {
+        line_cache.most_recent = entry->next;
+    }
+
+    if (entry->next != NULL) {
+        entry->next->previous = entry->previous;
+    } else {
+        line_cache.least_recent = entry->previous;
+    }
+
+    entry->previous = NULL;
+    entry->next = NULL;
+}
+
+/** Puts the entry at the front of the recency list. */
+void push_front_entry(parse_cache_entry *entry) {
+    entry->previous = NULL;
+    entry->next = line_cache.most_recent;
+
+    if (line_cache.most_recent != NULL) {
+        line_cache.most_recent->previous = entry;
+    }
+    line_cache.most_recent = entry;
+
+    if (line_cache.least_recent == NULL) {
+        line_cache.least_recent = entry;
+    }
+}
+
+parse_cache_entry *find_entry(const char *line, uint64_t hash) {
+    parse_cache_entry *entry = line_cache.buckets[hash % line_cache.bucket_count];
+    while (entry != NULL) {
+        if (entry->hash == hash && strcmp(entry->line, line) == 0) {
+            return entry;
+        }
+        entry = entry->bucket_next;
+    }
+    return NULL;
+}
+
+/** Removes the least recently used entry from the cache. */
+void evict_entry() {
+    parse_cache_entry *entry = line_cache.least_recent;
+    if (entry == NULL) {
+        return;
+    }
+
+    unlink_entry(entry);
+
+    parse_cache_entry **link = &line_cache.buckets[entry->hash % line_cache.bucket_count];
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    destroy_parse_cache_entry(entry);
+    line_cache.size--;
+    line_cache.evictions++;
+}
+
+/** Stores the templates of the line in the cache, which takes ownership of them. Returns -1 on failure. */
+int insert_entry(const char *line, uint64_t hash, command **commands, size_t command_count, int dropped_last) {
+    parse_cache_entry *entry = malloc(sizeof(parse_cache_entry));
+    if (entry == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    entry->line = strdup(line);
+    if (entry->line == NULL) {
+        perror("strdup");
+        free(entry);
+        return -1;
+    }
+
+    if (line_cache.size == line_cache.capacity) {
+        evict_entry();
+    }
+
+    entry->hash = hash;
+    entry->commands = commands;
+    entry->command_count = command_count;
+    entry->dropped_last = dropped_last;
+
+    size_t bucket = hash % line_cache.bucket_count;
+    entry->bucket_next = line_cache.buckets[bucket];
+    line_cache.buckets[bucket] = entry;
+
+    push_front_entry(entry);
+    line_cache.size++;
+    return 0;
+}
+
+/** Returns copies of the templates that can be instantiated. */
+command **copy_templates(command **templates, size_t command_count) {
+    command **commands = malloc(command_count * sizeof(command *));
+    if (commands == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    for (size_t index = 0; index < command_count; ++index) {
+        commands[index] = copy_command(templates[index]);
+        if (commands[index] == NULL) {
+            for (size_t to_free = 0; to_free < index; ++to_free) {
+                destroy_command(commands[to_free]);
+            }
+            free(commands);
+            return NULL;
+        }
+    }
+
+    return commands;
+}
+
+command **parse_read_line_cached(char *line, size_t *total_commands) {
+    if (line_cache.capacity == 0) {
+        return parse_read_line(line, total_commands);
+    }
+
+    uint64_t hash = hash_line(line);
+    parse_cache_entry *entry = find_entry(line, hash);
+
+    if (entry != NULL) {
+        line_cache.hits++;
+        unlink_entry(entry);
+        push_front_entry(entry);
+
+        *total_commands = entry->command_count;
+        command **commands = copy_templates(entry->commands, entry->command_count);
+        if (commands == NULL) {
+            *total_commands = 0;
+            return NULL;
+        }
+        return instantiate_commands(commands, total_commands, entry->dropped_last);
+    }
+
+    line_cache.misses++;
+
+    int dropped_last;
+    int reported_error;
+    command **templates = parse_read_line_templates(line, total_commands, &dropped_last, &reported_error);
+    if (templates == NULL) {
+        return NULL;
+    }
+
+    // A line whose parsing printed an error has to be parsed again to print it again
+    if (reported_error) {
+        return instantiate_commands(templates, total_commands, dropped_last);
+    }
+
+    command **commands = copy_templates(templates, *total_commands);
+    if (commands == NULL) {
+        return instantiate_commands(templates, total_commands, dropped_last);
+    }
+
+    if (insert_entry(line, hash, templates, *total_commands, dropped_last) == -1) {
+        for (size_t index = 0; index < *total_commands; ++index) {
+            destroy_command(templates[index]);
+        }
+        free(templates);
+    }
+
+    return instantiate_commands(commands, total_commands, dropped_last);
+}
+
+void print_parse_cache_stats(int fd) {
+    dprintf(fd, "parse cache: %zu hits, %zu misses, %zu evictions, %zu/%zu entries\n", line_cache.hits,
+            line_cache.misses, line_cache.evictions, line_cache.size, line_cache.capacity);
+}
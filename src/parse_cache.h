@@ -0,0 +1,58 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include "command.h"
+
+#include <stdint.h>
+
+/** Default number of lines kept by the parse cache. */
+#define PARSE_CACHE_DEFAULT_CAPACITY 64
+
+/** Name of the environment variable asking for the cache statistics at exit. */
+#define PARSE_CACHE_STATS_ENV "JSH_PARSE_CACHE_STATS"
+
+/** A parsed line, its commands are templates that are copied and instantiated for every execution. */
+typedef struct parse_cache_entry {
+    char *line;
+    uint64_t hash;
+    command **commands;
+    size_t command_count;
+    int dropped_last;
+    struct parse_cache_entry *previous; // Towards the most recently used entry
+    struct parse_cache_entry *next;     // Towards the least recently used entry
+    struct parse_cache_entry *bucket_next;
+} parse_cache_entry;
+
+typedef struct parse_cache {
+    parse_cache_entry **buckets;
+    size_t bucket_count;
+    parse_cache_entry *most_recent;
+    parse_cache_entry *least_recent;
+    size_t size;
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} parse_cache;
+
+extern parse_cache line_cache;
+
+/** Initializes the parse cache so that it keeps at most `capacity` lines, 0 disables it. */
+void init_parse_cache(size_t capacity);
+
+/** Frees every entry of the parse cache and disables it. */
+void destroy_parse_cache();
+
+/** Returns the FNV-1a hash of the string. */
+uint64_t hash_line(const char *line);
+
+/**
+ * Same as `parse_read_line`, but lines that were already parsed successfully are only
+ * instantiated again: their pipes are created and their files opened.
+ */
+command **parse_read_line_cached(char *line, size_t *total_commands);
+
+/** Prints the hits, misses and evictions of the parse cache to `fd`. */
+void print_parse_cache_stats(int fd);
+
+#endif // PARSE_CACHE_H
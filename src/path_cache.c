@@ -0,0 +1,330 @@
+#define _GNU_SOURCE // strchrnul
+
+#include "path_cache.h"
+#include "parse_cache.h"
+
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Directories searched by `execvp` when `PATH` is not set. */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+/** Changes of a directory of `PATH` that can make a command appear or disappear. */
+#define PATH_DIRECTORY_EVENTS                                                                                          \
+    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+path_cache command_paths = {.inotify_fd = -1};
+
+/** Returns the value of `PATH`, or the directories `execvp` would use without it. */
+const char *get_path_variable() {
+    const char *path_variable = getenv("PATH");
+    return path_variable == NULL ? DEFAULT_PATH : path_variable;
+}
+
+/** Watches every directory of `PATH`, and notes whether some of them are relative or could not be watched. */
+void watch_path_directories() {
+    if (command_paths.inotify_fd != -1) {
+        close(command_paths.inotify_fd);
+    }
+
+    command_paths.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    command_paths.has_relative_directory = 0;
+    command_paths.has_unwatched_directory = 0;
+
+    char directory[PATH_MAX];
+    const char *start = command_paths.path_variable;
+    while (1) {
+        const char *end = strchrnul(start, ':');
+        size_t length = end - start;
+
+        if (length == 0 || start[0] != '/') {
+            command_paths.has_relative_directory = 1;
+        } else if (command_paths.inotify_fd != -1 && length < PATH_MAX) {
+            memcpy(directory, start, length);
+            directory[length] = '\0';
+            // A directory that does not exist yet cannot be watched, a command could appear in it unnoticed
+            if (inotify_add_watch(command_paths.inotify_fd, directory, PATH_DIRECTORY_EVENTS) == -1) {
+                command_paths.has_unwatched_directory = 1;
+            }
+        } else if (length >= PATH_MAX) {
+            command_paths.has_unwatched_directory = 1;
+        }
+
+        if (*end == '\0') {
+            break;
+        }
+        start = end + 1;
+    }
+}
+
+void init_path_cache() {
+    free(command_paths.path_variable);
+    command_paths.path_variable = strdup(get_path_variable());
+    if (command_paths.path_variable == NULL) {
+        perror("strdup");
+        return;
+    }
+
+    watch_path_directories();
+}
+
+void destroy_path_cache_entry(path_cache_entry *entry) {
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+}
+
+void clear_path_cache(int keep_pinned) {
+    for (size_t bucket = 0; bucket < PATH_CACHE_BUCKET_COUNT; ++bucket) {
+        path_cache_entry **link = &command_paths.buckets[bucket];
+        while (*link != NULL) {
+            path_cache_entry *entry = *link;
+            if (keep_pinned && entry->pinned) {
+                link = &entry->bucket_next;
+                continue;
+            }
+
+            *link = entry->bucket_next;
+            destroy_path_cache_entry(entry);
+            command_paths.size--;
+        }
+    }
+}
+
+void destroy_path_cache() {
+    clear_path_cache(0);
+
+    if (command_paths.inotify_fd != -1) {
+        close(command_paths.inotify_fd);
+    }
+    free(command_paths.path_variable);
+    memset(&command_paths, 0, sizeof(command_paths));
+    command_paths.inotify_fd = -1;
+}
+
+/**
+ * Clears the cache if `PATH` changed since the entries were resolved, or if one of its directories did.
+ * Pinned entries only go away with `PATH` itself.
+ */
+void synchronize_path_cache() {
+    const char *path_variable = get_path_variable();
+    if (command_paths.path_variable == NULL || strcmp(command_paths.path_variable, path_variable) != 0) {
+        clear_path_cache(0);
+        init_path_cache();
+        return;
+    }
+
+    if (command_paths.inotify_fd == -1) {
+        return;
+    }
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    int lost_watch = 0;
+    ssize_t length;
+    while ((length = read(command_paths.inotify_fd, events, sizeof(events))) > 0) {
+        changed = 1;
+        for (char *event = events; event < events + length;) {
+            const struct inotify_event *inotify_event = (const struct inotify_event *)event;
+            if (inotify_event->mask & (IN_IGNORED | IN_Q_OVERFLOW)) {
+                lost_watch = 1;
+            }
+            event += sizeof(struct inotify_event) + inotify_event->len;
+        }
+    }
+
+    if (changed) {
+        clear_path_cache(1);
+    }
+    if (lost_watch) {
+        // A directory was removed or moved, the one now at its place has to be watched
+        watch_path_directories();
+    }
+}
+
+command_location search_command_path(const char *name, char **path) {
+    *path = NULL;
+    if (*name == '\0' || strchr(name, '/') != NULL) {
+        return COMMAND_UNRESOLVED;
+    }
+
+    command_location location = COMMAND_MISSING;
+    size_t name_length = strlen(name);
+    char candidate[PATH_MAX];
+
+    const char *start = get_path_variable();
+    while (1) {
+        const char *end = strchrnul(start, ':');
+        size_t length = end - start;
+
+        // An empty directory stands for the working directory, like for execvp
+        if (length == 0) {
+            start = ".";
+            length = 1;
+        }
+
+        if (length + name_length + 2 <= PATH_MAX) {
+            memcpy(candidate, start, length);
+            candidate[length] = '/';
+            memcpy(candidate + length + 1, name, name_length + 1);
+
+            struct stat file_stat;
+            if (stat(candidate, &file_stat) == 0) {
+                if (S_ISREG(file_stat.st_mode) && access(candidate, X_OK) == 0) {
+                    *path = strdup(candidate);
+                    if (*path == NULL) {
+                        perror("strdup");
+                        return COMMAND_UNRESOLVED;
+                    }
+                    return COMMAND_FOUND;
+                }
+
+                // execvp goes on as well, but reports the permission error if nothing else is found
+                location = COMMAND_UNRESOLVED;
+            }
+        }
+
+        if (*end == '\0') {
+            break;
+        }
+        start = end + 1;
+    }
+
+    return location;
+}
+
+path_cache_entry *find_command_path(const char *name) {
+    uint64_t hash = hash_line(name);
+    path_cache_entry *entry = command_paths.buckets[hash % PATH_CACHE_BUCKET_COUNT];
+    while (entry != NULL) {
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+        entry = entry->bucket_next;
+    }
+    return NULL;
+}
+
+/** Removes the entry of the command from the cache, if there is one. */
+void remove_command_path(const char *name) {
+    uint64_t hash = hash_line(name);
+    path_cache_entry **link = &command_paths.buckets[hash % PATH_CACHE_BUCKET_COUNT];
+    while (*link != NULL) {
+        path_cache_entry *entry = *link;
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+            *link = entry->bucket_next;
+            destroy_path_cache_entry(entry);
+            command_paths.size--;
+            return;
+        }
+        link = &entry->bucket_next;
+    }
+}
+
+/** Adds an entry to the cache, which takes ownership of `path`. Returns NULL on failure. */
+path_cache_entry *insert_command_path(const char *name, char *path, int pinned) {
+    path_cache_entry *entry = malloc(sizeof(path_cache_entry));
+    if (entry == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    entry->name = strdup(name);
+    if (entry->name == NULL) {
+        perror("strdup");
+        free(entry);
+        return NULL;
+    }
+
+    entry->hash = hash_line(name);
+    entry->path = path;
+    entry->hits = 0;
+    entry->pinned = pinned;
+
+    size_t bucket = entry->hash % PATH_CACHE_BUCKET_COUNT;
+    entry->bucket_next = command_paths.buckets[bucket];
+    command_paths.buckets[bucket] = entry;
+    command_paths.size++;
+    return entry;
+}
+
+command_location resolve_command_path(const char *name, const char **path) {
+    *path = NULL;
+    if (*name == '\0' || strchr(name, '/') != NULL) {
+        return COMMAND_UNRESOLVED;
+    }
+
+    synchronize_path_cache();
+
+    path_cache_entry *entry = find_command_path(name);
+    if (entry == NULL) {
+        char *found;
+        command_location location = search_command_path(name, &found);
+
+        // A missing command is only remembered while a new file in any directory of `PATH` would be noticed
+        int unwatched = command_paths.inotify_fd == -1 || command_paths.has_unwatched_directory;
+        if (location == COMMAND_UNRESOLVED || command_paths.has_relative_directory ||
+            (location == COMMAND_MISSING && unwatched)) {
+            free(found);
+            return location == COMMAND_MISSING ? COMMAND_MISSING : COMMAND_UNRESOLVED;
+        }
+
+        entry = insert_command_path(name, found, 0);
+        if (entry == NULL) {
+            free(found);
+            return COMMAND_UNRESOLVED;
+        }
+    }
+
+    entry->hits++;
+    if (entry->path == NULL) {
+        return COMMAND_MISSING;
+    }
+
+    *path = entry->path;
+    return COMMAND_FOUND;
+}
+
+int pin_command_path(const char *name, const char *path) {
+    char *copy = strdup(path);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+
+    // Otherwise a change of `PATH` noticed on the next lookup would remove the entry right away
+    synchronize_path_cache();
+
+    remove_command_path(name);
+    if (insert_command_path(name, copy, 1) == NULL) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+void print_path_cache(int fd) {
+    int empty = 1;
+    for (size_t bucket = 0; bucket < PATH_CACHE_BUCKET_COUNT; ++bucket) {
+        for (path_cache_entry *entry = command_paths.buckets[bucket]; entry != NULL; entry = entry->bucket_next) {
+            if (entry->path == NULL) {
+                continue;
+            }
+
+            if (empty) {
+                dprintf(fd, "hits\tcommand\n");
+                empty = 0;
+            }
+            dprintf(fd, "%4zu\t%s\n", entry->hits, entry->path);
+        }
+    }
+
+    if (empty) {
+        dprintf(fd, "hash: hash table empty\n");
+    }
+}
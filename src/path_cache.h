@@ -0,0 +1,72 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of buckets of the command path cache. */
+#define PATH_CACHE_BUCKET_COUNT 128
+
+/** Where a command name was found in `PATH`. */
+typedef enum command_location {
+    COMMAND_FOUND,     // An executable file was found, its path is known
+    COMMAND_MISSING,   // No directory of `PATH` has a file with this name
+    COMMAND_UNRESOLVED // The name is a path, or a file exists but is not executable, `execvp` has to decide
+} command_location;
+
+/** A command name and its location, `path` is NULL for a command known to be missing. */
+typedef struct path_cache_entry {
+    char *name;
+    uint64_t hash;
+    char *path;
+    size_t hits;
+    int pinned; // Added by `hash -p`, kept when a directory of `PATH` changes
+    struct path_cache_entry *bucket_next;
+} path_cache_entry;
+
+typedef struct path_cache {
+    path_cache_entry *buckets[PATH_CACHE_BUCKET_COUNT];
+    size_t size;
+    char *path_variable;         // Value of `PATH` the entries were resolved with
+    int inotify_fd;              // Watches the directories of `PATH`, -1 if they are not watched
+    int has_relative_directory;  // Such directories depend on the working directory, nothing is cached then
+    int has_unwatched_directory; // Some directory could not be watched, missing commands are not cached then
+} path_cache;
+
+extern path_cache command_paths;
+
+/**
+ * Starts watching the directories of `PATH` so that the cache is invalidated when they change.
+ * Commands are only remembered as missing while the directories are watched.
+ */
+void init_path_cache();
+
+/** Frees every entry of the cache and stops watching the directories. */
+void destroy_path_cache();
+
+/** Forgets every entry. Entries added by `hash -p` are kept if `keep_pinned` is 1. */
+void clear_path_cache(int keep_pinned);
+
+/**
+ * Searches the directories of `PATH` for the command, without using the cache.
+ * Sets `path` to a newly allocated path when the command is found, to NULL otherwise.
+ */
+command_location search_command_path(const char *name, char **path);
+
+/**
+ * Returns the location of the command, searching `PATH` and caching the result if it is not known yet.
+ * The cache is cleared first if `PATH` or one of its directories changed.
+ * `path` is set to the path owned by the cache when the command is found.
+ */
+command_location resolve_command_path(const char *name, const char **path);
+
+/** Returns the cached entry of the command without checking it is still valid, NULL if there is none. */
+path_cache_entry *find_command_path(const char *name);
+
+/** Makes `name` refer to `path` until the cache is cleared explicitly. Returns -1 on failure. */
+int pin_command_path(const char *name, const char *path);
+
+/** Prints the commands found so far with their number of uses to `fd`. */
+void print_path_cache(int fd);
+
+#endif // PATH_CACHE_H
@@ -1,6 +1,6 @@
 #include "proc.h"
-#include "string_utils.h"
 
+#include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <linux/limits.h>
@@ -17,99 +17,270 @@ int *get_children(int pid, size_t *size) {
 
     snprintf(path, PATH_MAX, "/proc/%d/task/%d/children", pid, pid);
 
-    int fd = open(path, O_RDONLY);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
 
     if (fd < 0) {
         return NULL;
     }
 
-    char buf[BUFSIZ] = "";
-    size_t total_size = 0;
-    char *string = malloc(sizeof(char));
-    string[0] = '\0';
+    // Read at once into a buffer doubled whenever it is full
+    size_t capacity = BUFSIZ;
+    size_t length = 0;
+    char *content = malloc(capacity);
+    if (content == NULL) {
+        perror("malloc");
+        close(fd);
+        return NULL;
+    }
 
-    if (string == NULL) {
+    ssize_t nb_read;
+    while ((nb_read = read(fd, content + length, capacity - length - 1)) > 0) {
+        length += nb_read;
+        if (length + 1 == capacity) {
+            char *grown = realloc(content, capacity * 2);
+            if (grown == NULL) {
+                perror("realloc");
+                free(content);
+                close(fd);
+                return NULL;
+            }
+            content = grown;
+            capacity *= 2;
+        }
+    }
+    close(fd);
+
+    if (nb_read < 0) {
+        perror("read");
+        free(content);
+        return NULL;
+    }
+    content[length] = '\0';
+
+    // Pids are followed by a space, so there are at most half as many as characters
+    int *children_pid = malloc((length / 2 + 1) * sizeof(int));
+    if (children_pid == NULL) {
         perror("malloc");
+        free(content);
         return NULL;
     }
 
-    int nb_read = 1;
-    while (nb_read) {
-        nb_read = read(fd, buf, BUFSIZ);
+    char *word = content;
+    while (*word != '\0') {
+        char *end;
+        long value = strtol(word, &end, 10);
 
-        if (nb_read < 0) {
-            perror("read");
-            free(string);
-            close(fd);
+        // Handling invalid parsed value
+        if (end == word || value <= 0 || value > INT_MAX) {
+            *size = 0;
+            free(children_pid);
+            free(content);
             return NULL;
         }
 
-        char *new_string = malloc((total_size + nb_read + 1) * sizeof(char));
-
-        if (new_string == NULL) {
-            perror("malloc");
-            free(string);
-            close(fd);
-            return NULL;
+        children_pid[(*size)++] = (int)value;
+        word = end;
+        while (*word == ' ' || *word == '\n') {
+            ++word;
         }
+    }
+
+    free(content);
+    return children_pid;
+}
 
-        snprintf(new_string, total_size + nb_read, "%s%s", string, buf);
-        total_size += nb_read;
+int has_children(pid_t pid) {
 
-        free(string);
-        string = new_string;
+    size_t size = 0;
+    int *children = get_children(pid, &size);
+
+    if (children == NULL) {
+        return -1;
     }
-    string[total_size] = '\0';
 
-    close(fd);
+    free(children);
 
-    char **children_string = split_string(string, " ", size);
-    free(string);
+    return size > 0;
+}
 
-    int *children_pid = malloc(*size * sizeof(int));
-    if (children_pid == NULL) {
+pid_t *get_threads(pid_t pid, size_t *size) {
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "/proc/%d/task", pid);
+    *size = 0;
+
+    DIR *directory = opendir(path);
+    if (directory == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 1;
+    pid_t *threads = malloc(capacity * sizeof(pid_t));
+    if (threads == NULL) {
         perror("malloc");
+        closedir(directory);
         return NULL;
     }
 
-    for (size_t index = 0; index < *size; ++index) {
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        if (*size == capacity) {
+            capacity *= 2;
+            pid_t *grown = realloc(threads, capacity * sizeof(pid_t));
+            if (grown == NULL) {
+                perror("realloc");
+                free(threads);
+                closedir(directory);
+                *size = 0;
+                return NULL;
+            }
+            threads = grown;
+        }
+        threads[(*size)++] = atoi(entry->d_name);
+    }
 
-        long cast;
-        int parse_status = parse_intmax_t(children_string[index], &cast, STDERR_FILENO);
+    closedir(directory);
+    return threads;
+}
 
-        if (parse_status && INT_MIN <= cast && cast <= INT_MAX) {
-            children_pid[index] = (int)cast;
-            continue;
+/**
+ * Reads /proc/<pid>/<name> into the buffer, null terminated. Returns -1 if it cannot be read.
+ * Only async-signal-safe functions are used, the SIGCHLD handler reads the I/O counters of zombies with it.
+ */
+ssize_t read_proc_file(pid_t pid, const char *name, char *buffer, size_t size) {
+    char digits[16];
+    size_t digit_count = 0;
+    for (unsigned int rest = pid; digit_count == 0 || rest > 0; rest /= 10) {
+        digits[digit_count++] = '0' + rest % 10;
+    }
+
+    char path[PATH_MAX] = "/proc/";
+    size_t length = strlen(path);
+    while (digit_count > 0) {
+        path[length++] = digits[--digit_count];
+    }
+    path[length++] = '/';
+    path[length] = '\0';
+    if (length + strlen(name) >= PATH_MAX) {
+        return -1;
+    }
+    strcpy(path + length, name);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ssize_t read_length = read(fd, buffer, size - 1);
+    close(fd);
+    if (read_length < 0) {
+        return -1;
+    }
+    buffer[read_length] = '\0';
+    return read_length;
+}
+
+/** Returns the number following `key` in the "key: value" lines of `content`, 0 if it is not found. */
+unsigned long long find_proc_field(const char *content, const char *key) {
+    size_t key_length = strlen(key);
+    const char *line = content;
+    while (line != NULL) {
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+            // Parsed by hand, strtoull is not async-signal-safe
+            unsigned long long value = 0;
+            const char *digit = line + key_length + 1;
+            while (*digit == ' ' || *digit == '\t') {
+                ++digit;
+            }
+            for (; *digit >= '0' && *digit <= '9'; ++digit) {
+                value = value * 10 + (*digit - '0');
+            }
+            return value;
         }
 
-        // Handling invalid parsed value
-        *size = 0;
-        for (size_t index = 0; index < *size; ++index) {
-            free(children_string[index]);
+        line = strchr(line, '\n');
+        if (line != NULL) {
+            ++line;
         }
-        free(children_string);
-        free(children_pid);
-        return NULL;
     }
+    return 0;
+}
 
-    for (size_t index = 0; index < *size; ++index) {
-        free(children_string[index]);
+int read_process_io(pid_t pid, subjob_usage *usage) {
+    char content[BUFSIZ];
+    if (read_proc_file(pid, "io", content, sizeof(content)) == -1) {
+        return -1;
     }
-    free(children_string);
 
-    return children_pid;
+    usage->read_bytes = find_proc_field(content, "rchar");
+    usage->written_bytes = find_proc_field(content, "wchar");
+    return 0;
 }
 
-int has_children(pid_t pid) {
+/** Converts a number of clock ticks of /proc into a duration. */
+struct timeval ticks_to_timeval(unsigned long ticks) {
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    struct timeval time = {.tv_sec = ticks / ticks_per_second,
+                           .tv_usec = (ticks % ticks_per_second) * 1000000 / ticks_per_second};
+    return time;
+}
 
-    size_t size = 0;
-    int *children = get_children(pid, &size);
+int read_process_usage(pid_t pid, subjob_usage *usage) {
+    char content[BUFSIZ];
+    if (read_proc_file(pid, "stat", content, sizeof(content)) == -1) {
+        return -1;
+    }
 
-    if (children == NULL) {
+    // The name of the command may contain spaces and parentheses, the fields start after the last one
+    char *fields = strrchr(content, ')');
+    unsigned long major_faults = 0;
+    unsigned long user_ticks = 0;
+    unsigned long system_ticks = 0;
+    if (fields == NULL || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %lu %*u %lu %lu", &major_faults,
+                                 &user_ticks, &system_ticks) != 3) {
         return -1;
     }
+    usage->major_faults = major_faults;
+    usage->user_time = ticks_to_timeval(user_ticks);
+    usage->system_time = ticks_to_timeval(system_ticks);
 
-    free(children);
+    if (read_proc_file(pid, "status", content, sizeof(content)) != -1) {
+        usage->max_rss = find_proc_field(content, "VmHWM");
+        usage->context_switches = find_proc_field(content, "voluntary_ctxt_switches");
+        usage->context_switches += find_proc_field(content, "nonvoluntary_ctxt_switches");
+    }
 
-    return size > 0;
+    read_process_io(pid, usage);
+    return 0;
+}
+
+char *get_process_command(pid_t pid) {
+    char content[BUFSIZ];
+    ssize_t length = read_proc_file(pid, "cmdline", content, sizeof(content));
+    if (length <= 0) {
+        length = read_proc_file(pid, "comm", content, sizeof(content));
+        if (length <= 0) {
+            return NULL;
+        }
+    }
+
+    // Arguments are separated by null bytes, the name ends with a newline
+    while (length > 0 && (content[length - 1] == '\0' || content[length - 1] == '\n')) {
+        --length;
+    }
+    for (ssize_t i = 0; i < length; ++i) {
+        if (content[i] == '\0') {
+            content[i] = ' ';
+        }
+    }
+    content[length] = '\0';
+
+    char *command = strdup(content);
+    if (command == NULL) {
+        perror("strdup");
+    }
+    return command;
 }
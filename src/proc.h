@@ -1,6 +1,8 @@
 #ifndef PROC_H
 #define PROC_H
 
+#include "usage.h"
+
 #include <sys/types.h>
 
 /**
@@ -19,4 +21,29 @@ int *get_children(pid_t pid, size_t *size);
  */
 int has_children(pid_t pid);
 
+/**
+ * Returns the ids of the threads of the process, read from /proc/<pid>/task, and sets `size`.
+ * Returns NULL if the process does not exist.
+ */
+pid_t *get_threads(pid_t pid, size_t *size);
+
+/**
+ * Sets the I/O counters of the usage from /proc/<pid>/io, which is still readable while the process is a zombie.
+ * Returns -1 if the file could not be read. It is async-signal-safe.
+ */
+int read_process_io(pid_t pid, subjob_usage *usage);
+
+/**
+ * Fills the usage of a process that is still running (or not reaped yet) from /proc/<pid>/stat, status and io.
+ * Returns -1 if the process does not exist.
+ */
+int read_process_usage(pid_t pid, subjob_usage *usage);
+
+/**
+ * Returns the command line of the process, its arguments separated by spaces, or its name for the processes without
+ * one, such as zombies.
+ * Returns NULL if the process does not exist.
+ */
+char *get_process_command(pid_t pid);
+
 #endif // PROC_H
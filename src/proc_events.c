@@ -0,0 +1,385 @@
+#include "proc_events.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Size asked for the buffer of the socket, so that the events happening while a job runs in the foreground fit. */
+#define PROC_EVENTS_SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+
+int proc_events_fd = -1;
+
+/** Descendants of the shell by pid, chained through `next_in_index` within a bucket. */
+process_node **process_index;
+size_t process_index_size;
+size_t process_index_capacity;
+
+/** Pid of the shell, the processes it forks are the roots of the tree. */
+pid_t shell_pid;
+
+/** Returns the bucket of the pid index holding the pid, the capacity being a power of two. */
+size_t process_index_bucket(pid_t pid, size_t capacity) {
+    return (size_t)pid & (capacity - 1);
+}
+
+/** Doubles the number of buckets of the pid index, creating it if needed. Returns -1 on failure. */
+int grow_process_index() {
+    size_t capacity = process_index == NULL ? INITIAL_PROCESS_INDEX_CAPACITY : process_index_capacity * 2;
+    process_node **index = calloc(capacity, sizeof(process_node *));
+    if (index == NULL) {
+        perror("calloc");
+        return -1;
+    }
+
+    for (size_t bucket = 0; bucket < process_index_capacity; bucket++) {
+        process_node *next;
+        for (process_node *node = process_index[bucket]; node != NULL; node = next) {
+            next = node->next_in_index;
+            size_t new_bucket = process_index_bucket(node->pid, capacity);
+            node->next_in_index = index[new_bucket];
+            index[new_bucket] = node;
+        }
+    }
+
+    free(process_index);
+    process_index = index;
+    process_index_capacity = capacity;
+    return 0;
+}
+
+process_node *find_process_node(pid_t pid) {
+    if (process_index == NULL) {
+        return NULL;
+    }
+
+    for (process_node *node = process_index[process_index_bucket(pid, process_index_capacity)]; node != NULL;
+         node = node->next_in_index) {
+        if (node->pid == pid) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/** Makes the node the first child of `parent`, or a child of the shell if it is NULL. */
+void link_process_node(process_node *node, process_node *parent) {
+    node->parent = parent;
+    node->previous_sibling = NULL;
+    node->next_sibling = NULL;
+    if (parent == NULL) {
+        return; // The children of the shell are only found through the index
+    }
+
+    node->next_sibling = parent->first_child;
+    if (parent->first_child != NULL) {
+        parent->first_child->previous_sibling = node;
+    }
+    parent->first_child = node;
+}
+
+/** Removes the node from the children of its parent. */
+void unlink_process_node(process_node *node) {
+    if (node->previous_sibling != NULL) {
+        node->previous_sibling->next_sibling = node->next_sibling;
+    } else if (node->parent != NULL) {
+        node->parent->first_child = node->next_sibling;
+    }
+    if (node->next_sibling != NULL) {
+        node->next_sibling->previous_sibling = node->previous_sibling;
+    }
+}
+
+/** Adds a descendant below `parent`, NULL for a child of the shell. Returns NULL on failure. */
+process_node *add_process_node(pid_t pid, process_node *parent) {
+    if (process_index_size >= process_index_capacity && grow_process_index() == -1) {
+        return NULL;
+    }
+
+    process_node *node = calloc(1, sizeof(process_node));
+    if (node == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+
+    // A forked process runs the command of its parent until it executes another one
+    node->pid = pid;
+    if (parent != NULL) {
+        strcpy(node->name, parent->name);
+    }
+    link_process_node(node, parent);
+
+    size_t bucket = process_index_bucket(pid, process_index_capacity);
+    node->next_in_index = process_index[bucket];
+    process_index[bucket] = node;
+    process_index_size++;
+    return node;
+}
+
+/** Forgets the descendant, its children going to its parent. */
+void remove_process_node(process_node *node) {
+    process_node *next;
+    for (process_node *child = node->first_child; child != NULL; child = next) {
+        next = child->next_sibling;
+        link_process_node(child, node->parent);
+    }
+    unlink_process_node(node);
+
+    process_node **link = &process_index[process_index_bucket(node->pid, process_index_capacity)];
+    for (; *link != NULL; link = &(*link)->next_in_index) {
+        if (*link == node) {
+            *link = node->next_in_index;
+            process_index_size--;
+            break;
+        }
+    }
+    free(node);
+}
+
+/** Forgets every descendant, keeping the buckets of the index. */
+void clear_process_tree() {
+    for (size_t bucket = 0; bucket < process_index_capacity; bucket++) {
+        process_node *next;
+        for (process_node *node = process_index[bucket]; node != NULL; node = next) {
+            next = node->next_in_index;
+            free(node);
+        }
+        process_index[bucket] = NULL;
+    }
+    process_index_size = 0;
+}
+
+/** Sets the name of the descendant from /proc, once it executed a new command. */
+void read_process_node_name(process_node *node) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/comm", node->pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return; // It already ended, its exit event follows
+    }
+
+    char name[sizeof(node->name)];
+    ssize_t length = read(fd, name, sizeof(name) - 1);
+    close(fd);
+    if (length <= 0) {
+        return;
+    }
+    name[length] = '\0';
+    name[strcspn(name, "\n")] = '\0';
+    strcpy(node->name, name);
+}
+
+/** Adds the descendants of the process of the snapshot below `parent`. */
+void add_snapshot_descendants(const process_snapshot *snapshot, const snapshot_process *process,
+                              process_node *parent) {
+    for (size_t child = process->first_child; child != NO_SNAPSHOT_PROCESS;
+         child = snapshot->processes[child].next_sibling) {
+        const snapshot_process *descendant = &snapshot->processes[child];
+        process_node *node = add_process_node(descendant->pid, parent);
+        if (node == NULL) {
+            continue;
+        }
+        strcpy(node->name, descendant->name);
+        add_snapshot_descendants(snapshot, descendant, node);
+    }
+}
+
+/**
+ * Rebuilds the tree from /proc, once events were dropped. Descendants whose parent ended meanwhile went to init,
+ * and are not found again.
+ */
+void rebuild_process_tree() {
+    clear_process_tree();
+
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    if (take_process_snapshot(&snapshot) == 0) {
+        const snapshot_process *shell = find_snapshot_process(&snapshot, shell_pid);
+        if (shell != NULL) {
+            add_snapshot_descendants(&snapshot, shell, NULL);
+        }
+    }
+    destroy_process_snapshot(&snapshot);
+}
+
+/** Applies an event of the proc connector to the tree, the ones about other processes are ignored. */
+void apply_proc_event(const struct proc_event *event) {
+    process_node *node;
+    switch (event->what) {
+        case PROC_EVENT_FORK: {
+            pid_t pid = event->event_data.fork.child_pid;
+            pid_t parent_pid = event->event_data.fork.parent_tgid;
+            if (pid != event->event_data.fork.child_tgid) {
+                return; // A new thread
+            }
+
+            process_node *parent = find_process_node(parent_pid);
+            if (parent == NULL && parent_pid != shell_pid) {
+                return;
+            }
+
+            // The end of a process that had the same pid was missed
+            if ((node = find_process_node(pid)) != NULL) {
+                remove_process_node(node);
+            }
+
+            node = add_process_node(pid, parent);
+            if (node != NULL && parent == NULL) {
+                read_process_node_name(node);
+            }
+            return;
+        }
+        case PROC_EVENT_EXEC:
+            if ((node = find_process_node(event->event_data.exec.process_tgid)) != NULL) {
+                read_process_node_name(node);
+            }
+            return;
+        case PROC_EVENT_COMM:
+            if (event->event_data.comm.process_pid == event->event_data.comm.process_tgid &&
+                (node = find_process_node(event->event_data.comm.process_tgid)) != NULL) {
+                memcpy(node->name, event->event_data.comm.comm, sizeof(node->name) - 1);
+                node->name[sizeof(node->name) - 1] = '\0';
+            }
+            return;
+        case PROC_EVENT_EXIT:
+            if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid &&
+                (node = find_process_node(event->event_data.exit.process_tgid)) != NULL) {
+                remove_process_node(node);
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+void read_proc_events() {
+    if (proc_events_fd == -1) {
+        return;
+    }
+
+    char buffer[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    while (1) {
+        struct sockaddr_nl sender;
+        socklen_t sender_length = sizeof(sender);
+        ssize_t length =
+            recvfrom(proc_events_fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&sender, &sender_length);
+        if (length == -1) {
+            if (errno == ENOBUFS) {
+                rebuild_process_tree(); // The socket was full, events were dropped
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recvfrom");
+            }
+            return;
+        }
+        if (sender.nl_pid != 0) {
+            continue; // Only the kernel sends the events
+        }
+
+        int remaining = length;
+        for (struct nlmsghdr *header = (struct nlmsghdr *)buffer; NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            struct cn_msg *message = NLMSG_DATA(header);
+            if (header->nlmsg_type == NLMSG_DONE && message->id.idx == CN_IDX_PROC &&
+                message->id.val == CN_VAL_PROC) {
+                apply_proc_event((const struct proc_event *)message->data);
+            }
+        }
+    }
+}
+
+/** Asks the proc connector to send its events to the socket. Returns -1 on failure. */
+int subscribe_to_proc_events(int fd) {
+    struct {
+        struct nlmsghdr header;
+        struct cn_msg message;
+        enum proc_cn_mcast_op operation;
+    } request;
+    memset(&request, 0, sizeof(request));
+
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    request.header.nlmsg_type = NLMSG_DONE;
+    request.header.nlmsg_pid = getpid();
+    request.message.id.idx = CN_IDX_PROC;
+    request.message.id.val = CN_VAL_PROC;
+    request.message.len = sizeof(enum proc_cn_mcast_op);
+    request.operation = PROC_CN_MCAST_LISTEN;
+
+    return send(fd, &request, request.header.nlmsg_len, 0) == -1 ? -1 : 0;
+}
+
+void init_proc_events() {
+    char *backend = getenv(PROCESS_TREE_BACKEND_ENV);
+    if (backend == NULL || strcmp(backend, "netlink") != 0) {
+        return;
+    }
+
+    shell_pid = getpid();
+    if (process_index == NULL && grow_process_index() == -1) {
+        return;
+    }
+
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd == -1) {
+        perror("socket");
+        return;
+    }
+
+    // Going over the limit of the system needs the same privileges as the subscription, it is kept otherwise
+    int size = PROC_EVENTS_SOCKET_BUFFER_SIZE;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == -1) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    struct sockaddr_nl address = {.nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC, .nl_pid = 0};
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) == -1 || subscribe_to_proc_events(fd) == -1) {
+        perror("proc connector"); // The trees are read from /proc instead
+        close(fd);
+        return;
+    }
+    proc_events_fd = fd;
+}
+
+int take_process_snapshot_from_events(process_snapshot *snapshot) {
+    read_proc_events();
+
+    snapshot->count = 0;
+    for (size_t bucket = 0; bucket < process_index_capacity; bucket++) {
+        for (process_node *node = process_index[bucket]; node != NULL; node = node->next_in_index) {
+            snapshot_process *process = append_snapshot_process(snapshot);
+            if (process == NULL) {
+                snapshot->count = 0;
+                return -1;
+            }
+            process->pid = node->pid;
+            process->ppid = node->parent != NULL ? node->parent->pid : shell_pid;
+            process->state = UNKNOWN_PROCESS_STATE;
+            strcpy(process->name, node->name);
+        }
+    }
+
+    link_snapshot_children(snapshot);
+    return 0;
+}
+
+void destroy_proc_events() {
+    if (proc_events_fd != -1) {
+        close(proc_events_fd);
+        proc_events_fd = -1;
+    }
+
+    clear_process_tree();
+    free(process_index);
+    process_index = NULL;
+    process_index_capacity = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include "proc_snapshot.h"
+
+#include <sys/types.h>
+
+/** Environment variable selecting where the trees of `jobs -t` come from, either "proc" or "netlink". */
+#define PROCESS_TREE_BACKEND_ENV "JSH_PROCESS_TREE"
+
+/** Original number of buckets of the index of the descendants, doubled whenever it holds as many as buckets. */
+#define INITIAL_PROCESS_INDEX_CAPACITY 64
+
+/** A descendant of the shell, as the events of the proc connector described it. */
+typedef struct process_node {
+    pid_t pid;
+    char name[16];                         // Name of its command, truncated by the kernel
+    struct process_node *parent;           // Closest ancestor still running, NULL for a child of the shell
+    struct process_node *first_child;      // Descendants whose closest running ancestor is this one
+    struct process_node *next_sibling;     // Next child of the same parent
+    struct process_node *previous_sibling; // Previous child of the same parent, NULL for the first one
+    struct process_node *next_in_index;    // Next descendant of the same bucket of the pid index
+} process_node;
+
+/**
+ * Netlink socket receiving the fork, exec and exit events of every process from the proc connector,
+ * -1 if the trees are read from /proc.
+ */
+extern int proc_events_fd;
+
+/**
+ * Subscribes to the events of the proc connector if `PROCESS_TREE_BACKEND_ENV` is "netlink". The trees are still read
+ * from /proc if the socket cannot be used, the subscription needing privileges.
+ */
+void init_proc_events();
+
+/**
+ * Applies the pending events to the tree of the descendants of the shell, which is rebuilt from /proc if some events
+ * were dropped. A process stays below the job it was forked from when its parent ends, instead of going to init.
+ */
+void read_proc_events();
+
+/** Returns the descendant of the shell with the pid, NULL if it is not known. */
+process_node *find_process_node(pid_t);
+
+/**
+ * Fills the snapshot with the descendants of the shell, after applying the pending events, without reading /proc.
+ * Their state is not known from the events, it is `UNKNOWN_PROCESS_STATE`. Returns -1 on failure.
+ */
+int take_process_snapshot_from_events(process_snapshot *);
+
+/** Closes the socket and forgets every descendant. */
+void destroy_proc_events();
+
+#endif // PROC_EVENTS_H
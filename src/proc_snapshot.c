@@ -0,0 +1,173 @@
+#define _GNU_SOURCE // getdents64 and struct dirent64
+
+#include "proc_snapshot.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Size of the buffer the entries of /proc are read into, enough for a few hundred processes per call. */
+#define SNAPSHOT_BUFFER_SIZE 32768
+
+/** Original number of processes a snapshot has room for, doubled whenever it is full. */
+#define INITIAL_SNAPSHOT_CAPACITY 256
+
+void init_process_snapshot(process_snapshot *snapshot) {
+    snapshot->processes = NULL;
+    snapshot->count = 0;
+    snapshot->capacity = 0;
+    snapshot->buffer = NULL;
+}
+
+snapshot_process *append_snapshot_process(process_snapshot *snapshot) {
+    if (snapshot->count == snapshot->capacity) {
+        size_t capacity = snapshot->capacity == 0 ? INITIAL_SNAPSHOT_CAPACITY : snapshot->capacity * 2;
+        snapshot_process *grown = reallocarray(snapshot->processes, capacity, sizeof(snapshot_process));
+        if (grown == NULL) {
+            perror("reallocarray");
+            return NULL;
+        }
+        snapshot->processes = grown;
+        snapshot->capacity = capacity;
+    }
+
+    snapshot_process *process = &snapshot->processes[snapshot->count++];
+    process->first_child = NO_SNAPSHOT_PROCESS;
+    process->next_sibling = NO_SNAPSHOT_PROCESS;
+    return process;
+}
+
+/** Fills the process from the content of its stat file. Returns -1 if it is malformed. */
+int parse_process_stat(const char *content, snapshot_process *process) {
+    // The name of the command may contain spaces and parentheses, the fields start after the last one
+    const char *name = strchr(content, '(');
+    const char *fields = strrchr(content, ')');
+    if (name == NULL || fields == NULL || fields < name || fields[1] != ' ' || fields[2] == '\0' ||
+        fields[3] != ' ') {
+        return -1;
+    }
+
+    size_t name_length = fields - name - 1;
+    if (name_length >= sizeof(process->name)) {
+        name_length = sizeof(process->name) - 1;
+    }
+    memcpy(process->name, name + 1, name_length);
+    process->name[name_length] = '\0';
+
+    char *end;
+    process->pid = strtol(content, &end, 10);
+    process->state = fields[2];
+    process->ppid = strtol(fields + 4, &end, 10);
+    return end == fields + 4 ? -1 : 0;
+}
+
+/** Reads the stat file of the process named `name` in /proc, and adds it to the snapshot. Returns -1 on failure. */
+int add_snapshot_process(process_snapshot *snapshot, int proc_fd, const char *name) {
+    char path[NAME_MAX + 8];
+    snprintf(path, sizeof(path), "%s/stat", name);
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0; // It ended since /proc was read
+    }
+
+    char content[1024];
+    ssize_t length = read(fd, content, sizeof(content) - 1);
+    close(fd);
+    if (length <= 0) {
+        return 0;
+    }
+    content[length] = '\0';
+
+    snapshot_process *added = append_snapshot_process(snapshot);
+    if (added == NULL) {
+        return -1;
+    }
+    if (parse_process_stat(content, added) == -1) {
+        snapshot->count--; // Left out
+    }
+    return 0;
+}
+
+/** Orders processes by increasing pid, for `qsort` and `bsearch`. */
+int compare_snapshot_pids(const void *first, const void *second) {
+    pid_t first_pid = ((const snapshot_process *)first)->pid;
+    pid_t second_pid = ((const snapshot_process *)second)->pid;
+    return first_pid < second_pid ? -1 : first_pid > second_pid ? 1 : 0;
+}
+
+void link_snapshot_children(process_snapshot *snapshot) {
+    // The children of a process are then listed by increasing pid
+    qsort(snapshot->processes, snapshot->count, sizeof(snapshot_process), compare_snapshot_pids);
+
+    // Going through the pids backwards, each child is put before the ones with a greater pid
+    for (size_t index = snapshot->count; index > 0; index--) {
+        snapshot_process *process = &snapshot->processes[index - 1];
+        snapshot_process *parent = (snapshot_process *)find_snapshot_process(snapshot, process->ppid);
+        if (parent != NULL) {
+            process->next_sibling = parent->first_child;
+            parent->first_child = index - 1;
+        }
+    }
+}
+
+int take_process_snapshot(process_snapshot *snapshot) {
+    snapshot->count = 0;
+    if (snapshot->buffer == NULL) {
+        snapshot->buffer = malloc(SNAPSHOT_BUFFER_SIZE);
+        if (snapshot->buffer == NULL) {
+            perror("malloc");
+            return -1;
+        }
+    }
+
+    int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_fd == -1) {
+        perror("open");
+        return -1;
+    }
+
+    int result = 0;
+    ssize_t length;
+    while (result == 0 && (length = getdents64(proc_fd, snapshot->buffer, SNAPSHOT_BUFFER_SIZE)) > 0) {
+        for (ssize_t offset = 0; offset < length && result == 0;) {
+            struct dirent64 *entry = (struct dirent64 *)(snapshot->buffer + offset);
+            offset += entry->d_reclen;
+
+            // Only the directories of processes have a numeric name
+            if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9') {
+                result = add_snapshot_process(snapshot, proc_fd, entry->d_name);
+            }
+        }
+    }
+    if (result == 0 && length == -1) {
+        perror("getdents64");
+        result = -1;
+    }
+
+    close(proc_fd);
+    if (result == -1) {
+        snapshot->count = 0;
+        return -1;
+    }
+
+    link_snapshot_children(snapshot);
+    return 0;
+}
+
+const snapshot_process *find_snapshot_process(const process_snapshot *snapshot, pid_t pid) {
+    if (snapshot->count == 0) {
+        return NULL;
+    }
+
+    snapshot_process key = {.pid = pid};
+    return bsearch(&key, snapshot->processes, snapshot->count, sizeof(snapshot_process), compare_snapshot_pids);
+}
+
+void destroy_process_snapshot(process_snapshot *snapshot) {
+    free(snapshot->processes);
+    free(snapshot->buffer);
+    init_process_snapshot(snapshot);
+}
@@ -0,0 +1,57 @@
+#ifndef PROC_SNAPSHOT_H
+#define PROC_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** Index of no process of a snapshot, ending the lists of children. */
+#define NO_SNAPSHOT_PROCESS SIZE_MAX
+
+/** State of a process of a snapshot that was not read from /proc, the events of the proc connector not giving it. */
+#define UNKNOWN_PROCESS_STATE '?'
+
+/** A process as /proc/<pid>/stat described it when the snapshot was taken. */
+typedef struct snapshot_process {
+    pid_t pid;
+    pid_t ppid;
+    char state;          // Single letter state of /proc: R, S, D, T, Z..., or `UNKNOWN_PROCESS_STATE`
+    char name[16];       // Name of its command, truncated by the kernel
+    size_t first_child;  // Index of its child with the smallest pid, `NO_SNAPSHOT_PROCESS` if it has none
+    size_t next_sibling; // Index of the child of its parent with the next pid, `NO_SNAPSHOT_PROCESS` for the last one
+} snapshot_process;
+
+/** Every process of the system at one point in time, sorted by pid, each one linked to its children. */
+typedef struct process_snapshot {
+    snapshot_process *processes;
+    size_t count;
+    size_t capacity;
+    char *buffer; // Entries of /proc are read into it, kept from one snapshot to the next
+} process_snapshot;
+
+/** Initializes an empty snapshot. */
+void init_process_snapshot(process_snapshot *);
+
+/**
+ * Replaces the processes of the snapshot with the current ones, reading the entries of /proc once with getdents64 and
+ * the stat file of each process. Processes ending meanwhile are left out.
+ * Returns -1 on failure, the snapshot is then empty.
+ */
+int take_process_snapshot(process_snapshot *);
+
+/**
+ * Returns a new process at the end of the snapshot, linked to no other process yet, growing the snapshot if needed.
+ * Returns NULL on failure.
+ */
+snapshot_process *append_snapshot_process(process_snapshot *);
+
+/** Sorts the processes of the snapshot by pid and links each one to its parent, once they are all appended. */
+void link_snapshot_children(process_snapshot *);
+
+/** Returns the process of the snapshot with the pid, NULL if there is none. */
+const snapshot_process *find_snapshot_process(const process_snapshot *, pid_t);
+
+/** Frees the memory allocated for the snapshot, which is then empty. */
+void destroy_process_snapshot(process_snapshot *);
+
+#endif // PROC_SNAPSHOT_H
@@ -1,8 +1,13 @@
 #include "prompt.h"
 #include "jobs.h"
+#include "parse_cache.h"
+#include "proc_events.h"
+#include "reaper.h"
 #include "utils.h"
 
+#include <errno.h>
 #include <readline/readline.h>
+#include <sys/epoll.h>
 
 char *get_prompt_string() {
     char *total_jobs = malloc(1024 * sizeof(char));
@@ -74,45 +79,162 @@ char *get_prompt_string() {
     return prompt_string;
 }
 
+/** Executes the commands of a line read by readline. */
+void execute_line(char *buf) {
+    size_t total_commands = 0;
+    command **commands = parse_read_line_cached(buf, &total_commands);
+    command_result *command_result;
+    if (commands != NULL) {
+        add_history(buf);
+
+        for (size_t index = 0; index < total_commands; ++index) {
+
+            command_result = execute_command(commands[index]);
+
+            if (command_result != NULL) {
+                destroy_command_result(command_result);
+            } else {
+                destroy_command(commands[index]);
+            }
+        }
+        free(commands);
+    }
+}
+
+/** Line given by readline to `handle_line`, NULL on end of file. */
+char *read_line;
+
+/** 1 once readline gave a line to `handle_line`. */
+int is_line_read;
+
+/** Handler of the lines read by `rl_callback_read_char`, the line is executed once readline stops editing it. */
+void handle_line(char *line) {
+    rl_callback_handler_remove();
+    read_line = line;
+    is_line_read = 1;
+}
+
+/** Prints an up to date prompt, and lets `rl_callback_read_char` read the next line. */
+void install_line_handler() {
+    char *prompt_string = get_prompt_string();
+    rl_callback_handler_install(prompt_string != NULL ? prompt_string : "$ ", handle_line);
+    free(prompt_string);
+}
+
+/** Prints the jobs that changed above the line being edited, which is then redrawn with an up to date prompt. */
+void print_job_changes() {
+    acknowledge_child_events();
+    if (!have_jobs_changed()) {
+        return;
+    }
+
+    rl_clear_visible_line();
+    update_jobs();
+
+    char *prompt_string = get_prompt_string();
+    if (prompt_string != NULL) {
+        rl_set_prompt(prompt_string);
+        free(prompt_string);
+    }
+    rl_forced_update_display();
+}
+
+/**
+ * Returns an epoll instance watching the standard input, `child_events_fd` and `proc_events_fd`, -1 if the input cannot
+ * be watched, as a regular file.
+ */
+int open_prompt_events() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        return -1;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = STDIN_FILENO};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == -1) {
+        close(epoll_fd);
+        return -1;
+    }
+
+    event.data.fd = child_events_fd;
+    if (child_events_fd != -1 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, child_events_fd, &event) == -1) {
+        perror("epoll_ctl");
+    }
+
+    // Otherwise the events of every process of the system pile up in the socket while the shell is idle
+    event.data.fd = proc_events_fd;
+    if (proc_events_fd != -1 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, proc_events_fd, &event) == -1) {
+        perror("epoll_ctl");
+    }
+    return epoll_fd;
+}
+
+/**
+ * Reads a line with the callback interface of readline, printing the jobs that change meanwhile.
+ * Returns NULL on end of file.
+ */
+char *read_line_with_events(int epoll_fd) {
+    is_line_read = 0;
+    install_line_handler();
+
+    while (!is_line_read) {
+        struct epoll_event events[3];
+        int count = epoll_wait(epoll_fd, events, 3, -1);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue; // Interrupted by SIGCHLD, `child_events_fd` is readable now
+            }
+            perror("epoll_wait");
+            rl_callback_handler_remove();
+            return NULL;
+        }
+
+        for (int index = 0; index < count && !is_line_read; ++index) {
+            if (events[index].data.fd == STDIN_FILENO) {
+                rl_callback_read_char();
+            } else if (events[index].data.fd == proc_events_fd) {
+                read_proc_events();
+            } else {
+                print_job_changes();
+            }
+        }
+    }
+    return read_line;
+}
+
 void prompt() {
     rl_outstream = stderr;
 
+    // Without an input epoll can watch, jobs that changed are only printed before reading the next line
+    int epoll_fd = open_prompt_events();
+
     while (!should_exit) {
+        acknowledge_child_events();
         update_jobs();
 
-        char *prompt_string = get_prompt_string();
-        char *buf = readline(prompt_string);
+        char *buf;
+        if (epoll_fd != -1) {
+            buf = read_line_with_events(epoll_fd);
+        } else {
+            char *prompt_string = get_prompt_string();
+            buf = readline(prompt_string);
+            free(prompt_string);
+        }
 
         if (buf == NULL) {
             buf = malloc((strlen("exit") + 1) * sizeof(char));
             if (buf == NULL) {
                 perror("malloc");
-                return;
+                break;
             }
 
             memmove(buf, "exit", strlen("exit") + 1);
         }
 
-        free(prompt_string);
-
-        size_t total_commands = 0;
-        command **commands = parse_read_line(buf, &total_commands);
-        command_result *command_result;
-        if (commands != NULL) {
-            add_history(buf);
-
-            for (size_t index = 0; index < total_commands; ++index) {
-
-                command_result = execute_command(commands[index]);
-
-                if (command_result != NULL) {
-                    destroy_command_result(command_result);
-                } else {
-                    destroy_command(commands[index]);
-                }
-            }
-            free(commands);
-        }
+        execute_line(buf);
         free(buf);
     }
+
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+    }
 }
@@ -0,0 +1,125 @@
+#include "reaper.h"
+#include "proc.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Single producer, single consumer ring of child events: the reaper only moves the tail, and the shell only moves
+ * the head. Both indexes grow without bound, and are reduced modulo the capacity when indexing the ring.
+ */
+child_event child_events[CHILD_EVENT_RING_CAPACITY];
+atomic_size_t child_events_head;
+atomic_size_t child_events_tail;
+
+int child_events_fd = -1;
+int is_subreaper = 0;
+
+size_t reap_children() {
+    int saved_errno = errno;
+    size_t queued = 0;
+
+    size_t tail = atomic_load_explicit(&child_events_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&child_events_head, memory_order_acquire) < CHILD_EVENT_RING_CAPACITY) {
+        // Looked at without reaping first, a zombie still has its I/O counters in /proc
+        siginfo_t info = {0};
+        if (waitid(P_ALL, 0, &info, WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0) {
+            break;
+        }
+
+        child_event *event = &child_events[tail & (CHILD_EVENT_RING_CAPACITY - 1)];
+        memset(&event->usage, 0, sizeof(subjob_usage));
+        if (info.si_code == CLD_EXITED || info.si_code == CLD_KILLED || info.si_code == CLD_DUMPED) {
+            read_process_io(info.si_pid, &event->usage);
+        }
+
+        struct rusage usage;
+        event->pid = wait4(info.si_pid, &event->status, WNOHANG | WUNTRACED | WCONTINUED, &usage);
+        if (event->pid <= 0) {
+            break;
+        }
+        if (WIFEXITED(event->status) || WIFSIGNALED(event->status)) {
+            usage_from_rusage(&event->usage, &usage);
+        }
+
+        atomic_store_explicit(&child_events_tail, ++tail, memory_order_release);
+        queued++;
+    }
+
+    errno = saved_errno;
+    return queued;
+}
+
+int next_child_event(child_event *event) {
+    size_t head = atomic_load_explicit(&child_events_head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&child_events_tail, memory_order_acquire)) {
+        return 0;
+    }
+
+    *event = child_events[head & (CHILD_EVENT_RING_CAPACITY - 1)];
+    atomic_store_explicit(&child_events_head, head + 1, memory_order_release);
+    return 1;
+}
+
+/** Handler of SIGCHLD, the events are applied to the jobs by the shell later on. */
+void handle_child_signal(int signal) {
+    (void)signal;
+    if (reap_children() > 0 && child_events_fd != -1) {
+        int saved_errno = errno;
+        uint64_t count = 1;
+        write(child_events_fd, &count, sizeof(count)); // Only adds to its counter
+        errno = saved_errno;
+    }
+}
+
+void init_reaper() {
+    child_events_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (child_events_fd == -1) {
+        perror("eventfd"); // The prompt then only reports the changes before reading a line
+    }
+
+    char *subreaper = getenv(SUBREAPER_ENV);
+    if (subreaper != NULL && strcmp(subreaper, "1") == 0) {
+        if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1) {
+            perror("prctl"); // Orphans are then left to init, as usual
+        } else {
+            is_subreaper = 1;
+        }
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_child_signal;
+    sa.sa_flags = SA_RESTART; // Reading the command line goes on
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGCHLD, &sa, NULL) == -1) {
+        perror("sigaction");
+        exit(1);
+    }
+}
+
+void acknowledge_child_events() {
+    uint64_t count;
+    if (child_events_fd != -1) {
+        read(child_events_fd, &count, sizeof(count));
+    }
+}
+
+void block_child_signals(sigset_t *previous) {
+    sigset_t child_signals;
+    sigemptyset(&child_signals);
+    sigaddset(&child_signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &child_signals, previous);
+}
+
+void restore_child_signals(const sigset_t *previous) {
+    sigprocmask(SIG_SETMASK, previous, NULL);
+}
@@ -0,0 +1,63 @@
+#ifndef REAPER_H
+#define REAPER_H
+
+#include "usage.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Number of child events the SIGCHLD handler can queue before the shell reads them, a power of two. */
+#define CHILD_EVENT_RING_CAPACITY 1024
+
+/** A change of state of a child of the shell, as reported by wait4. */
+typedef struct child_event {
+    pid_t pid;
+    int status;         // As set by wait4
+    subjob_usage usage; // Final figures of the process, only filled once it is over
+} child_event;
+
+/**
+ * Reaps every child whose state changed, and queues the changes for `next_child_event`.
+ * The I/O counters of a child that is over are read while it is still a zombie, then it is reaped with wait4 to keep
+ * its resource usage. Stops once the queue is full, the remaining children being reaped by the next call.
+ * It is async-signal-safe, the shell calls it from its SIGCHLD handler, and with SIGCHLD blocked otherwise.
+ *
+ * Returns the number of queued events.
+ */
+size_t reap_children();
+
+/** Pops the oldest queued child event into `event`. Returns 0 if there is none. */
+int next_child_event(child_event *event);
+
+/**
+ * Event file descriptor made readable by the SIGCHLD handler whenever it queues events, for the event loop of the
+ * prompt to wait on. -1 until `init_reaper` is called.
+ */
+extern int child_events_fd;
+
+/** Environment variable making the shell a child subreaper when set to 1. */
+#define SUBREAPER_ENV "JSH_SUBREAPER"
+
+/**
+ * 1 if the shell is a child subreaper: the descendants orphaned by its jobs are reparented to it instead of init,
+ * and are then reaped like its children. The jobs keep track of them as their orphans.
+ */
+extern int is_subreaper;
+
+/**
+ * Reaps the children of the shell as soon as their state changes, from a SIGCHLD handler.
+ * Makes the shell a child subreaper if `SUBREAPER_ENV` is set to 1.
+ */
+void init_reaper();
+
+/** Makes `child_events_fd` unreadable again, before the queued events are applied. */
+void acknowledge_child_events();
+
+/** Blocks SIGCHLD, saving the previous signal mask into `previous`. */
+void block_child_signals(sigset_t *previous);
+
+/** Restores the signal mask saved by `block_child_signals`. */
+void restore_child_signals(const sigset_t *previous);
+
+#endif // REAPER_H
@@ -0,0 +1,40 @@
+#include "internals.h"
+#include "jobs.h"
+#include "launch_controls.h"
+
+#include <errno.h>
+
+int setcpus_command(command_call *command_call) {
+    if (command_call->argc != 3) {
+        dprintf(command_call->stderr, "setcpus: correct usage: setcpus LIST %%job\n");
+        return 1;
+    }
+
+    const char *cpus = command_call->argv[1];
+    if (!is_valid_cpu_list(cpus, command_call->stderr)) {
+        return 1;
+    }
+
+    job *job = get_job(command_call->argv[2], command_call->stderr);
+    if (job == NULL) {
+        return 1;
+    }
+
+    size_t count;
+    pid_t *threads = get_job_threads(job, &count);
+    if (threads == NULL) {
+        return 1;
+    }
+
+    // Threads created from now on inherit the affinity of the one creating them
+    int exit_code = 0;
+    for (size_t index = 0; index < count; ++index) {
+        if (set_cpu_list(threads[index], cpus) == -1 && errno != ESRCH) {
+            dprintf(command_call->stderr, "setcpus: %d: %s\n", threads[index], strerror(errno));
+            exit_code = 1;
+        }
+    }
+
+    free(threads);
+    return exit_code;
+}
@@ -0,0 +1,41 @@
+#include "internals.h"
+#include "jobs.h"
+#include "launch_controls.h"
+
+#include <errno.h>
+#include <sys/resource.h>
+
+int setnice_command(command_call *command_call) {
+    if (command_call->argc != 3) {
+        dprintf(command_call->stderr, "setnice: correct usage: setnice N %%job\n");
+        return 1;
+    }
+
+    int nice;
+    if (parse_nice(command_call->argv[1], &nice, command_call->stderr) == -1) {
+        return 1;
+    }
+
+    job *job = get_job(command_call->argv[2], command_call->stderr);
+    if (job == NULL) {
+        return 1;
+    }
+
+    size_t count;
+    pid_t *threads = get_job_threads(job, &count);
+    if (threads == NULL) {
+        return 1;
+    }
+
+    // On Linux the nice value belongs to each thread, not to the whole process
+    int exit_code = 0;
+    for (size_t index = 0; index < count; ++index) {
+        if (setpriority(PRIO_PROCESS, threads[index], nice) == -1 && errno != ESRCH) {
+            dprintf(command_call->stderr, "setnice: %d: %s\n", threads[index], strerror(errno));
+            exit_code = 1;
+        }
+    }
+
+    free(threads);
+    return exit_code;
+}
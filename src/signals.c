@@ -26,4 +26,18 @@ void restore_signals() {
     struct sigaction sa = {0};
     sa.sa_handler = SIG_DFL;
     set_signal_actions(&sa);
+
+    // The shell reaps its children from a SIGCHLD handler, and blocks it while launching a job
+    sigaction(SIGCHLD, &sa, NULL);
+    sigset_t child_signals;
+    sigemptyset(&child_signals);
+    sigaddset(&child_signals, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &child_signals, NULL);
+}
+
+void fill_ignored_signals(sigset_t *set) {
+    sigemptyset(set);
+    for (int i = 0; i < NB_SIGNALS_TO_IGNORE; i++) {
+        sigaddset(set, signals_to_ignore[i]);
+    }
 }
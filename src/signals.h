@@ -1,10 +1,15 @@
 #ifndef SIGNALS_H
 #define SIGNALS_H
 
+#include <signal.h>
+
 /** Sets up the sigactions to ignore the correct signals */
 void ignore_signals();
 
-/** Restores modified signals to their default behavior */
+/** Restores modified signals to their default behavior, SIGCHLD included, and unblocks SIGCHLD */
 void restore_signals();
 
+/** Fills `set` with the signals ignored by the shell */
+void fill_ignored_signals(sigset_t *set);
+
 #endif // SIGNALS_H
@@ -33,8 +33,9 @@ void destroy_string_iterator(string_iterator *iterator) {
 
 /** Returns iterator's string trimmed with its separator. */
 void trim_start(string_iterator *iterator) {
-    while (starts_with(iterator->string, iterator->separator)) {
-        iterator->string += strlen(iterator->separator);
+    size_t separator_length = strlen(iterator->separator);
+    while (strncmp(iterator->string, iterator->separator, separator_length) == 0) {
+        iterator->string += separator_length;
     }
 }
 
@@ -46,7 +47,7 @@ int starts_with(const char *string, const char *start) {
 /** Returns 0 if there are no more words in the string, 1 otherwise. */
 int has_next_word(string_iterator *iterator) {
     trim_start(iterator);
-    return strlen(iterator->string) > 0;
+    return iterator->string[0] != '\0';
 }
 
 /** Returns the next word in the string.
@@ -57,14 +58,18 @@ int has_next_word(string_iterator *iterator) {
 char *next_word(string_iterator *iterator) {
     size_t current_word_size = 0;
 
-    trim_start(iterator);
-
     if (!has_next_word(iterator)) {
         return "";
     }
 
-    while (current_word_size < strlen(iterator->string) &&
-           !starts_with(iterator->string + current_word_size, iterator->separator)) {
+    // The first character of the separator is checked before comparing the whole separator
+    size_t separator_length = strlen(iterator->separator);
+    char first = iterator->separator[0];
+    const char *string = iterator->string;
+
+    while (string[current_word_size] != '\0' &&
+           (string[current_word_size] != first ||
+            strncmp(string + current_word_size, iterator->separator, separator_length) != 0)) {
         ++current_word_size;
     }
 
@@ -87,20 +92,23 @@ char *next_word(string_iterator *iterator) {
 int get_number_of_words_left(const string_iterator *iterator) {
     unsigned int word = 0;
     unsigned int total_words = 0;
+    size_t separator_length = strlen(iterator->separator);
+    const char *string = iterator->string;
 
-    for (size_t index = 0; index < strlen(iterator->string); ++index) {
-        int is_delimiter = starts_with(iterator->string + index, iterator->separator);
+    for (size_t index = 0; string[index] != '\0'; ++index) {
+        int is_delimiter = string[index] == iterator->separator[0] &&
+                           strncmp(string + index, iterator->separator, separator_length) == 0;
         if (word) {
             if (is_delimiter) {
                 word = 0;
                 total_words += 1;
-                index += strlen(iterator->separator) - 1;
+                index += separator_length - 1;
             }
         } else {
             if (!is_delimiter) {
                 word = 1;
             } else {
-                index += strlen(iterator->separator) - 1;
+                index += separator_length - 1;
             }
         }
     }
@@ -360,3 +368,177 @@ char *repeat(const char *str, size_t n) {
     result[n * len] = '\0';
     return result;
 }
+
+// SSE2 is part of the x86-64 baseline, only AVX2 needs to be checked at runtime
+#if defined(__x86_64__)
+#define HAS_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
+/** Returns the class of a byte, without `CHAR_FD_DIGIT` which depends on the next one. */
+uint8_t byte_class(char c) {
+    switch (c) {
+        case ' ':
+            return CHAR_SPACE;
+        case '|':
+            return CHAR_PIPE;
+        case '&':
+            return CHAR_AMPERSAND;
+        case '<':
+            return CHAR_LESS;
+        case '>':
+            return CHAR_GREATER;
+        case '(':
+            return CHAR_OPEN_PARENTHESIS;
+        case ')':
+            return CHAR_CLOSE_PARENTHESIS;
+        default:
+            return 0;
+    }
+}
+
+/** Classifies the bytes of `string` starting at `start`. */
+void classify_bytes_tail(const char *string, size_t start, size_t length, uint8_t *classes) {
+    for (size_t index = start; index < length; ++index) {
+        classes[index] = byte_class(string[index]);
+        if (string[index] >= '0' && string[index] <= '9' && string[index + 1] == '>') {
+            classes[index] = CHAR_FD_DIGIT;
+        }
+    }
+}
+
+void classify_bytes_scalar(const char *string, size_t length, uint8_t *classes) {
+    classify_bytes_tail(string, 0, length, classes);
+}
+
+#ifdef HAS_X86_INTRINSICS
+
+void classify_bytes_sse2_impl(const char *string, size_t length, uint8_t *classes) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i ampersand = _mm_set1_epi8('&');
+    const __m128i less = _mm_set1_epi8('<');
+    const __m128i greater = _mm_set1_epi8('>');
+    const __m128i open = _mm_set1_epi8('(');
+    const __m128i close = _mm_set1_epi8(')');
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8('9');
+
+    size_t index = 0;
+    // The byte after the block is read as well, the null terminator guarantees it exists
+    for (; index + 16 <= length; index += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(string + index));
+        __m128i next = _mm_loadu_si128((const __m128i *)(string + index + 1));
+
+        __m128i result = _mm_and_si128(_mm_cmpeq_epi8(block, space), _mm_set1_epi8(CHAR_SPACE));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(block, pipe), _mm_set1_epi8(CHAR_PIPE)));
+        result =
+            _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(block, ampersand), _mm_set1_epi8(CHAR_AMPERSAND)));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(block, less), _mm_set1_epi8(CHAR_LESS)));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(block, greater), _mm_set1_epi8(CHAR_GREATER)));
+        result = _mm_or_si128(
+            result, _mm_and_si128(_mm_cmpeq_epi8(block, open), _mm_set1_epi8(CHAR_OPEN_PARENTHESIS)));
+        result = _mm_or_si128(
+            result, _mm_and_si128(_mm_cmpeq_epi8(block, close), _mm_set1_epi8(CHAR_CLOSE_PARENTHESIS)));
+
+        // '0' <= c <= '9' using unsigned min/max, then followed by '>'
+        __m128i digit = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(block, zero), block),
+                                      _mm_cmpeq_epi8(_mm_min_epu8(block, nine), block));
+        __m128i fd_digit = _mm_and_si128(digit, _mm_cmpeq_epi8(next, greater));
+        result = _mm_or_si128(result, _mm_and_si128(fd_digit, _mm_set1_epi8((char)CHAR_FD_DIGIT)));
+
+        _mm_storeu_si128((__m128i *)(classes + index), result);
+    }
+
+    classify_bytes_tail(string, index, length, classes);
+}
+
+__attribute__((target("avx2"))) void classify_bytes_avx2_impl(const char *string, size_t length,
+                                                               uint8_t *classes) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i ampersand = _mm256_set1_epi8('&');
+    const __m256i less = _mm256_set1_epi8('<');
+    const __m256i greater = _mm256_set1_epi8('>');
+    const __m256i open = _mm256_set1_epi8('(');
+    const __m256i close = _mm256_set1_epi8(')');
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8('9');
+
+    size_t index = 0;
+    // The byte after the block is read as well, the null terminator guarantees it exists
+    for (; index + 32 <= length; index += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(string + index));
+        __m256i next = _mm256_loadu_si256((const __m256i *)(string + index + 1));
+
+        __m256i result = _mm256_and_si256(_mm256_cmpeq_epi8(block, space), _mm256_set1_epi8(CHAR_SPACE));
+        result =
+            _mm256_or_si256(result, _mm256_and_si256(_mm256_cmpeq_epi8(block, pipe), _mm256_set1_epi8(CHAR_PIPE)));
+        result = _mm256_or_si256(
+            result, _mm256_and_si256(_mm256_cmpeq_epi8(block, ampersand), _mm256_set1_epi8(CHAR_AMPERSAND)));
+        result =
+            _mm256_or_si256(result, _mm256_and_si256(_mm256_cmpeq_epi8(block, less), _mm256_set1_epi8(CHAR_LESS)));
+        result = _mm256_or_si256(
+            result, _mm256_and_si256(_mm256_cmpeq_epi8(block, greater), _mm256_set1_epi8(CHAR_GREATER)));
+        result = _mm256_or_si256(
+            result, _mm256_and_si256(_mm256_cmpeq_epi8(block, open), _mm256_set1_epi8(CHAR_OPEN_PARENTHESIS)));
+        result = _mm256_or_si256(
+            result, _mm256_and_si256(_mm256_cmpeq_epi8(block, close), _mm256_set1_epi8(CHAR_CLOSE_PARENTHESIS)));
+
+        // '0' <= c <= '9' using unsigned min/max, then followed by '>'
+        __m256i digit = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(block, zero), block),
+                                         _mm256_cmpeq_epi8(_mm256_min_epu8(block, nine), block));
+        __m256i fd_digit = _mm256_and_si256(digit, _mm256_cmpeq_epi8(next, greater));
+        result = _mm256_or_si256(result, _mm256_and_si256(fd_digit, _mm256_set1_epi8((char)CHAR_FD_DIGIT)));
+
+        _mm256_storeu_si256((__m256i *)(classes + index), result);
+    }
+
+    classify_bytes_tail(string, index, length, classes);
+}
+
+int has_avx2() {
+    static int supported = -1;
+    if (supported == -1) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return supported;
+}
+
+void classify_bytes_sse2(const char *string, size_t length, uint8_t *classes) {
+    classify_bytes_sse2_impl(string, length, classes);
+}
+
+void classify_bytes_avx2(const char *string, size_t length, uint8_t *classes) {
+    if (has_avx2()) {
+        classify_bytes_avx2_impl(string, length, classes);
+    } else {
+        classify_bytes_sse2_impl(string, length, classes);
+    }
+}
+
+#else
+
+int has_avx2() {
+    return 0;
+}
+
+void classify_bytes_sse2(const char *string, size_t length, uint8_t *classes) {
+    classify_bytes_scalar(string, length, classes);
+}
+
+void classify_bytes_avx2(const char *string, size_t length, uint8_t *classes) {
+    classify_bytes_scalar(string, length, classes);
+}
+
+#endif // HAS_X86_INTRINSICS
+
+void classify_bytes(const char *string, size_t length, uint8_t *classes) {
+    // Short lines are not worth setting up the vector registers
+    if (length < 16) {
+        classify_bytes_scalar(string, length, classes);
+    } else {
+        classify_bytes_avx2(string, length, classes);
+    }
+}
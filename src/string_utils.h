@@ -86,4 +86,33 @@ int is_only_composed_of(const char *str, const char *pattern);
 /** Returns a repeated string. */
 char *repeat(const char *str, size_t);
 
+/** Classes of the bytes that matter to the shell grammar, a byte has at most one of them. */
+#define CHAR_SPACE 0x01
+#define CHAR_PIPE 0x02
+#define CHAR_AMPERSAND 0x04
+#define CHAR_LESS 0x08
+#define CHAR_GREATER 0x10
+#define CHAR_OPEN_PARENTHESIS 0x20
+#define CHAR_CLOSE_PARENTHESIS 0x40
+#define CHAR_FD_DIGIT 0x80 // A digit directly followed by `>`
+
+/**
+ * Stores the class of every byte of `string` in `classes`, 0 if it has none.
+ * `string` must be null terminated at index `length`.
+ * Uses the widest vector instructions supported by the processor.
+ */
+void classify_bytes(const char *string, size_t length, uint8_t *classes);
+
+/** Same as `classify_bytes`, one byte at a time. */
+void classify_bytes_scalar(const char *string, size_t length, uint8_t *classes);
+
+/** Same as `classify_bytes`, 16 bytes at a time. Falls back to the scalar version outside of x86-64. */
+void classify_bytes_sse2(const char *string, size_t length, uint8_t *classes);
+
+/** Same as `classify_bytes`, 32 bytes at a time. Falls back to the SSE2 version if AVX2 is not available. */
+void classify_bytes_avx2(const char *string, size_t length, uint8_t *classes);
+
+/** Returns 1 if the processor supports AVX2, 0 otherwise. */
+int has_avx2();
+
 #endif // STRING_UTILS_H
@@ -0,0 +1,57 @@
+#include "internals.h"
+#include "path_cache.h"
+
+#include <sys/stat.h>
+
+/** Prints how the name would be executed, returns 0 if it was found. */
+int type_name(command_call *command_call, const char *name) {
+    if (strcmp(name, TIME_KEYWORD) == 0 || strcmp(name, RUN_KEYWORD) == 0) {
+        dprintf(command_call->stdout, "%s is a shell keyword\n", name);
+        return 0;
+    }
+
+    if (is_internal_command_name(name)) {
+        dprintf(command_call->stdout, "%s is a shell builtin\n", name);
+        return 0;
+    }
+
+    if (strchr(name, '/') != NULL) {
+        struct stat file_stat;
+        if (stat(name, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && access(name, X_OK) == 0) {
+            dprintf(command_call->stdout, "%s is %s\n", name, name);
+            return 0;
+        }
+    } else {
+        path_cache_entry *entry = find_command_path(name);
+        if (entry != NULL && entry->path != NULL) {
+            dprintf(command_call->stdout, "%s is hashed (%s)\n", name, entry->path);
+            return 0;
+        }
+
+        char *path;
+        if (search_command_path(name, &path) == COMMAND_FOUND) {
+            dprintf(command_call->stdout, "%s is %s\n", name, path);
+            free(path);
+            return 0;
+        }
+    }
+
+    dprintf(command_call->stderr, "type: %s: not found\n", name);
+    return 1;
+}
+
+int type_command(command_call *command_call) {
+    if (command_call->argc == 1) {
+        dprintf(command_call->stderr, "type: missing argument\n");
+        return 1;
+    }
+
+    int exit_code = 0;
+    for (size_t index = 1; index < command_call->argc; ++index) {
+        if (type_name(command_call, command_call->argv[index]) != 0) {
+            exit_code = 1;
+        }
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,41 @@
+#include "usage.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+
+void usage_from_rusage(subjob_usage *usage, const struct rusage *rusage) {
+    usage->user_time = rusage->ru_utime;
+    usage->system_time = rusage->ru_stime;
+    usage->max_rss = rusage->ru_maxrss;
+    usage->major_faults = rusage->ru_majflt;
+    usage->context_switches = rusage->ru_nvcsw + rusage->ru_nivcsw;
+}
+
+void add_usage(subjob_usage *total, const subjob_usage *usage) {
+    timeradd(&total->user_time, &usage->user_time, &total->user_time);
+    timeradd(&total->system_time, &usage->system_time, &total->system_time);
+    if (usage->max_rss > total->max_rss) {
+        total->max_rss = usage->max_rss;
+    }
+    total->major_faults += usage->major_faults;
+    total->context_switches += usage->context_switches;
+    total->read_bytes += usage->read_bytes;
+    total->written_bytes += usage->written_bytes;
+}
+
+void print_usage_header(int fd) {
+    dprintf(fd, "\t%8s %8s %10s %8s %8s %12s %12s\n", "user", "sys", "maxrss", "majflt", "ctxsw", "read", "written");
+}
+
+void print_usage(int fd, const subjob_usage *usage, const char *label) {
+    dprintf(fd, "\t%7.3fs %7.3fs %8ldkB %8ld %8ld %12llu %12llu\t%s\n",
+            usage->user_time.tv_sec + usage->user_time.tv_usec / 1e6,
+            usage->system_time.tv_sec + usage->system_time.tv_usec / 1e6, usage->max_rss, usage->major_faults,
+            usage->context_switches, usage->read_bytes, usage->written_bytes, label);
+}
+
+double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,34 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <time.h>
+
+/** Resources used by the process of a subjob. */
+typedef struct subjob_usage {
+    struct timeval user_time;
+    struct timeval system_time;
+    long max_rss; // In kilobytes
+    long major_faults;
+    long context_switches;            // Voluntary and involuntary
+    unsigned long long read_bytes;    // `rchar` of /proc/<pid>/io, includes pipes and the page cache
+    unsigned long long written_bytes; // `wchar` of /proc/<pid>/io
+} subjob_usage;
+
+/** Fills the usage with the figures of a reaped process, keeping its I/O counters. */
+void usage_from_rusage(subjob_usage *usage, const struct rusage *rusage);
+
+/** Adds the figures of `usage` to `total`, the maximal resident set size being the largest one. */
+void add_usage(subjob_usage *total, const subjob_usage *usage);
+
+/** Prints the names of the columns printed by `print_usage`, indented by a tabulation. */
+void print_usage_header(int fd);
+
+/** Prints the usage on a single line, followed by `label`. */
+void print_usage(int fd, const subjob_usage *usage, const char *label);
+
+/** Returns the number of seconds elapsed since `start`, measured with the monotonic clock. */
+double elapsed_seconds(const struct timespec *start);
+
+#endif // USAGE_H
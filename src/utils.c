@@ -1,10 +1,15 @@
 #include "utils.h"
 #include "string_utils.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/close_range.h>
 #include <linux/limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 char *get_current_wd() {
@@ -58,18 +63,6 @@ int contains(int *set, size_t size, int value) {
     return 0;
 }
 
-int contains2(int **array, size_t size, size_t subsize, int value) {
-    for (size_t index = 0; index < size; ++index) {
-        for (size_t j = 0; j < subsize; j++) {
-
-            if (array[index][j] == value) {
-                return 1;
-            }
-        }
-    }
-    return 0;
-}
-
 char *colored(char *color, char *string) {
 
     if (color == NULL || string == NULL) {
@@ -146,3 +139,89 @@ void close_unused_file_descriptors_from_array(int *fds_to_close, size_t nb_fds_t
 
     free(set);
 }
+
+#define FD_BITMAP_WORD_BITS 64
+
+uint64_t *new_fd_bitmap(int max_fd) {
+    size_t words = max_fd / FD_BITMAP_WORD_BITS + 1;
+    uint64_t *bitmap = calloc(words, sizeof(uint64_t));
+    if (bitmap == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+    return bitmap;
+}
+
+void add_fd_bitmap(uint64_t *bitmap, int fd) {
+    bitmap[fd / FD_BITMAP_WORD_BITS] |= (uint64_t)1 << (fd % FD_BITMAP_WORD_BITS);
+}
+
+int contains_fd_bitmap(const uint64_t *bitmap, int max_fd, int fd) {
+    if (fd < 0 || fd > max_fd) {
+        return 0;
+    }
+    return (bitmap[fd / FD_BITMAP_WORD_BITS] >> (fd % FD_BITMAP_WORD_BITS)) & 1;
+}
+
+/** Closes, or marks as close-on-exec if `cloexec` is 1, every file descriptor from `first_fd` on. */
+int close_file_descriptors_from(int first_fd, int cloexec) {
+#if defined(SYS_close_range) && defined(CLOSE_RANGE_CLOEXEC)
+    if (syscall(SYS_close_range, first_fd, ~0U, cloexec ? CLOSE_RANGE_CLOEXEC : 0) == 0) {
+        return 0;
+    }
+#endif
+
+    DIR *directory = opendir("/proc/self/fd");
+    if (directory == NULL) {
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL) {
+        int fd = atoi(entry->d_name);
+        if (entry->d_name[0] == '.' || fd < first_fd || fd == dirfd(directory)) {
+            continue;
+        }
+
+        if (cloexec) {
+            fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+        } else {
+            close(fd);
+        }
+    }
+
+    closedir(directory);
+    return 0;
+}
+
+int set_cloexec_from(int first_fd) {
+    return close_file_descriptors_from(first_fd, 1);
+}
+
+int close_from(int first_fd) {
+    return close_file_descriptors_from(first_fd, 0);
+}
+
+int find_inherited_file_descriptor(const int *kept, size_t kept_count) {
+    DIR *directory = opendir("/proc/self/fd");
+    if (directory == NULL) {
+        return -1;
+    }
+
+    int inherited = -1;
+    struct dirent *entry;
+    while (inherited == -1 && (entry = readdir(directory)) != NULL) {
+        int fd = atoi(entry->d_name);
+        if (entry->d_name[0] == '.' || fd <= STDERR_FILENO || fd == dirfd(directory)) {
+            continue;
+        }
+
+        int flags = fcntl(fd, F_GETFD);
+        if (flags != -1 && !(flags & FD_CLOEXEC) && !contains((int *)kept, kept_count, fd)) {
+            inherited = fd;
+        }
+    }
+
+    closedir(directory);
+    return inherited;
+}
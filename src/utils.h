@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 /** Returns the result of 'getcwd' as it is. */
 char *get_current_wd();
@@ -20,8 +21,6 @@ int add_set(int *set, size_t size, int value);
 /** Returns 1 if the set contains the value, 0 otherwise. */
 int contains(int *set, size_t size, int value);
 
-int contains2(int **array, size_t size, size_t subsize, int value);
-
 /** Removes `value` from the set.
  * Returns 0 if `value` was properly removed, -1 otherwise.
  */
@@ -53,4 +52,28 @@ char *in_cyan(char *string);
  */
 void close_unused_file_descriptors_from_array(int *, size_t);
 
+/** Returns a bitmap of file descriptors able to hold 0 to `max_fd`, with none of them set. */
+uint64_t *new_fd_bitmap(int max_fd);
+
+/** Adds `fd` to the bitmap. */
+void add_fd_bitmap(uint64_t *bitmap, int fd);
+
+/** Returns 1 if `fd` is in the bitmap, which holds 0 to `max_fd`, 0 otherwise. */
+int contains_fd_bitmap(const uint64_t *bitmap, int max_fd, int fd);
+
+/**
+ * Marks every file descriptor from `first_fd` on as close-on-exec, with a single `close_range` when the kernel
+ * supports it, by listing `/proc/self/fd` otherwise. Returns -1 on failure.
+ */
+int set_cloexec_from(int first_fd);
+
+/** Same as `set_cloexec_from`, closing the file descriptors instead. */
+int close_from(int first_fd);
+
+/**
+ * Returns a file descriptor above stderr that would be inherited by an executed program although it is not in `kept`,
+ * -1 if there is none.
+ */
+int find_inherited_file_descriptor(const int *kept, size_t kept_count);
+
 #endif // UTILS_H
@@ -1,6 +1,6 @@
 #include "test_core.h"
 
-#define NUM_TESTS 13
+#define NUM_TESTS 22
 
 test tests[NUM_TESTS] = {test_string_utils,
                          test_utils,
@@ -14,7 +14,16 @@ test tests[NUM_TESTS] = {test_string_utils,
                          test_prompt,
                          test_background_jobs,
                          test_redirection,
-                         test_redirection_parsing};
+                         test_redirection_parsing,
+                         test_lexer,
+                         test_arena,
+                         test_parse_cache,
+                         test_launch,
+                         test_path_cache,
+                         test_file_substitution,
+                         test_array,
+                         test_proc_snapshot,
+                         test_proc_events};
 
 /** This is the main function for the test program. Every test should be
  * called from here and the results will be printed.
@@ -0,0 +1,89 @@
+#include "../src/arena.h"
+#include "test_core.h"
+#include <stdint.h>
+#include <string.h>
+
+#define NUM_TESTS 4
+
+void test_case_arena_alloc_alignment(test_info *info);
+void test_case_arena_chunk_chaining(test_info *info);
+void test_case_arena_grow_array(test_info *info);
+void test_case_arena_strndup(test_info *info);
+
+test_info *test_arena() {
+    test_case test_cases[NUM_TESTS] = {QUICK_CASE("Alignment of allocations", test_case_arena_alloc_alignment),
+                                       QUICK_CASE("Chunk chaining", test_case_arena_chunk_chaining),
+                                       QUICK_CASE("Growing arrays", test_case_arena_grow_array),
+                                       QUICK_CASE("String copies", test_case_arena_strndup)};
+
+    return cinta_run_cases("arena", test_cases, NUM_TESTS);
+}
+
+void test_case_arena_alloc_alignment(test_info *info) {
+    arena *arena = new_arena();
+    CINTA_ASSERT_NOT_NULL(arena, info);
+
+    for (size_t size = 0; size < 64; ++size) {
+        void *memory = arena_alloc(arena, size);
+        CINTA_ASSERT_NOT_NULL(memory, info);
+        CINTA_ASSERT_INT((uintptr_t)memory % _Alignof(max_align_t), 0, info);
+    }
+
+    destroy_arena(arena);
+}
+
+void test_case_arena_chunk_chaining(test_info *info) {
+    arena *arena = new_arena();
+
+    // Filling more than a chunk forces the arena to chain new ones
+    char *blocks[3 * ARENA_CHUNK_SIZE / 256];
+    for (size_t index = 0; index < 3 * ARENA_CHUNK_SIZE / 256; ++index) {
+        blocks[index] = arena_alloc(arena, 256);
+        CINTA_ASSERT_NOT_NULL(blocks[index], info);
+        memset(blocks[index], (int)index, 256);
+    }
+
+    // A big allocation does not waste the current chunk
+    arena_chunk *current = arena->chunks;
+    char *big = arena_alloc(arena, 4 * ARENA_CHUNK_SIZE);
+    CINTA_ASSERT_NOT_NULL(big, info);
+    memset(big, 0, 4 * ARENA_CHUNK_SIZE);
+    CINTA_ASSERT_PTR(arena->chunks, ==, current, info);
+
+    for (size_t index = 0; index < 3 * ARENA_CHUNK_SIZE / 256; ++index) {
+        CINTA_ASSERT_INT(blocks[index][0], (char)index, info);
+        CINTA_ASSERT_INT(blocks[index][255], (char)index, info);
+    }
+
+    destroy_arena(arena);
+}
+
+void test_case_arena_grow_array(test_info *info) {
+    arena *arena = new_arena();
+
+    int *array = NULL;
+    for (size_t count = 0; count < 1000; ++count) {
+        array = arena_grow_array(arena, array, count, sizeof(int));
+        CINTA_ASSERT_NOT_NULL(array, info);
+        array[count] = (int)count;
+    }
+
+    for (size_t index = 0; index < 1000; ++index) {
+        CINTA_ASSERT_INT(array[index], (int)index, info);
+    }
+
+    // There is still room, nothing is copied
+    CINTA_ASSERT_PTR(arena_grow_array(arena, array, 1000, sizeof(int)), ==, array, info);
+
+    destroy_arena(arena);
+}
+
+void test_case_arena_strndup(test_info *info) {
+    arena *arena = new_arena();
+
+    CINTA_ASSERT_STRING(arena_strndup(arena, "echo hello", 4), "echo", info);
+    CINTA_ASSERT_STRING(arena_strdup(arena, "echo hello"), "echo hello", info);
+    CINTA_ASSERT_STRING(arena_strdup(arena, ""), "", info);
+
+    destroy_arena(arena);
+}
@@ -0,0 +1,94 @@
+#include "../src/array.h"
+#include "../src/command.h"
+#include "../src/jobs.h"
+#include "test_core.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#define NUM_TEST 3
+
+void test_case_parse_array_size(test_info *info);
+void test_case_array_throttles_instances(test_info *info);
+void test_case_array_counts_failures(test_info *info);
+
+test_info *test_array() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("Parsing the size of an array", test_case_parse_array_size),
+        QUICK_CASE("Instances are launched as the others finish", test_case_array_throttles_instances),
+        QUICK_CASE("Failed instances fail the array", test_case_array_counts_failures)};
+
+    test_info *info = cinta_run_cases("array", cases, NUM_TEST);
+
+    init_job_table();
+    return info;
+}
+
+void test_case_parse_array_size(test_info *info) {
+    size_t count;
+    size_t limit;
+    CINTA_ASSERT_INT(0, parse_array_size("8", &count, &limit, STDERR_FILENO), info);
+    CINTA_ASSERT_INT(8, count, info);
+    CINTA_ASSERT_INT(8, limit, info);
+
+    CINTA_ASSERT_INT(0, parse_array_size("100%4", &count, &limit, STDERR_FILENO), info);
+    CINTA_ASSERT_INT(100, count, info);
+    CINTA_ASSERT_INT(4, limit, info);
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    const char *invalid[] = {"", "0", "-3", "4%", "4%0", "%4", "4%2x", "four"};
+    for (size_t index = 0; index < sizeof(invalid) / sizeof(invalid[0]); ++index) {
+        CINTA_ASSERT_INT(-1, parse_array_size(invalid[index], &count, &limit, null_fd), info);
+    }
+    close(null_fd);
+}
+
+void test_case_array_throttles_instances(test_info *info) {
+    init_job_table();
+
+    // The index of an array running the shell, which the instances do not inherit and the shell keeps
+    setenv(ARRAY_TASK_ID_ENV, "7", 1);
+    char *shell_task_id = getenv(ARRAY_TASK_ID_ENV);
+
+    command *command = parse_command("array 3%1 printenv " ARRAY_TASK_ID_ENV " >| tmp/test_array_throttles.log");
+    command->background = 1;
+    command_result *result = mute_command_execution(command);
+    CINTA_ASSERT_INT(0, result->exit_code, info);
+    destroy_command_result(result);
+
+    job *job = job_table[0];
+    CINTA_ASSERT_INT(1, job->array->launched, info);
+    CINTA_ASSERT_NULL(job->subjobs[1], info);
+
+    CINTA_ASSERT_INT(0, blocking_wait_for_job(job), info);
+    CINTA_ASSERT_INT(3, job->array->launched, info);
+    CINTA_ASSERT_INT(DONE, job->status, info);
+    CINTA_ASSERT_PTR(shell_task_id, ==, getenv(ARRAY_TASK_ID_ENV), info);
+    CINTA_ASSERT_STRING("7", getenv(ARRAY_TASK_ID_ENV), info);
+    unsetenv(ARRAY_TASK_ID_ENV);
+
+    // A single instance runs at once, in the order of their ids
+    int read_fd = open_test_file_to_read("test_array_throttles.log");
+    char buffer[32] = "";
+    read(read_fd, buffer, sizeof(buffer) - 1);
+    close(read_fd);
+    CINTA_ASSERT_STRING("1\n2\n3\n", buffer, info);
+
+    init_job_table();
+}
+
+void test_case_array_counts_failures(test_info *info) {
+    init_job_table();
+
+    command *command = parse_command("array 4%3 false");
+    command->background = 1;
+    command_result *result = mute_command_execution(command);
+    destroy_command_result(result);
+
+    job *job = job_table[0];
+    CINTA_ASSERT_INT(1, blocking_wait_for_job(job), info);
+    CINTA_ASSERT_INT(4, job->array->failed, info);
+
+    init_job_table();
+}
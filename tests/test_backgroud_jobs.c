@@ -3,14 +3,17 @@
 #include "test_core.h"
 #include "utils.h"
 
-#define NUM_TEST 2
+#define NUM_TEST 3
 
 void test_launching_one_bg_job(test_info *);
 void test_launching_multiple_bg_jobs(test_info *);
+void test_builtin_writing_more_than_a_pipe_holds(test_info *);
 
 test_info *test_background_jobs() {
     test_case cases[NUM_TEST] = {QUICK_CASE("Testing launching one background job", test_launching_one_bg_job),
-                          QUICK_CASE("Testing launching multiple background jobs", test_launching_multiple_bg_jobs)};
+                          QUICK_CASE("Testing launching multiple background jobs", test_launching_multiple_bg_jobs),
+                          QUICK_CASE("Testing a builtin writing more than a pipe holds",
+                                     test_builtin_writing_more_than_a_pipe_holds)};
     return cinta_run_cases("test", cases, NUM_TEST);
 }
 
@@ -54,3 +57,29 @@ void test_launching_multiple_bg_jobs(test_info *info) {
         destroy_command_result(result);
     }
 }
+
+void test_builtin_writing_more_than_a_pipe_holds(test_info *info) {
+    init_job_table();
+
+    // About 60 bytes per line, so that `jobs` writes more than a pipe holds
+    command *template = parse_command("sleep 1000000000000000000000000000000000000000");
+    for (int i = 0; i < 2000; i++) {
+        add_job(job_from_command(template, INT_MAX - i, RUNNING));
+    }
+    destroy_command(template);
+
+    command *command = parse_command("jobs | wc -c >| tmp/test_builtin_writing_more_than_a_pipe_holds.log");
+    command->background = 1;
+    command_result *result = mute_command_execution(command);
+    blocking_wait_for_job(job_table[result->job_id - 1]);
+    destroy_command_result(result);
+
+    int read_fd = open_test_file_to_read("test_builtin_writing_more_than_a_pipe_holds.log");
+    char buffer[32] = "";
+    read(read_fd, buffer, sizeof(buffer) - 1);
+    close(read_fd);
+
+    CINTA_ASSERT(atoi(buffer) > 65536, info);
+
+    init_job_table();
+}
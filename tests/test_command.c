@@ -6,9 +6,9 @@
 #include <strings.h>
 #include <unistd.h>
 
-#define NUM_TEST 14
+#define NUM_TEST 17
 
-void test_destroy_command_call_null(test_info *info);
+void test_destroy_command_null(test_info *info);
 void test_destroy_command_result_null(test_info *info);
 void test_no_arguments_command_call_print(test_info *info);
 void test_command_call_print_with_arguments(test_info *info);
@@ -22,11 +22,14 @@ void test_complex_background_parsing_no_args_no_spaces(test_info *info);
 void test_complex_background_parsing_args_spaces(test_info *info);
 void test_complex_background_parsing_args_no_spaces(test_info *info);
 void test_complex_full_background_parsing_args_spaces(test_info *info);
+void test_deep_command_parsing(test_info *info);
+void test_time_keyword_parsing(test_info *info);
+void test_run_keyword_parsing(test_info *info);
 
 test_info *test_command() {
 
     test_case cases[NUM_TEST] = {
-        QUICK_CASE("Testing `destroy_command_call` with NULL", test_destroy_command_call_null),
+        QUICK_CASE("Testing `destroy_command` with NULL", test_destroy_command_null),
         QUICK_CASE("Testing `destroy_command_result` with NULL", test_destroy_command_result_null),
         QUICK_CASE("Testing command print with no arguments", test_no_arguments_command_call_print),
         QUICK_CASE("Testing command print with arguments", test_command_call_print_with_arguments),
@@ -39,12 +42,15 @@ test_info *test_command() {
         QUICK_CASE("& Parsing | a & b - No args - No spaces", test_complex_background_parsing_no_args_no_spaces),
         QUICK_CASE("& Parsing | a & b - With args - With spaces", test_complex_background_parsing_args_spaces),
         QUICK_CASE("& Parsing | a & b & - With args - No spaces", test_complex_background_parsing_args_no_spaces),
-        QUICK_CASE("& Parsing | a & b - With args - With spaces", test_complex_full_background_parsing_args_spaces)};
+        QUICK_CASE("& Parsing | a & b - With args - With spaces", test_complex_full_background_parsing_args_spaces),
+        QUICK_CASE("Parsing deep pipelines and substitutions", test_deep_command_parsing),
+        QUICK_CASE("Parsing the time keyword", test_time_keyword_parsing),
+        QUICK_CASE("Parsing the run keyword and its options", test_run_keyword_parsing)};
     return cinta_run_cases("command", cases, NUM_TEST);
 }
 
-void test_destroy_command_call_null(test_info *info) {
-    destroy_command_call(NULL);
+void test_destroy_command_null(test_info *info) {
+    destroy_command(NULL);
     CINTA_ASSERT(1, info);
 }
 
@@ -358,3 +364,103 @@ void test_complex_full_background_parsing_args_spaces(test_info *info) {
     destroy_command(commands[1]);
     free(commands);
 }
+
+/** Parses the templates of a line made of `count` times `open`, then `middle`, then `count` times `close`. */
+command **parse_repeated_templates(size_t count, const char *open, const char *middle, const char *close,
+                                  size_t *total) {
+    size_t length = count * (strlen(open) + strlen(close)) + strlen(middle);
+    char *line = malloc(length + 1);
+    char *end = line;
+    for (size_t index = 0; index < count; ++index) {
+        end = stpcpy(end, open);
+    }
+    end = stpcpy(end, middle);
+    for (size_t index = 0; index < count; ++index) {
+        end = stpcpy(end, close);
+    }
+
+    int dropped_last;
+    int reported_error;
+    command **commands = parse_read_line_templates(line, total, &dropped_last, &reported_error);
+    free(line);
+    return commands;
+}
+
+void test_deep_command_parsing(test_info *info) {
+    size_t total;
+
+    // Parsing does not recurse, so the depth of the input is not bounded by the C stack
+    command **commands = parse_repeated_templates(100000, "cat | ", "cat", "", &total);
+    CINTA_ASSERT_INT(1, commands != NULL, info);
+    CINTA_ASSERT_INT(100001, commands[0]->command_call_count, info);
+    CINTA_ASSERT_INT(100000, commands[0]->open_pipes_size, info);
+    CINTA_ASSERT_STRING("cat", commands[0]->command_calls[0]->command_string, info);
+    destroy_command(commands[0]);
+    free(commands);
+
+    commands = parse_repeated_templates(2000, "cat <( ", "echo", " )", &total);
+    CINTA_ASSERT_INT(1, commands != NULL, info);
+    CINTA_ASSERT_INT(2001, commands[0]->command_call_count, info);
+    CINTA_ASSERT_INT(2000, commands[0]->open_pipes_size, info);
+    CINTA_ASSERT_STRING("echo", commands[0]->command_calls[1]->command_string, info);
+    destroy_command(commands[0]);
+    free(commands);
+
+    commands = parse_repeated_templates(2000, "cat <( ", "echo", "", &total);
+    CINTA_ASSERT_NULL(commands, info);
+}
+
+void test_time_keyword_parsing(test_info *info) {
+    command *command = parse_command("time seq 3 | wc -l");
+    CINTA_ASSERT_INT(1, command->timed, info);
+    CINTA_ASSERT_INT(2, command->command_call_count, info);
+    CINTA_ASSERT_STRING("time seq 3 | wc -l", command->command_string, info);
+    CINTA_ASSERT_STRING("wc", command->command_calls[0]->name, info);
+    CINTA_ASSERT_STRING("seq", command->command_calls[1]->name, info);
+    destroy_command(command);
+
+    // Alone, or anywhere else than at the start, it is a regular word
+    command = parse_command("time");
+    CINTA_ASSERT_INT(0, command->timed, info);
+    CINTA_ASSERT_STRING("time", command->command_calls[0]->name, info);
+    destroy_command(command);
+
+    command = parse_command("echo time");
+    CINTA_ASSERT_INT(0, command->timed, info);
+    destroy_command(command);
+}
+
+void test_run_keyword_parsing(test_info *info) {
+    command *template = parse_command("run --nice 10 --cpus 0,2-3 --rlimit as=2G --rlimit nofile=64 -- cat | wc -l");
+    command *command = copy_command(template);
+    destroy_command(template);
+    CINTA_ASSERT_INT(2, command->command_call_count, info);
+    CINTA_ASSERT_STRING("cat", command->command_calls[1]->name, info);
+    CINTA_ASSERT_INT(1, command->controls.set_nice, info);
+    CINTA_ASSERT_INT(10, command->controls.nice, info);
+    CINTA_ASSERT_STRING("0,2-3", command->controls.cpus, info);
+    CINTA_ASSERT_INT(2, command->controls.rlimit_count, info);
+    CINTA_ASSERT_INT(RLIMIT_AS, command->controls.rlimits[0].resource, info);
+    CINTA_ASSERT(command->controls.rlimits[0].value == 2UL << 30, info);
+    CINTA_ASSERT_INT(RLIMIT_NOFILE, command->controls.rlimits[1].resource, info);
+    CINTA_ASSERT(command->controls.rlimits[1].value == 64, info);
+    destroy_command(command);
+
+    // `--` is only needed when the command itself starts with a dash
+    command = parse_command("time run --rlimit core=unlimited seq 3");
+    CINTA_ASSERT_INT(1, command->timed, info);
+    CINTA_ASSERT_STRING("seq", command->command_calls[0]->name, info);
+    CINTA_ASSERT(command->controls.rlimits[0].value == RLIM_INFINITY, info);
+    CINTA_ASSERT_INT(0, command->controls.set_nice, info);
+    destroy_command(command);
+
+    command = parse_command("run");
+    CINTA_ASSERT_STRING("run", command->command_calls[0]->name, info);
+    CINTA_ASSERT_INT(0, has_launch_controls(&command->controls), info);
+    destroy_command(command);
+
+    CINTA_ASSERT_NULL(parse_command("run --nice 20 -- true"), info);
+    CINTA_ASSERT_NULL(parse_command("run --cpus 3-1 true"), info);
+    CINTA_ASSERT_NULL(parse_command("run --rlimit stack=1X true"), info);
+    CINTA_ASSERT_NULL(parse_command("run --nice 5 --"), info);
+}
@@ -41,5 +41,14 @@ test_info *test_background_jobs();
 test_info *test_running_jobs();
 test_info *test_redirection();
 test_info *test_redirection_parsing();
+test_info *test_lexer();
+test_info *test_arena();
+test_info *test_parse_cache();
+test_info *test_launch();
+test_info *test_path_cache();
+test_info *test_file_substitution();
+test_info *test_array();
+test_info *test_proc_snapshot();
+test_info *test_proc_events();
 
 #endif // TEST_CORE_H
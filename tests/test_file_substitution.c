@@ -0,0 +1,56 @@
+#include "../src/command.h"
+#include "../src/file_substitution.h"
+#include "../src/jobs.h"
+#include "test_core.h"
+#include "utils.h"
+
+#define NUM_TEST 2
+
+void test_case_file_substitution_phases(test_info *info);
+void test_case_file_substitution_is_a_file(test_info *info);
+
+test_info *test_file_substitution() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("Producers run one phase before their reader", test_case_file_substitution_phases),
+        QUICK_CASE("The reader gets a complete file", test_case_file_substitution_is_a_file)};
+
+    return cinta_run_cases("file substitution", cases, NUM_TEST);
+}
+
+void test_case_file_substitution_phases(test_info *info) {
+    command *command = parse_command("cat =( a =( b ) | c <( d ) ) <( e )");
+    CINTA_ASSERT_INT(6, command->command_call_count, info);
+
+    size_t phase_count;
+    int *phases = file_substitution_phases(command, &phase_count);
+    CINTA_ASSERT_INT(3, phase_count, info);
+
+    // The last call of the main pipeline comes first, then the others from the end of the source: e, d, c, b, a
+    int expected[] = {0, 0, 1, 1, 2, 1};
+    for (size_t index = 0; index < command->command_call_count; ++index) {
+        CINTA_ASSERT_INT(expected[index], phases[index], info);
+    }
+
+    free(phases);
+    destroy_command(command);
+}
+
+void test_case_file_substitution_is_a_file(test_info *info) {
+    init_job_table();
+
+    // A pipe would have a size of 0
+    command *command = parse_command("stat -L -c %s =( echo hello ) >| tmp/test_file_substitution_is_a_file.log");
+    command->background = 1;
+    command_result *result = mute_command_execution(command);
+    blocking_wait_for_job(job_table[result->job_id - 1]);
+    destroy_command_result(result);
+
+    int read_fd = open_test_file_to_read("test_file_substitution_is_a_file.log");
+    char buffer[32] = "";
+    read(read_fd, buffer, sizeof(buffer) - 1);
+    close(read_fd);
+
+    CINTA_ASSERT_STRING("6\n", buffer, info);
+
+    init_job_table();
+}
@@ -1,16 +1,20 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "../src/internals.h"
 #include "../src/jobs.h"
+#include "../src/reaper.h"
 #include "test_core.h"
 #include "utils.h"
 
-#define NUM_TEST 18
+#define NUM_TEST 23
 
 void test_case_new_job(test_info *);
 
@@ -33,9 +37,14 @@ void remove_job_2_with_3_jobs(test_info *);
 
 void test_case_add_job_fills_null_position(test_info *);
 void test_case_filling_job_table_after_deleting_it(test_info *);
+void test_case_add_job_reuses_smallest_ids(test_info *);
 
 void test_jobs_command_without_jobs_running(test_info *);
 void test_jobs_command_with_jobs_running(test_info *);
+void test_reaping_keeps_resource_usage(test_info *);
+void test_subjobs_indexed_by_pid(test_info *);
+void test_reaped_children_are_queued(test_info *);
+void test_reaper_wakes_up_the_prompt(test_info *);
 
 test_info *test_jobs() {
 
@@ -57,8 +66,13 @@ test_info *test_jobs() {
         QUICK_CASE("Testing add_job - Fills NULL position", test_case_add_job_fills_null_position),
         QUICK_CASE("Testing add_job - Filling job table after deleting it",
                    test_case_filling_job_table_after_deleting_it),
+        QUICK_CASE("Testing add_job - Reuses the smallest ids first", test_case_add_job_reuses_smallest_ids),
         QUICK_CASE("Testing jobs command - without jobs running", test_jobs_command_without_jobs_running),
-        SLOW_CASE("Testing jobs command - with jobs running", test_jobs_command_with_jobs_running)};
+        SLOW_CASE("Testing jobs command - with jobs running", test_jobs_command_with_jobs_running),
+        QUICK_CASE("Testing reaping keeps the resource usage", test_reaping_keeps_resource_usage),
+        QUICK_CASE("Testing subjobs are indexed by pid", test_subjobs_indexed_by_pid),
+        QUICK_CASE("Testing reaped children are queued", test_reaped_children_are_queued),
+        QUICK_CASE("Testing the reaper wakes up the prompt", test_reaper_wakes_up_the_prompt)};
 
     test_info *info = cinta_run_cases("jobs", cases, NUM_TEST);
 
@@ -189,7 +203,7 @@ void test_case_expands_twice_job_table(test_info *info) {
     }
 
     CINTA_ASSERT_INT(job_table_size, 2 * INITIAL_JOB_TABLE_CAPACITY + 1, info);
-    CINTA_ASSERT_INT(job_table_capacity, 3 * INITIAL_JOB_TABLE_CAPACITY, info);
+    CINTA_ASSERT_INT(job_table_capacity, 4 * INITIAL_JOB_TABLE_CAPACITY, info);
 
     for (size_t i = 0; i < 2 * INITIAL_JOB_TABLE_CAPACITY + 1; i++) {
         ASSERT_JOB(jobs[i], job_table[i], info);
@@ -347,8 +361,9 @@ void test_empty_job_table_with_remove_job(test_info *info) {
         remove_job(i + 1);
     }
 
+    // The table shrinks back once it is empty
     CINTA_ASSERT_INT(job_table_size, 0, info);
-    CINTA_ASSERT_INT(job_table_capacity, INITIAL_JOB_TABLE_CAPACITY * 2, info);
+    CINTA_ASSERT_INT(job_table_capacity, INITIAL_JOB_TABLE_CAPACITY, info);
 
     init_job_table();
 }
@@ -462,6 +477,33 @@ void test_case_filling_job_table_after_deleting_it(test_info *info) {
     init_job_table();
 }
 
+void test_case_add_job_reuses_smallest_ids(test_info *info) {
+    init_job_table();
+
+    command *command = parse_command("pwd");
+    for (size_t i = 0; i < 6; i++) {
+        add_job(job_from_command(command, 100 + i, RUNNING));
+    }
+
+    remove_job(5);
+    remove_job(2);
+    remove_job(4);
+    CINTA_ASSERT_INT(3, job_table_size, info);
+
+    CINTA_ASSERT_INT(2, add_job(job_from_command(command, 110, RUNNING)), info);
+    CINTA_ASSERT_INT(4, add_job(job_from_command(command, 111, RUNNING)), info);
+    CINTA_ASSERT_INT(5, add_job(job_from_command(command, 112, RUNNING)), info);
+    CINTA_ASSERT_INT(7, add_job(job_from_command(command, 113, RUNNING)), info);
+    CINTA_ASSERT_INT(7, job_table_size, info);
+
+    for (size_t id = 1; id <= 7; id++) {
+        CINTA_ASSERT_INT(id, job_table[id - 1]->id, info);
+    }
+
+    destroy_command(command);
+    init_job_table();
+}
+
 void test_jobs_command_without_jobs_running(test_info *info) {
     init_job_table();
 
@@ -553,3 +595,104 @@ void test_jobs_command_with_jobs_running(test_info *info) {
 
     init_job_table();
 }
+
+void test_reaping_keeps_resource_usage(test_info *info) {
+    init_job_table();
+
+    command *command = parse_command("seq 1 1000 >| tmp/test_reaping_keeps_resource_usage.log");
+    command->background = 1;
+    command_result *result = mute_command_execution(command);
+    job *job = job_table[result->job_id - 1];
+
+    CINTA_ASSERT_INT(0, job->subjobs[0]->reaped, info);
+    blocking_wait_for_job(job);
+
+    // The output of `seq 1 1000` is 3893 bytes long, written before the process was reaped
+    subjob_usage usage = get_subjob_usage(job->subjobs[0]);
+    CINTA_ASSERT_INT(1, job->subjobs[0]->reaped, info);
+    CINTA_ASSERT_INT(3893, usage.written_bytes, info);
+    CINTA_ASSERT(usage.max_rss > 0, info);
+
+    destroy_command_result(result);
+    init_job_table();
+}
+
+void test_subjobs_indexed_by_pid(test_info *info) {
+    command *command = parse_command("sleep 1");
+    size_t count = 200; // More than the initial number of buckets, the index has to grow
+    job *job = new_job(count, command->command_string);
+    for (size_t i = 0; i < count; i++) {
+        subjob *subjob = new_subjob(command->command_calls[0], 4000000 + i, RUNNING);
+        CINTA_ASSERT_INT(0, add_subjob(job, i, subjob), info);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        CINTA_ASSERT_PTR(find_subjob(4000000 + i), ==, job->subjobs[i], info);
+        CINTA_ASSERT_PTR(job->subjobs[i]->job, ==, job, info);
+    }
+    CINTA_ASSERT_NULL(find_subjob(4000000 + count), info);
+
+    destroy_job(job);
+    for (size_t i = 0; i < count; i++) {
+        CINTA_ASSERT_NULL(find_subjob(4000000 + i), info);
+    }
+    destroy_command(command);
+}
+
+void test_reaped_children_are_queued(test_info *info) {
+    apply_child_events(); // Children left by the other tests
+
+    pid_t pids[3];
+    for (int i = 0; i < 3; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            _exit(i + 1);
+        }
+    }
+
+    // Only looked at, so that they are still there for the reaper
+    for (int i = 0; i < 3; i++) {
+        siginfo_t status;
+        waitid(P_PID, pids[i], &status, WEXITED | WNOWAIT);
+    }
+    CINTA_ASSERT(reap_children() >= 3, info);
+
+    int found = 0;
+    child_event event;
+    while (next_child_event(&event)) {
+        for (int i = 0; i < 3; i++) {
+            if (event.pid == pids[i]) {
+                CINTA_ASSERT(WIFEXITED(event.status), info);
+                CINTA_ASSERT_INT(i + 1, WEXITSTATUS(event.status), info);
+                found++;
+            }
+        }
+    }
+    CINTA_ASSERT_INT(3, found, info);
+    CINTA_ASSERT_INT(0, next_child_event(&event), info);
+}
+
+void test_reaper_wakes_up_the_prompt(test_info *info) {
+    apply_child_events(); // Children left by the other tests
+    init_reaper();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+
+    struct pollfd events = {.fd = child_events_fd, .events = POLLIN};
+    int ready;
+    while ((ready = poll(&events, 1, 1000)) == -1 && errno == EINTR) {
+    }
+    CINTA_ASSERT_INT(1, ready, info);
+
+    acknowledge_child_events();
+    CINTA_ASSERT_INT(0, poll(&events, 1, 0), info);
+
+    // The other tests reap their children themselves
+    signal(SIGCHLD, SIG_DFL);
+    apply_child_events();
+    close(child_events_fd);
+    child_events_fd = -1;
+}
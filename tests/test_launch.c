@@ -0,0 +1,191 @@
+#include "../src/command.h"
+#include "../src/launch.h"
+#include "../src/path_cache.h"
+#include "test_core.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NUM_TEST 4
+
+void test_case_fork_barrier(test_info *info);
+void test_case_spawn_process_group(test_info *info);
+void test_case_spawn_keeps_substitutions(test_info *info);
+void test_case_missing_command_is_forked(test_info *info);
+
+test_info *test_launch() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("Forked stages wait for the barrier", test_case_fork_barrier),
+        QUICK_CASE("Spawned stages join the process group", test_case_spawn_process_group),
+        QUICK_CASE("Spawned commands only keep their substitutions", test_case_spawn_keeps_substitutions),
+        QUICK_CASE("Commands cached as missing are reported by a forked child", test_case_missing_command_is_forked)};
+
+    return cinta_run_cases("launch", cases, NUM_TEST);
+}
+
+void test_case_fork_barrier(test_info *info) {
+    command *command = parse_command("true | true");
+    command->background = 1;
+
+    launch_barrier barrier;
+    CINTA_ASSERT_INT(0, open_launch_barrier(&barrier), info);
+
+    pid_t first = fork_command_call(command, command->command_calls[0], 0, &barrier);
+    pid_t second = fork_command_call(command, command->command_calls[1], first, &barrier);
+
+    // The group exists as soon as the stages are forked, and nothing runs before the release
+    CINTA_ASSERT_INT(first, getpgid(first), info);
+    CINTA_ASSERT_INT(first, getpgid(second), info);
+    CINTA_ASSERT_INT(0, waitpid(first, NULL, WNOHANG), info);
+    CINTA_ASSERT_INT(0, waitpid(second, NULL, WNOHANG), info);
+
+    release_launch_barrier(&barrier);
+    for (size_t i = 0; i < command->open_pipes_size; i++) {
+        close(command->open_pipes[i][0]);
+        close(command->open_pipes[i][1]);
+    }
+
+    int status;
+    CINTA_ASSERT_INT(first, waitpid(first, &status, 0), info);
+    CINTA_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, info);
+    CINTA_ASSERT_INT(second, waitpid(second, &status, 0), info);
+    CINTA_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, info);
+
+    destroy_command(command);
+}
+
+/** Closes both ends of the pipes of the command in the shell. */
+void close_launch_pipes(command *command) {
+    for (size_t i = 0; i < command->open_pipes_size; i++) {
+        close(command->open_pipes[i][0]);
+        close(command->open_pipes[i][1]);
+    }
+}
+
+/** Opens the test file `name` to write, close-on-exec and numbered from 100 like the descriptors of the shell. */
+int open_launch_output(const char *name) {
+    int fd = open_test_file_to_write(name);
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, 100);
+    close(fd);
+    return moved;
+}
+
+/** Reads the test file `name` into `content`, which is always null-terminated. */
+void read_launch_output(const char *name, char *content, size_t size) {
+    int fd = open_test_file_to_read(name);
+    ssize_t length = read(fd, content, size - 1);
+    content[length < 0 ? 0 : length] = '\0';
+    close(fd);
+}
+
+void test_case_spawn_process_group(test_info *info) {
+    command *command = parse_command("sleep 10 | sleep 10");
+    command->background = 1;
+
+    pid_t first = spawn_command_call(command, command->command_calls[0], 0);
+    pid_t second = spawn_command_call(command, command->command_calls[1], first);
+    CINTA_ASSERT(first > 0 && second > 0, info);
+
+    // posix_spawn only returns once the child executed the command, in the group it was asked for
+    CINTA_ASSERT_INT(first, getpgid(first), info);
+    CINTA_ASSERT_INT(first, getpgid(second), info);
+
+    close_launch_pipes(command);
+    kill(-first, SIGKILL);
+    CINTA_ASSERT_INT(first, waitpid(first, NULL, 0), info);
+    CINTA_ASSERT_INT(second, waitpid(second, NULL, 0), info);
+
+    destroy_command(command);
+}
+
+void test_case_spawn_keeps_substitutions(test_info *info) {
+    command *command = parse_command("ls /proc/self/fd <( true )");
+    command->background = 1;
+
+    command_call *reader = command->command_calls[0];
+    for (size_t i = 0; i < command->command_call_count; i++) {
+        if (strcmp(command->command_calls[i]->name, "ls") == 0) {
+            reader = command->command_calls[i];
+        }
+    }
+    CINTA_ASSERT_STRING("ls", reader->name, info);
+    CINTA_ASSERT_INT(1, (int)command->open_pipes_size, info);
+
+    // Only the listing is run, the substitution stays empty
+    int output = open_launch_output("test_spawn_keeps_substitutions.log");
+    reader->stdout = output;
+    pid_t pid = spawn_command_call(command, reader, 0);
+    CINTA_ASSERT(pid > 0, info);
+
+    int status;
+    CINTA_ASSERT_INT(pid, waitpid(pid, &status, 0), info);
+    CINTA_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, info);
+    close(output);
+
+    char content[4096];
+    read_launch_output("test_spawn_keeps_substitutions.log", content, sizeof(content));
+
+    // The reading end of the substitution is open, the output of the shell is not, ls using the lowest free ones
+    char expected[64];
+    snprintf(expected, sizeof(expected), "/dev/fd/%d\n", command->open_pipes[0][0]);
+    CINTA_ASSERT(strstr(content, expected) != NULL, info);
+    snprintf(expected, sizeof(expected), "\n%d\n", command->open_pipes[0][0]);
+    CINTA_ASSERT(strstr(content, expected) != NULL, info);
+    snprintf(expected, sizeof(expected), "\n%d\n", output);
+    CINTA_ASSERT(strstr(content, expected) == NULL, info);
+
+    close_launch_pipes(command);
+    destroy_command(command);
+}
+
+void test_case_missing_command_is_forked(test_info *info) {
+    char directory[] = "/tmp/jsh_launch_XXXXXX";
+    CINTA_ASSERT(mkdtemp(directory) != NULL, info);
+    char *old_path = strdup(getenv("PATH"));
+    setenv("PATH", directory, 1);
+
+    command *command = parse_command("jsh_missing_tool");
+    command->background = 1;
+    command_call *call = command->command_calls[0];
+    int errors = open_launch_output("test_missing_command_is_forked.log");
+    call->stderr = errors;
+
+    const char *path;
+    CINTA_ASSERT_INT(COMMAND_MISSING, resolve_command_path("jsh_missing_tool", &path), info);
+    path_cache_entry *entry = find_command_path("jsh_missing_tool");
+    if (command_paths.inotify_fd != -1) {
+        CINTA_ASSERT(entry != NULL && entry->path == NULL, info);
+    }
+
+    // Nothing is spawned for a command known to be missing, the forked child reports it
+    CINTA_ASSERT_INT(-1, spawn_command_call(command, call, 0), info);
+
+    launch_barrier barrier;
+    CINTA_ASSERT_INT(0, open_launch_barrier(&barrier), info);
+    launch_backend previous_backend = current_launch_backend;
+    current_launch_backend = LAUNCH_SPAWN;
+    pid_t pid = launch_command_call(command, call, 0, &barrier);
+    current_launch_backend = previous_backend;
+    CINTA_ASSERT(pid > 0, info);
+    release_launch_barrier(&barrier);
+
+    int status;
+    CINTA_ASSERT_INT(pid, waitpid(pid, &status, 0), info);
+    CINTA_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 1, info);
+    close(errors);
+
+    char content[256];
+    read_launch_output("test_missing_command_is_forked.log", content, sizeof(content));
+    CINTA_ASSERT_STRING("jsh: jsh_missing_tool: No such file or directory\n", content, info);
+
+    destroy_command(command);
+    destroy_path_cache();
+    setenv("PATH", old_path, 1);
+    free(old_path);
+    rmdir(directory);
+}
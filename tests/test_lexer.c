@@ -0,0 +1,131 @@
+#include "../src/lexer.h"
+#include "test_core.h"
+#include <stdlib.h>
+
+#define NUM_TESTS 5
+
+void test_case_tokenize_words(test_info *info);
+void test_case_tokenize_operators(test_info *info);
+void test_case_tokenize_file_substitutions(test_info *info);
+void test_case_tokenize_background(test_info *info);
+void test_case_tokenize_empty(test_info *info);
+
+test_info *test_lexer() {
+    test_case test_cases[NUM_TESTS] = {QUICK_CASE("Tokenize words", test_case_tokenize_words),
+                                       QUICK_CASE("Tokenize operators", test_case_tokenize_operators),
+                                       QUICK_CASE("Tokenize file substitutions", test_case_tokenize_file_substitutions),
+                                       QUICK_CASE("Tokenize background flags", test_case_tokenize_background),
+                                       QUICK_CASE("Tokenize empty strings", test_case_tokenize_empty)};
+
+    return cinta_run_cases("lexer", test_cases, NUM_TESTS);
+}
+
+void test_case_tokenize_words(test_info *info) {
+    size_t size;
+    token *tokens = tokenize("  ls   -l  /tmp ", &size);
+
+    CINTA_ASSERT_INT(size, 3, info);
+
+    CINTA_ASSERT_INT(tokens[0].offset, 2, info);
+    CINTA_ASSERT_INT(tokens[0].length, 2, info);
+    CINTA_ASSERT_INT(tokens[0].kind, TOKEN_WORD, info);
+
+    CINTA_ASSERT_INT(tokens[1].offset, 7, info);
+    CINTA_ASSERT_INT(tokens[1].length, 2, info);
+    CINTA_ASSERT_INT(tokens[1].kind, TOKEN_WORD, info);
+
+    CINTA_ASSERT_INT(tokens[2].offset, 11, info);
+    CINTA_ASSERT_INT(tokens[2].length, 4, info);
+    CINTA_ASSERT_INT(tokens[2].kind, TOKEN_WORD, info);
+
+    free(tokens);
+}
+
+void test_case_tokenize_operators(test_info *info) {
+    size_t size;
+    token *tokens = tokenize("cat <( a | b ) < in > out >| o >> o 2> e 2>| e 2>> e a|b", &size);
+
+    token_kind expected[] = {TOKEN_WORD,
+                             TOKEN_SUBSTITUTION_START,
+                             TOKEN_WORD,
+                             TOKEN_PIPE,
+                             TOKEN_WORD,
+                             TOKEN_SUBSTITUTION_END,
+                             TOKEN_REDIRECT_STDIN,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDOUT,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDOUT_TRUNC,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDOUT_APPEND,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDERR,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDERR_TRUNC,
+                             TOKEN_WORD,
+                             TOKEN_REDIRECT_STDERR_APPEND,
+                             TOKEN_WORD,
+                             TOKEN_WORD};
+    size_t expected_size = sizeof(expected) / sizeof(expected[0]);
+
+    CINTA_ASSERT_INT(size, expected_size, info);
+    for (size_t index = 0; index < expected_size && index < size; ++index) {
+        CINTA_ASSERT_INT(tokens[index].kind, expected[index], info);
+        CINTA_ASSERT_INT(is_operator_token(&tokens[index]), expected[index] != TOKEN_WORD, info);
+    }
+
+    CINTA_ASSERT_INT(is_redirection_token(&tokens[1]), 0, info);
+    CINTA_ASSERT_INT(is_redirection_token(&tokens[6]), 1, info);
+    CINTA_ASSERT_INT(is_redirection_token(&tokens[18]), 1, info);
+
+    free(tokens);
+}
+
+void test_case_tokenize_file_substitutions(test_info *info) {
+    size_t size;
+    token *tokens = tokenize("diff =( a ) <( b ) x=( = =(x", &size);
+
+    // `=` only starts an operator when the whole word is `=(`
+    token_kind expected[] = {TOKEN_WORD, TOKEN_FILE_SUBSTITUTION_START, TOKEN_WORD, TOKEN_SUBSTITUTION_END,
+                             TOKEN_SUBSTITUTION_START, TOKEN_WORD, TOKEN_SUBSTITUTION_END, TOKEN_WORD,
+                             TOKEN_WORD, TOKEN_WORD};
+    size_t expected_size = sizeof(expected) / sizeof(expected[0]);
+
+    CINTA_ASSERT_INT(size, expected_size, info);
+    for (size_t index = 0; index < expected_size && index < size; ++index) {
+        CINTA_ASSERT_INT(tokens[index].kind, expected[index], info);
+        CINTA_ASSERT_INT(is_substitution_start_token(&tokens[index]), index == 1 || index == 4, info);
+    }
+
+    free(tokens);
+}
+
+void test_case_tokenize_background(test_info *info) {
+    size_t size;
+    token *tokens = tokenize("a&&b &c", &size);
+
+    token_kind expected[] = {TOKEN_WORD, TOKEN_BACKGROUND, TOKEN_BACKGROUND, TOKEN_WORD, TOKEN_BACKGROUND, TOKEN_WORD};
+    size_t expected_offsets[] = {0, 1, 2, 3, 5, 6};
+
+    CINTA_ASSERT_INT(size, 6, info);
+    for (size_t index = 0; index < 6 && index < size; ++index) {
+        CINTA_ASSERT_INT(tokens[index].kind, expected[index], info);
+        CINTA_ASSERT_INT(tokens[index].offset, expected_offsets[index], info);
+        CINTA_ASSERT_INT(tokens[index].length, 1, info);
+    }
+
+    free(tokens);
+}
+
+void test_case_tokenize_empty(test_info *info) {
+    size_t size = 42;
+
+    CINTA_ASSERT_NULL(tokenize("", &size), info);
+    CINTA_ASSERT_INT(size, 0, info);
+
+    CINTA_ASSERT_NULL(tokenize("     ", &size), info);
+    CINTA_ASSERT_INT(size, 0, info);
+
+    CINTA_ASSERT_NULL(tokenize(NULL, &size), info);
+    CINTA_ASSERT_INT(size, 0, info);
+}
@@ -0,0 +1,125 @@
+#include "../src/parse_cache.h"
+#include "test_core.h"
+#include <stdlib.h>
+
+#define NUM_TESTS 4
+
+void test_case_parse_cache_hits_and_misses(test_info *info);
+void test_case_parse_cache_eviction(test_info *info);
+void test_case_parse_cache_instantiation(test_info *info);
+void test_case_parse_cache_errors(test_info *info);
+
+test_info *test_parse_cache() {
+    test_case test_cases[NUM_TESTS] = {QUICK_CASE("Hits and misses", test_case_parse_cache_hits_and_misses),
+                                       QUICK_CASE("Least recently used eviction", test_case_parse_cache_eviction),
+                                       QUICK_CASE("Instantiation of cached lines", test_case_parse_cache_instantiation),
+                                       QUICK_CASE("Lines with errors", test_case_parse_cache_errors)};
+
+    return cinta_run_cases("parse_cache", test_cases, NUM_TESTS);
+}
+
+/** Parses the line through the cache and destroys the result, returns the number of commands. */
+size_t parse_and_destroy(char *line) {
+    size_t total_commands;
+    command **commands = parse_read_line_cached(line, &total_commands);
+    if (commands == NULL) {
+        return 0;
+    }
+
+    for (size_t index = 0; index < total_commands; ++index) {
+        close_command_file_descriptors(commands[index]);
+        destroy_command(commands[index]);
+    }
+    free(commands);
+    return total_commands;
+}
+
+void test_case_parse_cache_hits_and_misses(test_info *info) {
+    init_parse_cache(4);
+
+    CINTA_ASSERT_INT(parse_and_destroy("echo a"), 1, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo a"), 1, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo b & echo c"), 2, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo a"), 1, info);
+
+    CINTA_ASSERT_INT(line_cache.hits, 2, info);
+    CINTA_ASSERT_INT(line_cache.misses, 2, info);
+    CINTA_ASSERT_INT(line_cache.evictions, 0, info);
+    CINTA_ASSERT_INT(line_cache.size, 2, info);
+
+    destroy_parse_cache();
+}
+
+void test_case_parse_cache_eviction(test_info *info) {
+    init_parse_cache(2);
+
+    parse_and_destroy("echo a");
+    parse_and_destroy("echo b");
+    parse_and_destroy("echo a"); // `echo b` is now the least recently used line
+    parse_and_destroy("echo c");
+
+    CINTA_ASSERT_INT(line_cache.evictions, 1, info);
+    CINTA_ASSERT_INT(line_cache.size, 2, info);
+
+    parse_and_destroy("echo a");
+    CINTA_ASSERT_INT(line_cache.hits, 2, info);
+
+    parse_and_destroy("echo b");
+    CINTA_ASSERT_INT(line_cache.hits, 2, info);
+    CINTA_ASSERT_INT(line_cache.misses, 4, info);
+    CINTA_ASSERT_INT(line_cache.evictions, 2, info);
+
+    destroy_parse_cache();
+}
+
+void test_case_parse_cache_instantiation(test_info *info) {
+    init_parse_cache(4);
+
+    size_t total_commands;
+    command **first = parse_read_line_cached("cat <( echo a ) | wc -l &", &total_commands);
+    CINTA_ASSERT_NOT_NULL(first, info);
+    CINTA_ASSERT_INT(total_commands, 1, info);
+
+    command **second = parse_read_line_cached("cat <( echo a ) | wc -l &", &total_commands);
+    CINTA_ASSERT_NOT_NULL(second, info);
+    CINTA_ASSERT_INT(line_cache.hits, 1, info);
+
+    // Each execution gets its own pipes
+    CINTA_ASSERT_INT(second[0]->open_pipes_size, 2, info);
+    CINTA_ASSERT(second[0]->open_pipes[0][0] != first[0]->open_pipes[0][0], info);
+    CINTA_ASSERT(strcmp(second[0]->command_calls[2]->argv[1], first[0]->command_calls[2]->argv[1]) != 0, info);
+    CINTA_ASSERT_INT(second[0]->background, 1, info);
+
+    CINTA_ASSERT_STRING(second[0]->command_calls[0]->command_string, "wc -l", info);
+
+    for (size_t index = 0; index < 2; ++index) {
+        command *command = index == 0 ? first[0] : second[0];
+        close_command_file_descriptors(command);
+        destroy_command(command);
+    }
+    free(first);
+    free(second);
+
+    destroy_parse_cache();
+}
+
+void test_case_parse_cache_errors(test_info *info) {
+    init_parse_cache(4);
+
+    // Errors have to be printed every time, so these lines are not kept
+    CINTA_ASSERT_INT(parse_and_destroy("echo a | > "), 0, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo a & echo b |"), 1, info);
+    CINTA_ASSERT_INT(line_cache.size, 0, info);
+
+    // A trailing blank command is dropped silently
+    CINTA_ASSERT_INT(parse_and_destroy("echo a &   "), 1, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo a &   "), 1, info);
+    CINTA_ASSERT_INT(line_cache.hits, 1, info);
+
+    // Files are only opened when the command is executed, parsing cannot fail on them
+    CINTA_ASSERT_INT(parse_and_destroy("echo a > /dev/null/impossible"), 1, info);
+    CINTA_ASSERT_INT(parse_and_destroy("echo a > /dev/null/impossible"), 1, info);
+    CINTA_ASSERT_INT(line_cache.hits, 2, info);
+
+    destroy_parse_cache();
+}
@@ -0,0 +1,136 @@
+#include "../src/path_cache.h"
+#include "test_core.h"
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NUM_TEST 4
+
+void test_case_missing_command_is_cached(test_info *info);
+void test_case_path_change_clears_cache(test_info *info);
+void test_case_pinned_command(test_info *info);
+void test_case_missing_directory(test_info *info);
+
+test_info *test_path_cache() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("A missing command is remembered until it appears", test_case_missing_command_is_cached),
+        QUICK_CASE("Changing PATH clears the cache", test_case_path_change_clears_cache),
+        QUICK_CASE("Pinned commands survive directory changes", test_case_pinned_command),
+        QUICK_CASE("Missing commands are not cached while a directory is missing", test_case_missing_directory)};
+
+    return cinta_run_cases("path cache", cases, NUM_TEST);
+}
+
+/** Creates an executable file named `name` in `directory`. */
+void create_executable(const char *directory, const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    close(fd);
+}
+
+/** Runs the test with `PATH` set to a new empty directory, then restores everything. */
+void with_path_directory(test_info *info, void (*test)(test_info *, const char *)) {
+    char directory[] = "/tmp/jsh_path_cache_XXXXXX";
+    CINTA_ASSERT(mkdtemp(directory) != NULL, info);
+
+    char *old_path = strdup(getenv("PATH"));
+    setenv("PATH", directory, 1);
+
+    test(info, directory);
+
+    destroy_path_cache();
+    setenv("PATH", old_path, 1);
+    free(old_path);
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    system(command);
+}
+
+void missing_command_is_cached(test_info *info, const char *directory) {
+    const char *path;
+    CINTA_ASSERT_INT(COMMAND_MISSING, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT(path == NULL, info);
+
+    path_cache_entry *entry = find_command_path("jsh_tool");
+    if (command_paths.inotify_fd != -1) {
+        CINTA_ASSERT(entry != NULL && entry->path == NULL, info);
+    }
+
+    create_executable(directory, "jsh_tool");
+
+    char expected[PATH_MAX];
+    snprintf(expected, sizeof(expected), "%s/jsh_tool", directory);
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_STRING(expected, path, info);
+
+    // Found commands are not searched for again
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_INT(2, find_command_path("jsh_tool")->hits, info);
+}
+
+void test_case_missing_command_is_cached(test_info *info) {
+    with_path_directory(info, missing_command_is_cached);
+}
+
+void path_change_clears_cache(test_info *info, const char *directory) {
+    create_executable(directory, "jsh_tool");
+
+    const char *path;
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+
+    setenv("PATH", "/nonexistent", 1);
+    CINTA_ASSERT_INT(COMMAND_MISSING, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_INT(COMMAND_UNRESOLVED, resolve_command_path("./jsh_tool", &path), info);
+}
+
+void test_case_path_change_clears_cache(test_info *info) {
+    with_path_directory(info, path_change_clears_cache);
+}
+
+void pinned_command(test_info *info, const char *directory) {
+    const char *path;
+    CINTA_ASSERT_INT(0, pin_command_path("jsh_tool", "/bin/true"), info);
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_STRING("/bin/true", path, info);
+
+    create_executable(directory, "jsh_other");
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_STRING("/bin/true", path, info);
+
+    clear_path_cache(0);
+    CINTA_ASSERT(find_command_path("jsh_tool") == NULL, info);
+    CINTA_ASSERT_INT(COMMAND_MISSING, resolve_command_path("jsh_tool", &path), info);
+}
+
+void test_case_pinned_command(test_info *info) {
+    with_path_directory(info, pinned_command);
+}
+
+void missing_directory(test_info *info, const char *directory) {
+    // Only the directory of `PATH` itself would be watched, not its parent
+    char missing[PATH_MAX];
+    snprintf(missing, sizeof(missing), "%s/bin", directory);
+    setenv("PATH", missing, 1);
+
+    const char *path;
+    CINTA_ASSERT_INT(COMMAND_MISSING, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT(find_command_path("jsh_tool") == NULL, info);
+
+    CINTA_ASSERT_INT(0, mkdir(missing, 0755), info);
+    create_executable(missing, "jsh_tool");
+
+    char expected[PATH_MAX];
+    snprintf(expected, sizeof(expected), "%s/bin/jsh_tool", directory);
+    CINTA_ASSERT_INT(COMMAND_FOUND, resolve_command_path("jsh_tool", &path), info);
+    CINTA_ASSERT_STRING(expected, path, info);
+}
+
+void test_case_missing_directory(test_info *info) {
+    with_path_directory(info, missing_directory);
+}
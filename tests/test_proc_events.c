@@ -0,0 +1,155 @@
+#include "../src/proc_events.h"
+#include "test_core.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_TEST 3
+
+void test_case_proc_events_off_by_default(test_info *info);
+void test_case_proc_events_keep_orphans(test_info *info);
+void test_case_proc_events_rebuild_on_overflow(test_info *info);
+
+test_info *test_proc_events() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("The trees are read from /proc by default", test_case_proc_events_off_by_default),
+        SLOW_CASE("Descendants stay below the shell when their parent ends", test_case_proc_events_keep_orphans),
+        SLOW_CASE("The tree is rebuilt from /proc once events are dropped", test_case_proc_events_rebuild_on_overflow)};
+
+    return cinta_run_cases("proc events", cases, NUM_TEST);
+}
+
+void test_case_proc_events_off_by_default(test_info *info) {
+    unsetenv(PROCESS_TREE_BACKEND_ENV);
+    init_proc_events();
+    CINTA_ASSERT_INT(proc_events_fd, -1, info);
+    destroy_proc_events();
+}
+
+/** Applies the pending events until the descendant is known or not, as `known` says. Returns it. */
+process_node *wait_for_process_node(pid_t pid, int known) {
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 10000000};
+    for (int tries = 0; tries < 200; tries++) {
+        read_proc_events();
+        process_node *node = find_process_node(pid);
+        if ((node != NULL) == known) {
+            return node;
+        }
+        nanosleep(&delay, NULL);
+    }
+    return find_process_node(pid);
+}
+
+/** Pipe the children forked by `fork_with_grandchild` write the pid of their own child to. */
+int grandchild_pipe[2];
+
+/** Forks a child forking a grandchild that waits for a signal, the child ending right away if `orphan` is 1. */
+pid_t fork_with_grandchild(int orphan) {
+    if (pipe(grandchild_pipe) == -1) {
+        return -1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        pid_t grandchild = fork();
+        if (grandchild == 0) {
+            pause();
+            _exit(0);
+        }
+        write(grandchild_pipe[1], &grandchild, sizeof(grandchild));
+        if (!orphan) {
+            pause();
+        }
+        _exit(0);
+    }
+    return child;
+}
+
+/** Returns the pid of the grandchild forked by `fork_with_grandchild`, 0 if it is unknown. */
+pid_t read_grandchild(pid_t child) {
+    pid_t grandchild = 0;
+    if (child != -1) {
+        read(grandchild_pipe[0], &grandchild, sizeof(grandchild));
+    }
+    close(grandchild_pipe[0]);
+    close(grandchild_pipe[1]);
+    return grandchild;
+}
+
+void test_case_proc_events_keep_orphans(test_info *info) {
+    setenv(PROCESS_TREE_BACKEND_ENV, "netlink", 1);
+    init_proc_events();
+    unsetenv(PROCESS_TREE_BACKEND_ENV);
+    if (proc_events_fd == -1) {
+        return; // Not allowed to subscribe, the shell falls back to /proc
+    }
+
+    // The child forks a grandchild and ends, leaving it to init
+    pid_t child = fork_with_grandchild(1);
+    pid_t grandchild = read_grandchild(child);
+    waitpid(child, NULL, 0);
+
+    CINTA_ASSERT_NULL(wait_for_process_node(child, 0), info);
+    process_node *node = wait_for_process_node(grandchild, 1);
+    CINTA_ASSERT(node != NULL, info);
+    CINTA_ASSERT(node == NULL || node->parent == NULL, info);
+
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    CINTA_ASSERT_INT(take_process_snapshot_from_events(&snapshot), 0, info);
+    const snapshot_process *process = find_snapshot_process(&snapshot, grandchild);
+    CINTA_ASSERT(process != NULL && process->ppid == getpid(), info);
+    destroy_process_snapshot(&snapshot);
+
+    kill(grandchild, SIGKILL);
+    CINTA_ASSERT_NULL(wait_for_process_node(grandchild, 0), info);
+
+    destroy_proc_events();
+}
+
+void test_case_proc_events_rebuild_on_overflow(test_info *info) {
+    setenv(PROCESS_TREE_BACKEND_ENV, "netlink", 1);
+    init_proc_events();
+    unsetenv(PROCESS_TREE_BACKEND_ENV);
+    if (proc_events_fd == -1) {
+        return; // Not allowed to subscribe, the shell falls back to /proc
+    }
+
+    pid_t child = fork_with_grandchild(0);
+    pid_t grandchild = read_grandchild(child);
+    pid_t orphan_parent = fork_with_grandchild(1);
+    pid_t orphan = read_grandchild(orphan_parent);
+    waitpid(orphan_parent, NULL, 0);
+    CINTA_ASSERT(wait_for_process_node(grandchild, 1) != NULL, info);
+    CINTA_ASSERT(wait_for_process_node(orphan, 1) != NULL, info);
+    CINTA_ASSERT_NULL(wait_for_process_node(orphan_parent, 0), info);
+
+    // The smallest buffer only holds a few events, most of the ones of these processes are dropped
+    int size = 0;
+    CINTA_ASSERT_INT(setsockopt(proc_events_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)), 0, info);
+    for (int index = 0; index < 256; index++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    read_proc_events();
+
+    // Read again from /proc, the orphan now belongs to init, and the other processes are where they were
+    CINTA_ASSERT_NULL(find_process_node(orphan), info);
+    process_node *node = find_process_node(grandchild);
+    CINTA_ASSERT(node != NULL && node->parent != NULL && node->parent->pid == child, info);
+    node = find_process_node(child);
+    CINTA_ASSERT(node != NULL && node->parent == NULL, info);
+
+    kill(orphan, SIGKILL);
+    kill(grandchild, SIGKILL);
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    destroy_proc_events();
+}
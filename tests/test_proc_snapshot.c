@@ -0,0 +1,102 @@
+#include "../src/proc_snapshot.h"
+#include "test_core.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NUM_TEST 3
+
+void test_case_snapshot_has_the_shell(test_info *info);
+void test_case_snapshot_links_children(test_info *info);
+void test_case_snapshot_is_taken_again(test_info *info);
+
+test_info *test_proc_snapshot() {
+    test_case cases[NUM_TEST] = {
+        QUICK_CASE("The snapshot has the current process and its parent", test_case_snapshot_has_the_shell),
+        QUICK_CASE("Children are linked to their parent with their own state", test_case_snapshot_links_children),
+        QUICK_CASE("A snapshot taken again replaces the previous one", test_case_snapshot_is_taken_again)};
+
+    return cinta_run_cases("proc snapshot", cases, NUM_TEST);
+}
+
+void test_case_snapshot_has_the_shell(test_info *info) {
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    CINTA_ASSERT_INT(take_process_snapshot(&snapshot), 0, info);
+
+    const snapshot_process *self = find_snapshot_process(&snapshot, getpid());
+    CINTA_ASSERT(self != NULL, info);
+    if (self != NULL) {
+        CINTA_ASSERT_INT(self->ppid, getppid(), info);
+        CINTA_ASSERT_INT(self->state, 'R', info);
+        CINTA_ASSERT(find_snapshot_process(&snapshot, self->ppid) != NULL, info);
+    }
+
+    destroy_process_snapshot(&snapshot);
+}
+
+void test_case_snapshot_links_children(test_info *info) {
+    pid_t children[2];
+    for (int i = 0; i < 2; i++) {
+        children[i] = fork();
+        if (children[i] == 0) {
+            pause();
+            _exit(0);
+        }
+    }
+
+    // The second child is stopped, the first one stays asleep
+    kill(children[1], SIGSTOP);
+    siginfo_t status;
+    waitid(P_PID, children[1], &status, WSTOPPED | WNOWAIT);
+
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    CINTA_ASSERT_INT(take_process_snapshot(&snapshot), 0, info);
+
+    const snapshot_process *self = find_snapshot_process(&snapshot, getpid());
+    size_t found = 0;
+    for (size_t child = self == NULL ? NO_SNAPSHOT_PROCESS : self->first_child; child != NO_SNAPSHOT_PROCESS;
+         child = snapshot.processes[child].next_sibling) {
+        const snapshot_process *process = &snapshot.processes[child];
+        CINTA_ASSERT_INT(process->ppid, getpid(), info);
+        if (process->pid == children[0]) {
+            CINTA_ASSERT(process->state == 'S' || process->state == 'R', info);
+            found++;
+        } else if (process->pid == children[1]) {
+            CINTA_ASSERT_INT(process->state, 'T', info);
+            found++;
+        }
+    }
+    CINTA_ASSERT_INT(found, 2, info);
+
+    destroy_process_snapshot(&snapshot);
+    for (int i = 0; i < 2; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+    }
+}
+
+void test_case_snapshot_is_taken_again(test_info *info) {
+    process_snapshot snapshot;
+    init_process_snapshot(&snapshot);
+    CINTA_ASSERT_INT(take_process_snapshot(&snapshot), 0, info);
+
+    pid_t child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+    CINTA_ASSERT_NULL(find_snapshot_process(&snapshot, child), info);
+
+    CINTA_ASSERT_INT(take_process_snapshot(&snapshot), 0, info);
+    const snapshot_process *process = find_snapshot_process(&snapshot, child);
+    CINTA_ASSERT(process != NULL, info);
+    CINTA_ASSERT(process == NULL || process->ppid == getpid(), info);
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    destroy_process_snapshot(&snapshot);
+}
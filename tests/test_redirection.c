@@ -7,16 +7,18 @@
 #include <strings.h>
 #include <unistd.h>
 
-#define NUM_TEST 3
+#define NUM_TEST 4
 
 void test_redirection_stdin(test_info *info);
 void test_redirection_stdout(test_info *info);
 void test_redirection_stderr(test_info *info);
+void test_redirection_deferred_open(test_info *info);
 
 test_info *test_redirection() {
     test_case cases[NUM_TEST] = {SLOW_CASE("Testing input redirection", test_redirection_stdin),
                                  SLOW_CASE("Testing output redirection", test_redirection_stdout),
-                                 SLOW_CASE("Testing error redirection", test_redirection_stderr)};
+                                 SLOW_CASE("Testing error redirection", test_redirection_stderr),
+                                 QUICK_CASE("Testing deferred redirections", test_redirection_deferred_open)};
 
     return cinta_run_cases("redirection", cases, NUM_TEST);
 }
@@ -89,3 +91,28 @@ void test_redirection_stderr(test_info *info) {
 
     CINTA_ASSERT(read_bytes > 0, info);
 }
+
+void test_redirection_deferred_open(test_info *info) {
+    unlink("tmp/test_redirection_deferred.log");
+
+    // Parsing only records the redirection, the file is created when the command runs
+    command *command = parse_command("pwd > tmp/test_redirection_deferred.log");
+    CINTA_ASSERT_INT(1, command != NULL, info);
+    CINTA_ASSERT_INT(-1, access("tmp/test_redirection_deferred.log", F_OK), info);
+
+    command_result *result = execute_command(command);
+    CINTA_ASSERT_INT(0, result->exit_code, info);
+    destroy_command_result(result);
+
+    int read_fd = open_test_file_to_read("test_redirection_deferred.log");
+    char buffer[1024];
+    CINTA_ASSERT(read(read_fd, buffer, 1024) > 0, info);
+    close(read_fd);
+
+    // The file now exists, so `>` fails when the command is executed
+    command = parse_command("pwd > tmp/test_redirection_deferred.log");
+    CINTA_ASSERT_INT(1, command != NULL, info);
+    result = execute_command(command);
+    CINTA_ASSERT_INT(1, result->exit_code, info);
+    destroy_command_result(result);
+}
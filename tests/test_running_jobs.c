@@ -1,21 +1,26 @@
 #include <assert.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/prctl.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "../src/internals.h"
 #include "../src/jobs.h"
+#include "../src/reaper.h"
 #include "test_core.h"
 #include "utils.h"
 
-#define NUM_TEST 5
+#define NUM_TEST 8
 
 void test_case_are_jobs_running_no_jobs(test_info *);
 void test_case_are_jobs_running_one_job(test_info *);
 void test_case_are_jobs_running_one_instant_job(test_info *);
 void test_case_are_jobs_running_kill(test_info *);
 void test_case_are_jobs_running_stop(test_info *);
+void test_case_blocking_wait_stops_with_the_last_stage(test_info *);
+void test_case_subreaper_tracks_orphans(test_info *);
+void test_case_scheduling_jobs_with_empty_slots(test_info *);
 
 test_info *test_running_jobs() {
     test_case cases[NUM_TEST] = {
@@ -23,7 +28,12 @@ test_info *test_running_jobs() {
         QUICK_CASE("Testing are_jobs_running - One running job", test_case_are_jobs_running_one_job),
         SLOW_CASE("Testing are_jobs_running - One instant job", test_case_are_jobs_running_one_instant_job),
         SLOW_CASE("Testing are_jobs_running - One killed job", test_case_are_jobs_running_kill),
-        SLOW_CASE("Testing are_jobs_running - One stopped job", test_case_are_jobs_running_stop)};
+        SLOW_CASE("Testing are_jobs_running - One stopped job", test_case_are_jobs_running_stop),
+        SLOW_CASE("Testing blocking_wait_for_job - Stages stopped or over",
+                  test_case_blocking_wait_stops_with_the_last_stage),
+        SLOW_CASE("Testing subreaper - Orphans kept with their job", test_case_subreaper_tracks_orphans),
+        SLOW_CASE("Testing setnice and setcpus - Jobs without a process in every slot",
+                  test_case_scheduling_jobs_with_empty_slots)};
 
     test_info *info = cinta_run_cases("running jobs", cases, NUM_TEST);
 
@@ -132,3 +142,97 @@ void test_case_are_jobs_running_stop(test_info *info) {
     destroy_command_result(result);
     init_job_table();
 }
+
+void test_case_blocking_wait_stops_with_the_last_stage(test_info *info) {
+    init_job_table();
+
+    command_result *result = helper_execute_bg("sleep 100 | sleep 0.2");
+    job *job = job_table[result->job_id - 1];
+
+    // The first stage is stopped while the last one is still running, the wait ends once the last one exits
+    kill(job->subjobs[1]->pid, SIGSTOP);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    blocking_wait_for_job(job);
+
+    CINTA_ASSERT(elapsed_seconds(&start) < 5, info);
+    CINTA_ASSERT_INT(STOPPED, job->status, info);
+    CINTA_ASSERT_INT(STOPPED, job->subjobs[1]->last_status, info);
+    CINTA_ASSERT_INT(DONE, job->subjobs[0]->last_status, info);
+
+    // Killed while stopped, the job is seen as stopped until the process is over
+    kill(-job->pgid, SIGKILL);
+    siginfo_t status;
+    waitid(P_PID, job->subjobs[1]->pid, &status, WEXITED | WNOWAIT);
+    blocking_wait_for_job(job);
+    CINTA_ASSERT_INT(KILLED, job->status, info);
+
+    destroy_command_result(result);
+    init_job_table();
+}
+
+void test_case_subreaper_tracks_orphans(test_info *info) {
+    init_job_table();
+    assert(prctl(PR_SET_CHILD_SUBREAPER, 1) == 0);
+    is_subreaper = 1;
+
+    // The daemon leaves the process group of the job, then the job ends
+    int fd = open_test_file_to_write("test_running_jobs_orphan.sh");
+    dprintf(fd, "setsid sleep 100 &\nsleep 0.2\n");
+    close(fd);
+    command_result *result = helper_execute_bg("sh tmp/test_running_jobs_orphan.sh");
+    job *job = job_table[result->job_id - 1];
+    blocking_wait_for_job(job);
+
+    CINTA_ASSERT_INT(DETACHED, job->status, info);
+    CINTA_ASSERT(job->live_orphans >= 1, info);
+    CINTA_ASSERT_INT(0, is_job_over(job), info);
+
+    // Kept in the table until its orphans are over
+    helper_mute_update_jobs("test_running_jobs_orphan.log");
+    CINTA_ASSERT_PTR(job_table[result->job_id - 1], ==, job, info);
+
+    CINTA_ASSERT(signal_job_orphans(job, SIGKILL) >= 1, info);
+    for (int tries = 0; tries < 100 && job_table_size > 0; tries++) {
+        usleep(10000);
+        helper_mute_update_jobs("test_running_jobs_orphan.log");
+    }
+    CINTA_ASSERT_INT(0, job_table_size, info);
+
+    prctl(PR_SET_CHILD_SUBREAPER, 0);
+    is_subreaper = 0;
+    destroy_command_result(result);
+    init_job_table();
+}
+
+/** Runs `setnice` and `setcpus` against the first job, and checks they succeed. */
+void helper_schedule_first_job(test_info *info) {
+    char *lines[] = {"setnice 5 %1", "setcpus 0 %1"};
+    for (size_t i = 0; i < 2; i++) {
+        command_result *result = mute_command_execution(parse_command(lines[i]));
+        CINTA_ASSERT_INT(result->exit_code, 0, info);
+        destroy_command_result(result);
+    }
+}
+
+void test_case_scheduling_jobs_with_empty_slots(test_info *info) {
+    // The internal command runs in the shell, its slot has no subjob
+    init_job_table();
+    command_result *result = helper_execute_bg("sleep 100 | cd .");
+    job *job = job_table[result->job_id - 1];
+    CINTA_ASSERT_NULL(job->subjobs[0], info);
+    helper_schedule_first_job(info);
+    kill(-job->pgid, SIGKILL);
+    destroy_command_result(result);
+
+    // Instances of an array not launched yet have no subjob either
+    init_job_table();
+    result = helper_execute_bg("array 4%1 sleep 100");
+    job = job_table[0];
+    CINTA_ASSERT_NULL(job->subjobs[1], info);
+    helper_schedule_first_job(info);
+    kill(-job->pgid, SIGKILL);
+    destroy_command_result(result);
+
+    init_job_table();
+}
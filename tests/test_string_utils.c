@@ -1,9 +1,10 @@
 #include "../src/string_utils.h"
 #include "test_core.h"
 #include <stddef.h>
+#include <string.h>
 #include <stdlib.h>
 
-#define NUM_TEST 19
+#define NUM_TEST 21
 
 static void test_case_starts_with(test_info *);
 static void test_case_trim_start(test_info *);
@@ -27,6 +28,9 @@ void test_case_trim_both_trim_spaces(test_info *info);
 void test_case_string_made_of(test_info *info);
 void test_case_repeat(test_info *info);
 
+void test_case_classify_bytes(test_info *info);
+void test_case_classify_bytes_paths_agree(test_info *info);
+
 test_info *test_string_utils() {
     test_case cases[NUM_TEST] = {
         QUICK_CASE("Testing `starts_with`", test_case_starts_with),
@@ -47,7 +51,9 @@ test_info *test_string_utils() {
         QUICK_CASE("Testing `trim_spaces` with only spaces at end", test_case_trim_end_trim_spaces),
         QUICK_CASE("Testing `trim_spaces` with spaces at start and end", test_case_trim_both_trim_spaces),
         QUICK_CASE("Testing `is_only_composed_of`", test_case_string_made_of),
-        QUICK_CASE("Testing `repeat`", test_case_repeat)};
+        QUICK_CASE("Testing `repeat`", test_case_repeat),
+        QUICK_CASE("Testing `classify_bytes`", test_case_classify_bytes),
+        QUICK_CASE("Testing `classify_bytes` implementations agree", test_case_classify_bytes_paths_agree)};
 
     return cinta_run_cases("String Utils", cases, NUM_TEST);
 }
@@ -628,3 +634,40 @@ void test_case_repeat(test_info *info) {
     CINTA_ASSERT_STRING("@#{@#{@#{@#{@#{@#{", result, info);
     free(result);
 }
+
+void test_case_classify_bytes(test_info *info) {
+    const char *string = "a 2>| b & <( 3> ) 22";
+    uint8_t expected[] = {0, CHAR_SPACE, CHAR_FD_DIGIT, CHAR_GREATER, CHAR_PIPE, CHAR_SPACE, 0, CHAR_SPACE,
+                          CHAR_AMPERSAND, CHAR_SPACE, CHAR_LESS, CHAR_OPEN_PARENTHESIS, CHAR_SPACE, CHAR_FD_DIGIT,
+                          CHAR_GREATER, CHAR_SPACE, CHAR_CLOSE_PARENTHESIS, CHAR_SPACE, 0, 0};
+    size_t length = strlen(string);
+    uint8_t classes[length];
+
+    classify_bytes(string, length, classes);
+    for (size_t index = 0; index < length; ++index) {
+        CINTA_ASSERT_INT(expected[index], classes[index], info);
+    }
+}
+
+void test_case_classify_bytes_paths_agree(test_info *info) {
+    const char alphabet[] = "ab2 |&<>()9";
+    size_t length = 200;
+    char string[length + 1];
+    uint8_t scalar[length];
+    uint8_t sse2[length];
+    uint8_t avx2[length];
+
+    for (size_t index = 0; index < length; ++index) {
+        string[index] = alphabet[(index * 7 + index / 3) % (sizeof(alphabet) - 1)];
+    }
+    string[length] = '\0';
+
+    // Every length exercises a different split between vector blocks and the scalar tail
+    for (size_t size = 0; size <= length; size += 13) {
+        classify_bytes_scalar(string, size, scalar);
+        classify_bytes_sse2(string, size, sse2);
+        classify_bytes_avx2(string, size, avx2);
+        CINTA_ASSERT_INT(0, memcmp(scalar, sse2, size), info);
+        CINTA_ASSERT_INT(0, memcmp(scalar, avx2, size), info);
+    }
+}
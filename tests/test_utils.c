@@ -1,17 +1,24 @@
 #include "../src/utils.h"
 #include "test_core.h"
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-#define NUM_TESTS 3
+#define NUM_TESTS 5
 
 void test_case_add_to_set(test_info *info);
 void test_case_remove_from_set(test_info *info);
 void test_case_contains(test_info *info);
+void test_case_fd_bitmap(test_info *info);
+void test_case_set_cloexec_from(test_info *info);
 
 test_info *test_utils() {
     test_case test_cases[NUM_TESTS] = {QUICK_CASE("add_to_set", test_case_add_to_set),
                                        QUICK_CASE("remove_from_set", test_case_remove_from_set),
-                                       QUICK_CASE("contains", test_case_contains)};
+                                       QUICK_CASE("contains", test_case_contains),
+                                       QUICK_CASE("fd_bitmap", test_case_fd_bitmap),
+                                       QUICK_CASE("set_cloexec_from", test_case_set_cloexec_from)};
 
     return cinta_run_cases("utils", test_cases, NUM_TESTS);
 }
@@ -84,3 +91,55 @@ void test_case_contains(test_info *info) {
 
     free(set);
 }
+
+void test_case_fd_bitmap(test_info *info) {
+    uint64_t *bitmap = new_fd_bitmap(200);
+
+    for (int fd = 0; fd <= 200; fd += 3) {
+        add_fd_bitmap(bitmap, fd);
+    }
+
+    for (int fd = -1; fd <= 300; ++fd) {
+        CINTA_ASSERT_INT(fd >= 0 && fd <= 200 && fd % 3 == 0, contains_fd_bitmap(bitmap, 200, fd), info);
+    }
+
+    free(bitmap);
+}
+
+void test_case_set_cloexec_from(test_info *info) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fds[4];
+        for (size_t index = 0; index < 4; ++index) {
+            fds[index] = open("/dev/null", O_RDONLY);
+        }
+
+        if (set_cloexec_from(fds[2]) == -1) {
+            exit(1);
+        }
+
+        // The first descriptors are left alone, and are the only ones that would be inherited
+        for (size_t index = 0; index < 4; ++index) {
+            int is_cloexec = (fcntl(fds[index], F_GETFD) & FD_CLOEXEC) != 0;
+            if (is_cloexec != (index >= 2)) {
+                exit(1);
+            }
+        }
+
+        set_cloexec_from(STDERR_FILENO + 1);
+        if (find_inherited_file_descriptor(NULL, 0) != -1) {
+            exit(1);
+        }
+
+        fcntl(fds[1], F_SETFD, 0);
+        int kept[] = {fds[1]};
+        if (find_inherited_file_descriptor(NULL, 0) != fds[1] || find_inherited_file_descriptor(kept, 1) != -1) {
+            exit(1);
+        }
+        exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    CINTA_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, info);
+}